@@ -0,0 +1,456 @@
+#include "terraingenerator.h"
+#include "watervolumesolver.h"
+#include "parallelwatervolumesolver.h"
+#include "reconstructionwatervolumesolver.h"
+#include "streamingwatervolumesolver.h"
+#include "typedwatervolumesolver.h"
+#include "fixedwatervolumesolver.h"
+#include "gridbatch.h"
+#include "gridfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Результат одного замера.
+ */
+struct Measurement {
+    double seconds = 0; /**< Лучшее время решения. */
+    ll volume = 0; /**< Объем воды. */
+    long peakRssKb = -1; /**< Пиковый размер резидентной памяти во время замера (-1 - неизвестен). */
+    long long queuePushes = -1; /**< Добавления в очередь (-1 - не считаются для этого алгоритма). */
+    long long queuePops = -1; /**< Извлечения из очереди. */
+    long long queuePeak = -1; /**< Наибольший размер очереди. */
+};
+
+/**
+ * @brief Сбрасывает счетчик пиковой памяти процесса, если система это поддерживает (Linux).
+ */
+static void resetPeakRss() {
+    ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs)
+        clearRefs << "5";
+}
+
+/**
+ * @brief Возвращает пиковый размер резидентной памяти процесса в килобайтах.
+ */
+static long peakRssKb() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return atol(line.c_str() + 6);
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return -1;
+}
+
+/**
+ * @brief Замеряет решение последовательным решателем.
+ * Время берется лучшим из повторов, счетчики очереди - из отдельного прогона, чтобы не влиять на время.
+ */
+template <class Queue>
+static Measurement measureSerial(vector<vector<int>>& matrix, SolverEngine engine, int repeat) {
+    int rows = matrix.size();
+    int cols = matrix[0].size();
+    Measurement m;
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        BasicWaterVolumeSolver<Queue> solver(rows, cols, matrix);
+        solver.setEngine(engine);
+        m.volume = solver.solve();
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    m.peakRssKb = peakRssKb();
+
+    BasicWaterVolumeSolver<CountingQueue<Queue>> counted(rows, cols, matrix);
+    counted.setEngine(engine);
+    counted.solve();
+    m.queuePushes = counted.queue().pushes;
+    m.queuePops = counted.queue().pops;
+    m.queuePeak = counted.queue().peak;
+    return m;
+}
+
+/**
+ * @brief Замеряет решение многопоточным решателем.
+ * Счетчики очереди берутся из stats() последнего повтора, если библиотека собрана с WATERCUBOIDS_STATS.
+ */
+static Measurement measureParallel(vector<vector<int>>& matrix, int threads, int repeat) {
+    int rows = matrix.size();
+    int cols = matrix[0].size();
+    Measurement m;
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        ParallelWaterVolumeSolver solver(rows, cols, matrix, threads);
+        m.volume = solver.solve();
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        if (SolverStats::enabled()) {
+            m.queuePushes = solver.stats().queuePushes;
+            m.queuePops = solver.stats().queuePops;
+            m.queuePeak = solver.stats().queuePeak;
+        }
+    }
+    m.peakRssKb = peakRssKb();
+    return m;
+}
+
+/**
+ * @brief Замеряет потоковое решение файла сетки (уровни воды не записываются).
+ * @param fileName Файл сетки с высотами.
+ * @param memoryLimit Предел памяти решателя в байтах.
+ */
+static Measurement measureStreaming(const string& fileName, size_t memoryLimit, int repeat) {
+    Measurement m;
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        StreamingWaterVolumeSolver solver(fileName, "", memoryLimit);
+        m.volume = solver.solve();
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    m.peakRssKb = peakRssKb();
+    return m;
+}
+
+/**
+ * @brief Замеряет решатель, выбранный по ширине высот файла сетки (TypedWaterVolumeSolver).
+ * Файл записан с наименьшей подходящей шириной, поэтому высоты читаются из отображения без расширения до int.
+ * @param fileName Файл сетки с высотами.
+ */
+static Measurement measureNative(const string& fileName, int repeat) {
+    Measurement m;
+    MappedGrid grid;
+    if (!grid.open(fileName)) {
+        m.volume = -1;
+        return m;
+    }
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        if (!solveNativeWidth(grid.view(), m.volume))
+            m.volume = -1;
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    m.peakRssKb = peakRssKb();
+    return m;
+}
+
+/**
+ * @brief Замеряет решатель фиксированного размера Side x Side.
+ * @param heights Высоты построчно.
+ */
+template <int Side>
+static Measurement measureFixedSide(const vector<int>& heights, int repeat) {
+    Measurement m;
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        // Решатель держит всю сетку внутри объекта, на стеке он не помещается
+        auto solver = make_unique<FixedWaterVolumeSolver<Side, Side>>();
+        m.volume = solver->solve(heights.data());
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    m.peakRssKb = peakRssKb();
+    return m;
+}
+
+/**
+ * @brief Замеряет решатель фиксированного размера, если он собран для этой стороны сетки.
+ * Собраны стороны, которые дают размеры по умолчанию: 100, 1000 и 10000 клеток.
+ * @param heights Высоты построчно.
+ * @param side Сторона квадратной сетки.
+ * @param m Результат замера.
+ * @return false, если решатель для этой стороны не собран.
+ */
+static bool measureFixed(const vector<int>& heights, int side, int repeat, Measurement& m) {
+    switch (side) {
+    case 10:
+        m = measureFixedSide<10>(heights, repeat);
+        return true;
+    case 32:
+        m = measureFixedSide<32>(heights, repeat);
+        return true;
+    case 100:
+        m = measureFixedSide<100>(heights, repeat);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Замеряет пакетное решение: рельеф нарезается на сетки со стороной batchSide, объем - их сумма.
+ * Время включает только solveBatch(), нарезка выполняется один раз.
+ * @param heights Высоты построчно.
+ * @param side Сторона квадратной сетки.
+ * @param batchSide Сторона сетки пакета.
+ * @param threads Количество рабочих потоков.
+ */
+static Measurement measureBatch(const vector<int>& heights, int side, int batchSide, int threads, int repeat) {
+    GridBatch batch;
+    vector<int> piece;
+    for (int r0 = 0; r0 < side; r0 += batchSide) {
+        for (int c0 = 0; c0 < side; c0 += batchSide) {
+            int rows = min(batchSide, side - r0);
+            int cols = min(batchSide, side - c0);
+            piece.resize((size_t)rows * cols);
+            for (int i = 0; i < rows; i++)
+                copy_n(heights.begin() + (size_t)(r0 + i) * side + c0, cols, piece.begin() + (size_t)i * cols);
+            batch.add(rows, cols, piece.data());
+        }
+    }
+
+    Measurement m;
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        vector<ll> volumes = solveBatch(batch, threads);
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        m.volume = 0;
+        for (ll volume : volumes)
+            m.volume += volume;
+    }
+    m.peakRssKb = peakRssKb();
+    return m;
+}
+
+/**
+ * @brief Замеряет решение морфологической реконструкцией с заданным набором инструкций.
+ */
+static Measurement measureReconstruction(vector<vector<int>>& matrix, SimdKernel kernel, int repeat) {
+    int rows = matrix.size();
+    int cols = matrix[0].size();
+    Measurement m;
+    m.seconds = 1e300;
+    resetPeakRss();
+    for (int k = 0; k < repeat; k++) {
+        auto start = chrono::steady_clock::now();
+        ReconstructionWaterVolumeSolver solver(rows, cols, matrix);
+        solver.setKernel(kernel);
+        m.volume = solver.solve();
+        m.seconds = min(m.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    m.peakRssKb = peakRssKb();
+    return m;
+}
+
+/**
+ * @brief Разбирает список чисел через запятую.
+ */
+static vector<int> parseList(const string& text) {
+    vector<int> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ','))
+        values.push_back(atoi(item.c_str()));
+    return values;
+}
+
+/**
+ * @brief Выводит справку по параметрам командной строки.
+ * @param program Имя исполняемого файла.
+ */
+static void printUsage(const char* program) {
+    cerr << "Использование: " << program << " [параметры]\n"
+         << "Замеряет все алгоритмы на сгенерированных рельефах и выводит по строке на замер.\n\n"
+         << "Параметры:\n"
+         << "  --min-cells N        наименьший размер сетки (по умолчанию 100)\n"
+         << "  --max-cells N        наибольший размер сетки, размеры идут через десятичный порядок (по умолчанию 1000000)\n"
+         << "  --terrains СПИСОК    uniform,plateau,bowls,spiral,ramp,fractal,serpentine (по умолчанию все)\n"
+         << "  --engines СПИСОК     dfs,pfplus,pfplus-binaryheap,parallel,reconstruction,reconstruction-scalar,\n"
+         << "                       streaming,native,fixed,batch (по умолчанию все)\n"
+         << "  --threads СПИСОК     количества потоков для parallel и batch (по умолчанию степени двойки до числа ядер)\n"
+         << "  --dfs-max-cells N    dfs рекурсивен, поэтому запускается только на сетках до N клеток (по умолчанию 40000)\n"
+         << "  --stream-memory МБ   предел памяти streaming (по умолчанию 16, чтобы сетка делилась на блоки)\n"
+         << "  --batch-side N       сторона сеток, на которые batch нарезает рельеф (по умолчанию 8)\n"
+         << "                       fixed собран только для сторон 10, 32 и 100 и на остальных сетках пропускается\n"
+         << "  --repeat N           количество повторов, берется лучшее время (по умолчанию 3)\n"
+         << "  --seed N             зерно генератора рельефа (по умолчанию 1)\n"
+         << "  --format json|csv    формат вывода (по умолчанию json, по объекту на строку)\n";
+}
+
+/**
+ * @brief Точка входа набора замеров.
+ * @param argc Количество аргументов командной строки.
+ * @param argv Массив аргументов командной строки.
+ * @return 0 при успехе, 2 при ошибке параметров.
+ */
+int main(int argc, char *argv[]) {
+    long long minCells = 100;
+    long long maxCells = 1000000;
+    long long dfsMaxCells = 40000;
+    size_t streamMemory = (size_t)16 << 20;
+    int batchSide = 8;
+    int repeat = 3;
+    uint64_t seed = 1;
+    bool csv = false;
+    string terrainList = "uniform,plateau,bowls,spiral,ramp,fractal,serpentine";
+    string engineList = "dfs,pfplus,pfplus-binaryheap,parallel,reconstruction,reconstruction-scalar,"
+                        "streaming,native,fixed,batch";
+    vector<int> threadCounts;
+    for (int t = 1; t <= (int)max(1u, thread::hardware_concurrency()); t *= 2)
+        threadCounts.push_back(t);
+
+    for (int k = 1; k < argc; k++) {
+        string arg = argv[k];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (k + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        string value = argv[++k];
+        if (arg == "--min-cells")
+            minCells = atoll(value.c_str());
+        else if (arg == "--max-cells")
+            maxCells = atoll(value.c_str());
+        else if (arg == "--terrains")
+            terrainList = value;
+        else if (arg == "--engines")
+            engineList = value;
+        else if (arg == "--threads")
+            threadCounts = parseList(value);
+        else if (arg == "--dfs-max-cells")
+            dfsMaxCells = atoll(value.c_str());
+        else if (arg == "--stream-memory")
+            streamMemory = (size_t)max(1LL, atoll(value.c_str())) << 20;
+        else if (arg == "--batch-side")
+            batchSide = max(1, atoi(value.c_str()));
+        else if (arg == "--repeat")
+            repeat = max(1, atoi(value.c_str()));
+        else if (arg == "--seed")
+            seed = strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--format")
+            csv = value == "csv";
+        else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    vector<TerrainKind> terrains;
+    stringstream terrainStream(terrainList);
+    string name;
+    while (getline(terrainStream, name, ',')) {
+        TerrainKind kind;
+        if (!parseTerrainKind(name, kind)) {
+            cerr << "Неизвестный рельеф: " << name << endl;
+            return 2;
+        }
+        terrains.push_back(kind);
+    }
+    vector<string> engines;
+    stringstream engineStream(engineList);
+    while (getline(engineStream, name, ','))
+        engines.push_back(name);
+    // streaming и native читают рельеф из файла сетки, он перезаписывается для каждого рельефа
+    string gridFileName = (filesystem::temp_directory_path() / "watercuboids-bench.bin").string();
+
+    if (csv)
+        cout << "terrain,rows,cols,cells,engine,threads,seconds,cells_per_second,peak_rss_kb,queue_pushes,queue_pops,queue_peak,volume\n";
+
+    for (long long cells = minCells; cells <= maxCells; cells *= 10) {
+        int side = max(1, (int)llround(sqrt((double)cells)));
+        for (TerrainKind terrain : terrains) {
+            vector<vector<int>> matrix = generateTerrain(terrain, side, side, seed);
+            vector<int> heights;
+            heights.reserve((size_t)side * side);
+            for (const vector<int>& row : matrix)
+                heights.insert(heights.end(), row.begin(), row.end());
+            bool gridFileWritten = false;
+            for (const string& engine : engines) {
+                if ((engine == "streaming" || engine == "native") && !gridFileWritten) {
+                    if (!writeGridFile(gridFileName, GridView(side, side, heights))) {
+                        cerr << "Не удалось записать файл сетки: " << gridFileName << endl;
+                        return 2;
+                    }
+                    gridFileWritten = true;
+                }
+                vector<int> threadsForEngine = engine == "parallel" || engine == "batch" ? threadCounts : vector<int>{1};
+                for (int threads : threadsForEngine) {
+                    Measurement m;
+                    if (engine == "dfs") {
+                        if ((long long)side * side > dfsMaxCells)
+                            continue;
+                        m = measureSerial<HeightQueue>(matrix, SolverEngine::DepthFirstSearch, repeat);
+                    } else if (engine == "pfplus") {
+                        m = measureSerial<HeightQueue>(matrix, SolverEngine::PriorityFloodPlus, repeat);
+                    } else if (engine == "pfplus-binaryheap") {
+                        m = measureSerial<BinaryHeapQueue>(matrix, SolverEngine::PriorityFloodPlus, repeat);
+                    } else if (engine == "parallel") {
+                        m = measureParallel(matrix, threads, repeat);
+                    } else if (engine == "reconstruction") {
+                        m = measureReconstruction(matrix, ReconstructionWaterVolumeSolver::detectKernel(), repeat);
+                    } else if (engine == "reconstruction-scalar") {
+                        m = measureReconstruction(matrix, SimdKernel::Scalar, repeat);
+                    } else if (engine == "streaming") {
+                        m = measureStreaming(gridFileName, streamMemory, repeat);
+                    } else if (engine == "native") {
+                        m = measureNative(gridFileName, repeat);
+                    } else if (engine == "fixed") {
+                        if (!measureFixed(heights, side, repeat, m))
+                            continue;
+                    } else if (engine == "batch") {
+                        m = measureBatch(heights, side, batchSide, threads, repeat);
+                    } else {
+                        cerr << "Неизвестный алгоритм: " << engine << endl;
+                        return 2;
+                    }
+
+                    long long n = (long long)side * side;
+                    double rate = m.seconds > 0 ? n / m.seconds : 0;
+                    char line[512];
+                    if (csv) {
+                        snprintf(line, sizeof(line), "%s,%d,%d,%lld,%s,%d,%.6f,%.0f,%ld,%lld,%lld,%lld,%lld",
+                                 terrainName(terrain), side, side, n, engine.c_str(), threads, m.seconds, rate,
+                                 m.peakRssKb, m.queuePushes, m.queuePops, m.queuePeak, m.volume);
+                    } else {
+                        snprintf(line, sizeof(line),
+                                 "{\"terrain\":\"%s\",\"rows\":%d,\"cols\":%d,\"cells\":%lld,\"engine\":\"%s\",\"threads\":%d,"
+                                 "\"seconds\":%.6f,\"cells_per_second\":%.0f,\"peak_rss_kb\":%ld,"
+                                 "\"queue_pushes\":%lld,\"queue_pops\":%lld,\"queue_peak\":%lld,\"volume\":%lld}",
+                                 terrainName(terrain), side, side, n, engine.c_str(), threads, m.seconds, rate,
+                                 m.peakRssKb, m.queuePushes, m.queuePops, m.queuePeak, m.volume);
+                    }
+                    cout << line << endl;
+                }
+            }
+        }
+    }
+    error_code error;
+    filesystem::remove(gridFileName, error);
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "cellgrid.h"
+
+/**
+ * @brief Конструктор класса CellGrid.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param layout Способ размещения клеток в памяти.
+ */
+CellGrid::CellGrid(int rows, int cols, GridLayout layout)
+    : layout(layout) {
+    reset(rows, cols);
+}
+
+/**
+ * @brief Меняет размер сетки, сохраняя выделенный буфер, если его хватает.
+ * Все клетки, включая рамку, становятся посещенными; решатель снимает флаг с клеток матрицы при заполнении.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ */
+void CellGrid::reset(int rows, int cols) {
+    rowsGrid = rows;
+    colsGrid = cols;
+    // Размер с рамкой считается в size_t: у сеток больше 2^31 клеток произведение не помещается в int
+    size_t paddedRows = (size_t)rows + 2;
+    size_t paddedCols = (size_t)cols + 2;
+    size_t total;
+    if (layout == GridLayout::RowMajor) {
+        stride = (int)paddedCols;
+        total = paddedRows * paddedCols;
+    } else {
+        stride = (int)((paddedCols + tileMask) >> tileShift);
+        total = ((paddedRows + tileMask) >> tileShift) * stride * tileCells;
+    }
+    offsets[0] = 1;
+    offsets[1] = -1;
+    offsets[2] = stride;
+    offsets[3] = -stride;
+    cells.assign(total, Cell{0, 0, true, 0});
+}
+
+/**
+ * @brief Возвращает линейный индекс клетки.
+ * @param row Строка (от -1 до rows включительно, крайние значения - рамка).
+ * @param col Столбец (от -1 до cols включительно, крайние значения - рамка).
+ * @return Линейный индекс клетки в буфере.
+ */
+int CellGrid::index(int row, int col) const {
+    int r = row + 1;
+    int c = col + 1;
+    if (layout == GridLayout::RowMajor)
+        return r * stride + c;
+    return ((r >> tileShift) * stride + (c >> tileShift)) * tileCells + ((r & tileMask) << tileShift) + (c & tileMask);
+}
+
+/**
+ * @brief Возвращает строку и столбец клетки по линейному индексу.
+ * @param index Линейный индекс клетки.
+ * @param row Строка клетки.
+ * @param col Столбец клетки.
+ */
+void CellGrid::position(int index, int& row, int& col) const {
+    if (layout == GridLayout::RowMajor) {
+        row = index / stride - 1;
+        col = index % stride - 1;
+        return;
+    }
+    int tile = index >> (2 * tileShift);
+    int local = index & (tileCells - 1);
+    row = ((tile / stride) << tileShift | local >> tileShift) - 1;
+    col = ((tile % stride) << tileShift | (local & tileMask)) - 1;
+}
+
+/**
+ * @brief Возвращает индекс соседней клетки при блочном размещении.
+ * Внутри блока сосед находится по постоянному смещению, на краю блока - в соседнем блоке.
+ * @param index Линейный индекс клетки.
+ * @param direction Направление (от 0 до 3).
+ * @return Линейный индекс соседа.
+ */
+int CellGrid::tiledNeighbour(int index, int direction) const {
+    int localCol = index & tileMask;
+    int localRow = (index >> tileShift) & tileMask;
+    switch (direction) {
+    case 0:
+        return localCol != tileMask ? index + 1 : index - tileMask + tileCells;
+    case 1:
+        return localCol != 0 ? index - 1 : index + tileMask - tileCells;
+    case 2:
+        return localRow != tileMask ? index + tileSide : index - tileMask * tileSide + stride * tileCells;
+    default:
+        return localRow != 0 ? index - tileSide : index + tileMask * tileSide - stride * tileCells;
+    }
+}
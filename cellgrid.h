@@ -0,0 +1,102 @@
+#ifndef CELLGRID_H
+#define CELLGRID_H
+
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Ячейка рабочей сетки решателя.
+ * Высота, уровень воды и флаг посещения лежат рядом, чтобы проверка соседа
+ * обходилась одним обращением к памяти. Номер озера занимает оставшиеся биты слова
+ * с флагом посещения, поэтому разметка озер не увеличивает размер клетки.
+ */
+struct Cell {
+    int height; /**< Высота столбца. */
+    int level; /**< Уровень воды над клеткой (значение рабочей матрицы). */
+    unsigned visited : 1; /**< Флаг посещения клетки. */
+    unsigned basin : 31; /**< Окончательный номер озера - индекс в таблице озер решателя (верен только у затопленных клеток при разметке озер). */
+};
+
+/**
+ * @brief Способ размещения клеток в памяти.
+ */
+enum class GridLayout {
+    RowMajor, /**< Построчное размещение, соседи по постоянным смещениям. */
+    Tiled /**< Блоки 32x32, для очень широких сеток. */
+};
+
+/**
+ * @brief Класс CellGrid хранит сетку в одном непрерывном буфере с рамкой-ограничителем.
+ * Вокруг матрицы добавляется рамка шириной в одну клетку, помеченная как посещенная,
+ * поэтому при обходе соседей не нужны проверки границ. Клетки адресуются линейным индексом.
+ */
+class CellGrid {
+public:
+    /**
+     * @brief Конструктор класса CellGrid.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param layout Способ размещения клеток в памяти.
+     */
+    CellGrid(int rows, int cols, GridLayout layout = GridLayout::RowMajor);
+
+    /**
+     * @brief Меняет размер сетки, сохраняя выделенный буфер, если его хватает.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     */
+    void reset(int rows, int cols);
+
+    /**
+     * @brief Возвращает линейный индекс клетки.
+     * @param row Строка (от -1 до rows включительно, крайние значения - рамка).
+     * @param col Столбец (от -1 до cols включительно, крайние значения - рамка).
+     * @return Линейный индекс клетки в буфере.
+     */
+    int index(int row, int col) const;
+
+    /**
+     * @brief Возвращает индекс соседней клетки.
+     * @param index Линейный индекс клетки.
+     * @param direction Направление (от 0 до 3).
+     * @return Линейный индекс соседа.
+     */
+    int neighbour(int index, int direction) const {
+        if (layout == GridLayout::RowMajor)
+            return index + offsets[direction];
+        return tiledNeighbour(index, direction);
+    }
+
+    /**
+     * @brief Возвращает строку и столбец клетки по линейному индексу (обратно к index()).
+     * @param index Линейный индекс клетки.
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     */
+    void position(int index, int& row, int& col) const;
+
+    Cell& operator[](int index) { return cells[index]; }
+    const Cell& operator[](int index) const { return cells[index]; }
+
+    int rows() const { return rowsGrid; }
+    int cols() const { return colsGrid; }
+
+    static const int directions = 4; /**< Количество соседей у клетки. */
+
+private:
+    static const int tileShift = 5; /**< Логарифм стороны блока. */
+    static const int tileSide = 1 << tileShift; /**< Сторона блока. */
+    static const int tileMask = tileSide - 1;
+    static const int tileCells = tileSide * tileSide; /**< Количество клеток в блоке. */
+
+    int rowsGrid; /**< Количество строк в матрице. */
+    int colsGrid; /**< Количество столбцов в матрице. */
+    GridLayout layout; /**< Способ размещения клеток. */
+    int stride; /**< Длина строки с рамкой (для RowMajor) или количество блоков в строке (для Tiled). */
+    int offsets[4]; /**< Смещения соседей для построчного размещения. */
+    vector<Cell> cells; /**< Буфер клеток вместе с рамкой. */
+
+    int tiledNeighbour(int index, int direction) const;
+};
+
+#endif // CELLGRID_H
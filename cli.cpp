@@ -0,0 +1,424 @@
+#include "gridio.h"
+#include "gridfile.h"
+#include "watervolumesolver.h"
+#include "parallelwatervolumesolver.h"
+#include "streamingwatervolumesolver.h"
+#include "typedwatervolumesolver.h"
+#include "reconstructionwatervolumesolver.h"
+#include "terraingenerator.h"
+#include "solvecache.h"
+#include "filebatch.h"
+#include "packedgrid.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * @brief Выводит справку по параметрам командной строки.
+ * @param program Имя исполняемого файла.
+ */
+static void printUsage(const char* program) {
+    cerr << "Использование: " << program << " [параметры] [файл]\n"
+         << "       " << program << " -b [параметры] файл|каталог...\n"
+         << "Читает матрицу из файла или из стандартного ввода и выводит объем воды.\n\n"
+         << "Файл сетки (WCGRID) отображается в память и решается без копирования высот;\n"
+         << "сжатый файл сетки (WCPACK) распаковывается блоками в -t потоков,\n"
+         << "а dfs и pfplus загружают его блок за блоком прямо в рабочую сетку;\n"
+         << "иначе .bin читается как старый формат приложения, остальное - как текст:\n"
+         << "количество строк и столбцов, затем высоты построчно.\n\n"
+         << "Параметры:\n"
+         << "  -m, --matrix         вывести рабочую матрицу после объема\n"
+         << "  -e, --engine ИМЯ     алгоритм: dfs, pfplus, parallel, streaming, native,\n"
+         << "                       reconstruction (по умолчанию parallel)\n"
+         << "  -t, --threads N      количество потоков для parallel (0 - по числу ядер)\n"
+         << "  -s, --save ФАЙЛ      сохранить входную матрицу в формате файла сетки (.wcp - в сжатом)\n"
+         << "      --memory МБ      предел памяти для streaming (по умолчанию 512)\n"
+         << "      --output ФАЙЛ    файл сетки для уровней воды (для streaming)\n"
+         << "  -g, --generate ВИД   решить сгенерированный рельеф вместо файла: uniform, plateau, bowls,\n"
+         << "                       spiral, ramp, fractal, serpentine\n"
+         << "      --size СТРОКИxСТОЛБЦЫ  размер сгенерированного рельефа (по умолчанию 1000x1000)\n"
+         << "      --seed N         зерно генератора рельефа (по умолчанию 1)\n"
+         << "      --stats          вывести счетчики решения в стандартный поток ошибок (JSON)\n"
+         << "      --trace ФАЙЛ     записать этапы решения в формате Trace Event (chrome://tracing)\n"
+         << "      --cache КАТАЛОГ  брать объем и рабочую матрицу из кэша решений в каталоге и пополнять его\n"
+         << "                       (каталог не больше 1 ГБ, давно не использованные файлы удаляются)\n"
+         << "      --basins         вывести таблицу озер (номер, уровень, объем, площадь, клетка перелива);\n"
+         << "                       с -m также матрицу номеров озер (-1 - суша); только dfs и pfplus\n"
+         << "      --fill-tree      вывести дерево заполнения (номер, родитель, дно, уровень слияния, клетка, емкость)\n"
+         << "      --fill-level H   вывести объем каждого озера при уровне воды H\n"
+         << "      --pour СТРОКА,СТОЛБЕЦ,ОБЪЕМ  вылить объем в клетку: узел, уровень воды и перелив;\n"
+         << "                       дерево заполнения есть только у dfs и pfplus\n"
+         << "  -b, --batch          решить все перечисленные файлы и файлы каталогов в пуле потоков (-t);\n"
+         << "                       по строке на файл сразу после решения, код 1 при ошибке хотя бы в одном\n"
+         << "      --format ВИД     формат строк пакета: json (по умолчанию) или csv\n"
+         << "      --in-flight N    сколько прочитанных сеток пакета держать в памяти (0 - вдвое больше потоков)\n"
+         << "streaming читает файл сетки блоками и не держит его в памяти целиком.\n"
+         << "native решает высоты в их ширине из заголовка файла сетки (1, 2, 4 или 8 байт);\n"
+         << "файлы с 64-битными высотами всегда решаются им.\n"
+         << "reconstruction - морфологическая реконструкция проходами по строкам (SIMD по возможностям процессора).\n"
+         << "Счетчики есть у dfs, pfplus и parallel, если решатель собран с -DWATERCUBOIDS_STATS=ON.\n"
+         << "  -h, --help           показать эту справку\n";
+}
+
+/**
+ * @brief Точка входа консольного решателя.
+ * @param argc Количество аргументов командной строки.
+ * @param argv Массив аргументов командной строки.
+ * @return 0 при успехе, 1 при ошибке ввода, 2 при ошибке параметров.
+ */
+int main(int argc, char *argv[]) {
+    bool printMatrix = false;
+    string engine = "parallel";
+    int threads = 0;
+    string fileName = "-";
+    bool batch = false;
+    vector<string> inputs;
+    string format = "json";
+    size_t inFlight = 0;
+    string saveName;
+    string outputName;
+    size_t memoryMb = 512;
+    bool printStats = false;
+    bool printBasins = false;
+    bool printFillTree = false;
+    bool hasFillLevel = false;
+    ll fillLevel = 0;
+    bool hasPour = false;
+    int pourRow = 0;
+    int pourCol = 0;
+    ll pourVolume = 0;
+    string cacheName;
+    string traceName;
+    string terrain;
+    int generatedRows = 1000;
+    int generatedCols = 1000;
+    uint64_t seed = 1;
+
+    for (int k = 1; k < argc; k++) {
+        if (!strcmp(argv[k], "-m") || !strcmp(argv[k], "--matrix")) {
+            printMatrix = true;
+        } else if ((!strcmp(argv[k], "-e") || !strcmp(argv[k], "--engine")) && k + 1 < argc) {
+            engine = argv[++k];
+        } else if ((!strcmp(argv[k], "-t") || !strcmp(argv[k], "--threads")) && k + 1 < argc) {
+            threads = atoi(argv[++k]);
+        } else if ((!strcmp(argv[k], "-s") || !strcmp(argv[k], "--save")) && k + 1 < argc) {
+            saveName = argv[++k];
+        } else if (!strcmp(argv[k], "--memory") && k + 1 < argc) {
+            memoryMb = strtoull(argv[++k], nullptr, 10);
+        } else if (!strcmp(argv[k], "--output") && k + 1 < argc) {
+            outputName = argv[++k];
+        } else if ((!strcmp(argv[k], "-g") || !strcmp(argv[k], "--generate")) && k + 1 < argc) {
+            terrain = argv[++k];
+        } else if (!strcmp(argv[k], "--size") && k + 1 < argc) {
+            if (sscanf(argv[++k], "%dx%d", &generatedRows, &generatedCols) != 2 || generatedRows <= 0 || generatedCols <= 0) {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else if (!strcmp(argv[k], "--seed") && k + 1 < argc) {
+            seed = strtoull(argv[++k], nullptr, 10);
+        } else if (!strcmp(argv[k], "--stats")) {
+            printStats = true;
+        } else if (!strcmp(argv[k], "--cache") && k + 1 < argc) {
+            cacheName = argv[++k];
+        } else if (!strcmp(argv[k], "--basins")) {
+            printBasins = true;
+        } else if (!strcmp(argv[k], "--fill-tree")) {
+            printFillTree = true;
+        } else if (!strcmp(argv[k], "--fill-level") && k + 1 < argc) {
+            hasFillLevel = true;
+            fillLevel = strtoll(argv[++k], nullptr, 10);
+        } else if (!strcmp(argv[k], "--pour") && k + 1 < argc) {
+            if (sscanf(argv[++k], "%d,%d,%lld", &pourRow, &pourCol, &pourVolume) != 3 || pourVolume < 0) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            hasPour = true;
+        } else if (!strcmp(argv[k], "-b") || !strcmp(argv[k], "--batch")) {
+            batch = true;
+        } else if (!strcmp(argv[k], "--format") && k + 1 < argc) {
+            format = argv[++k];
+        } else if (!strcmp(argv[k], "--in-flight") && k + 1 < argc) {
+            inFlight = strtoull(argv[++k], nullptr, 10);
+        } else if (!strcmp(argv[k], "--trace") && k + 1 < argc) {
+            traceName = argv[++k];
+        } else if (!strcmp(argv[k], "-h") || !strcmp(argv[k], "--help")) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (argv[k][0] == '-' && argv[k][1] != '\0') {
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            fileName = argv[k];
+            inputs.push_back(fileName);
+        }
+    }
+    if (engine != "dfs" && engine != "pfplus" && engine != "parallel" && engine != "streaming" && engine != "native"
+            && engine != "reconstruction") {
+        cerr << "Неизвестный алгоритм: " << engine << endl;
+        return 2;
+    }
+    if (printBasins && engine != "dfs" && engine != "pfplus") {
+        cerr << "Разметка озер есть только у dfs и pfplus" << endl;
+        return 2;
+    }
+    bool needFillTree = printFillTree || hasFillLevel || hasPour;
+    if (needFillTree && engine != "dfs" && engine != "pfplus") {
+        cerr << "Дерево заполнения есть только у dfs и pfplus" << endl;
+        return 2;
+    }
+    if ((printStats || !traceName.empty()) && !SolverStats::enabled())
+        cerr << "Решатель собран без WATERCUBOIDS_STATS: счетчики будут нулевыми" << endl;
+
+    if (batch) {
+        if (format != "json" && format != "csv") {
+            cerr << "Неизвестный формат: " << format << endl;
+            return 2;
+        }
+        vector<string> files;
+        for (const string& input : inputs) {
+            if (filesystem::is_directory(input)) {
+                if (!FileBatchSolver::listDirectory(input, files)) {
+                    cerr << "Не удалось прочитать каталог: " << input << endl;
+                    return 1;
+                }
+            } else {
+                files.push_back(input);
+            }
+        }
+        if (files.empty()) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        SolveCache cache;
+        FileBatchSolver solver(threads, inFlight);
+        if (!cacheName.empty()) {
+            if (!cache.setDirectory(cacheName)) {
+                cerr << "Не удалось открыть каталог кэша: " << cacheName << endl;
+                return 1;
+            }
+            solver.setCache(&cache);
+        }
+        bool csv = format == "csv";
+        if (csv)
+            cout << resultCsvHeader() << '\n';
+        size_t failures = solver.solve(files, [csv](const FileResult& result) {
+            cout << (csv ? resultToCsv(result) : resultToJson(result)) << endl;
+        });
+        return failures ? 1 : 0;
+    }
+
+    if (engine == "streaming" && !terrain.empty()) {
+        cerr << "streaming решает только файл сетки; сохраните рельеф через --save" << endl;
+        return 2;
+    }
+    if (engine == "streaming") {
+        StreamingWaterVolumeSolver solver(fileName, outputName, memoryMb << 20);
+        ll result = solver.solve();
+        if (result < 0) {
+            cerr << "Не удалось решить файл сетки: " << fileName << endl;
+            return 1;
+        }
+        cout << result << '\n';
+        return 0;
+    }
+
+    // Файл сетки решается прямо из отображения, сжатый распаковывается параллельно,
+    // остальные форматы разбираются в построчный буфер
+    MappedGrid mapped;
+    PackedGrid packed;
+    vector<int> heights;
+    vector<int64_t> wideHeights;
+    GridView view;
+    bool packedDirect = false;
+    if (!terrain.empty()) {
+        TerrainKind kind;
+        if (!parseTerrainKind(terrain, kind)) {
+            cerr << "Неизвестный рельеф: " << terrain << endl;
+            return 2;
+        }
+        heights.resize((size_t)generatedRows * generatedCols);
+        generateTerrain(kind, generatedRows, generatedCols, seed, heights.data());
+        view = GridView(generatedRows, generatedCols, heights);
+    } else if (fileName != "-" && packed.open(fileName)) {
+        // Если матрица нужна только решателю dfs или pfplus, он загружает сжатый файл блоками сам
+        packedDirect = (engine == "dfs" || engine == "pfplus") && packed.fitsInt() && saveName.empty() && cacheName.empty() && !hasPour;
+        if (packedDirect) {
+            view.rows = packed.rows();
+            view.cols = packed.cols();
+        } else if (!packed.decode(heights, wideHeights, view, threads)) {
+            cerr << "Сжатый файл сетки поврежден: " << fileName << endl;
+            return 1;
+        }
+    } else if (fileName != "-" && mapped.open(fileName)) {
+        view = mapped.view();
+    } else {
+        int rows, cols;
+        vector<vector<int>> matrix;
+        if (!readGridFile(fileName, rows, cols, matrix)) {
+            cerr << "Не удалось прочитать матрицу: " << fileName << endl;
+            return 1;
+        }
+        heights.reserve((size_t)rows * cols);
+        for (const vector<int>& row : matrix)
+            heights.insert(heights.end(), row.begin(), row.end());
+        view = GridView(rows, cols, heights);
+    }
+
+    bool packSave = saveName.size() >= 4 && saveName.compare(saveName.size() - 4, 4, ".wcp") == 0;
+    if (!saveName.empty() && !(packSave ? writePackedGridFile(saveName, view, 0, threads) : writeGridFile(saveName, view))) {
+        cerr << "Не удалось сохранить матрицу: " << saveName << endl;
+        return 1;
+    }
+
+    // Кэш хранит только объем и уровни воды: счетчики, трасса, озера, дерево заполнения и уровни 64-битных высот требуют решения
+    SolveCache cache;
+    GridKey key;
+    bool cached = !cacheName.empty() && !printStats && traceName.empty() && !printBasins && !needFillTree && (view.fitsInt() || !printMatrix);
+    if (cached) {
+        if (!cache.setDirectory(cacheName)) {
+            cerr << "Не удалось открыть каталог кэша: " << cacheName << endl;
+            return 1;
+        }
+        key = gridKey(view);
+        ll result;
+        vector<int> levels;
+        if (cache.lookup(key, view, result, printMatrix ? &levels : nullptr)) {
+            cout << result << '\n';
+            if (printMatrix) {
+                vector<vector<int>> workingMatrix(view.rows);
+                for (int i = 0; i < view.rows; i++)
+                    workingMatrix[i].assign(levels.begin() + (size_t)i * view.cols, levels.begin() + (size_t)(i + 1) * view.cols);
+                writeTextMatrix(cout, workingMatrix);
+            }
+            return 0;
+        }
+    }
+
+    // 64-битные высоты не помещаются в int, поэтому их решает только решатель по ширине высот
+    if (engine == "native" || (!view.fitsInt() && !printBasins && !needFillTree)) {
+        ll result;
+        vector<vector<ll>> workingMatrix;
+        if (!solveNativeWidth(view, result, printMatrix ? &workingMatrix : nullptr)) {
+            cerr << "Объем воды не помещается в 64-битное целое" << endl;
+            return 1;
+        }
+        if (cached)
+            cache.store(key, view, result);
+        cout << result << '\n';
+        if (printMatrix)
+            writeTextMatrix(cout, workingMatrix);
+        return 0;
+    }
+
+    if (!view.fitsInt()) {
+        cerr << "Разметка озер не поддерживает 64-битные высоты" << endl;
+        return 1;
+    }
+
+    ll result;
+    vector<vector<int>> workingMatrix;
+    vector<Basin> basins;
+    vector<vector<int>> basinMatrix;
+    FillTree tree;
+    SolverStats stats;
+    bool hasStats = true;
+    if (engine == "parallel") {
+        ParallelWaterVolumeSolver solver(view, threads);
+        result = solver.solve();
+        if (printMatrix)
+            workingMatrix = solver.getWorkingMatrix();
+        stats = solver.stats();
+    } else if (engine == "reconstruction") {
+        ReconstructionWaterVolumeSolver solver(view);
+        result = solver.solve();
+        if (printMatrix)
+            workingMatrix = solver.getWorkingMatrix();
+        hasStats = false;
+    } else {
+        WaterVolumeSolver solver;
+        if (!packedDirect) {
+            solver.reset(view);
+        } else if (!solver.reset(packed)) {
+            cerr << "Сжатый файл сетки поврежден: " << fileName << endl;
+            return 1;
+        }
+        if (engine == "pfplus")
+            solver.setEngine(SolverEngine::PriorityFloodPlus);
+        solver.setBasinLabelling(printBasins);
+        solver.setFillTree(needFillTree);
+        result = solver.solve();
+        if (printMatrix)
+            workingMatrix = solver.getWorkingMatrix();
+        if (printBasins) {
+            basins = solver.basins();
+            if (printMatrix)
+                basinMatrix = solver.getBasinMatrix();
+        }
+        if (needFillTree)
+            tree = solver.fillTree();
+        stats = solver.stats();
+    }
+
+    if (cached) {
+        vector<int> levels;
+        for (const vector<int>& row : workingMatrix)
+            levels.insert(levels.end(), row.begin(), row.end());
+        cache.store(key, view, result, printMatrix ? levels.data() : nullptr);
+    }
+
+    cout << result << '\n';
+    if (printMatrix)
+        writeTextMatrix(cout, workingMatrix);
+    if (printBasins) {
+        cout << basins.size() << '\n';
+        for (size_t b = 0; b < basins.size(); b++) {
+            cout << b << ' ' << basins[b].level << ' ' << basins[b].volume << ' ' << basins[b].area << ' '
+                 << basins[b].spillRow << ' ' << basins[b].spillCol << '\n';
+        }
+        if (printMatrix)
+            writeTextMatrix(cout, basinMatrix);
+    }
+    if (printFillTree) {
+        const vector<FillNode>& nodes = tree.nodes();
+        cout << nodes.size() << '\n';
+        for (size_t v = 0; v < nodes.size(); v++) {
+            cout << v << ' ' << nodes[v].parent << ' ' << nodes[v].bottom << ' ' << nodes[v].top << ' '
+                 << nodes[v].row << ' ' << nodes[v].col << ' ' << nodes[v].capacity << '\n';
+        }
+    }
+    if (hasFillLevel) {
+        for (int lake : tree.lakes())
+            cout << lake << ' ' << tree.volumeAt(lake, fillLevel) << '\n';
+    }
+    if (hasPour) {
+        if (pourRow < 0 || pourRow >= view.rows || pourCol < 0 || pourCol >= view.cols) {
+            cerr << "Клетка вне матрицы: " << pourRow << ',' << pourCol << endl;
+            return 1;
+        }
+        int node = tree.nodeAt(pourRow, pourCol);
+        if (node < 0) {
+            // Над сушей вода не задерживается: весь объем стекает с клетки
+            cout << "-1 " << view.at(pourRow, pourCol) << ' ' << pourVolume << '\n';
+        } else {
+            FillResult fill = tree.pour(node, pourVolume);
+            cout << fill.node << ' ' << fill.level << ' ' << fill.overflow << '\n';
+        }
+    }
+
+    if (hasStats && printStats)
+        cerr << statsToJson(stats, engine) << endl;
+    if (hasStats && !traceName.empty()) {
+        ofstream trace(traceName);
+        if (!(trace << statsToTraceEvents(stats, engine))) {
+            cerr << "Не удалось записать трассу: " << traceName << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "filebatch.h"
+#include "gridfile.h"
+#include "gridio.h"
+#include "packedgrid.h"
+#include "watervolumesolver.h"
+#include "parallelwatervolumesolver.h"
+#include "typedwatervolumesolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+/**
+ * @brief Прочитанная сетка, ожидающая решения.
+ */
+struct GridTask {
+    FileResult result; /**< Результат, заполняется по мере чтения и решения. */
+    vector<int> heights; /**< Высоты построчно (для сеток, помещающихся в int). */
+    vector<int64_t> wideHeights; /**< Распакованные 64-битные высоты сжатого файла. */
+    unique_ptr<MappedGrid> mapped; /**< Отображение файла с 64-битными высотами. */
+    unique_ptr<PackedGrid> packed; /**< Сжатый файл небольшой сетки: решатель загружает его сам, блок за блоком. */
+    GridView view; /**< Матрица высот для решателя. */
+};
+
+/**
+ * @brief Очередь рабочего потока: владелец берет сетки с начала, другие потоки забирают с конца.
+ */
+struct WorkerQueue {
+    mutex lock; /**< Защищает tasks. */
+    deque<unique_ptr<GridTask>> tasks; /**< Сетки в порядке раздачи. */
+};
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Читает файл в задачу.
+ * Высоты до 32 бит копируются из отображения в буфер, чтобы чтение диска прошло здесь,
+ * а не в рабочем потоке; 64-битные остаются в отображении для решателя по ширине высот.
+ * Сжатый файл сетки меньше directCells клеток не распаковывается: решатель загрузит его в рабочую
+ * сетку блок за блоком без буфера всей матрицы. Остальные сжатые файлы распаковываются блоками
+ * в threads потоков.
+ * @return false, если файл не удалось прочитать.
+ */
+bool readTask(GridTask& task, int threads, size_t directCells) {
+    const string& fileName = task.result.fileName;
+    PackedGrid packed;
+    if (packed.open(fileName)) {
+        task.result.rows = packed.rows();
+        task.result.cols = packed.cols();
+        if (packed.fitsInt() && (size_t)packed.rows() * packed.cols() < directCells) {
+            task.packed.reset(new PackedGrid(move(packed)));
+            return true;
+        }
+        return packed.decode(task.heights, task.wideHeights, task.view, threads);
+    }
+    unique_ptr<MappedGrid> mapped(new MappedGrid());
+    if (mapped->open(fileName)) {
+        GridView view = mapped->view();
+        task.result.rows = view.rows;
+        task.result.cols = view.cols;
+        if (!view.fitsInt()) {
+            task.view = view;
+            task.mapped = move(mapped);
+            return true;
+        }
+        task.heights.resize((size_t)view.rows * view.cols);
+        for (int i = 0; i < view.rows; i++) {
+            int* row = &task.heights[(size_t)i * view.cols];
+            for (int j = 0; j < view.cols; j++)
+                row[j] = view.at(i, j);
+        }
+    } else {
+        vector<vector<int>> matrix;
+        if (!readGridFile(fileName, task.result.rows, task.result.cols, matrix))
+            return false;
+        task.heights.reserve((size_t)task.result.rows * task.result.cols);
+        for (const vector<int>& row : matrix)
+            task.heights.insert(task.heights.end(), row.begin(), row.end());
+    }
+    task.view = GridView(task.result.rows, task.result.cols, task.heights);
+    return true;
+}
+
+/**
+ * @brief Добавляет строку в JSON с экранированием.
+ */
+void appendJsonString(string& out, const string& value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+/**
+ * @brief Добавляет поле CSV, заключая его в кавычки, если в нем есть запятая, кавычка или перевод строки.
+ */
+void appendCsvField(string& out, const string& value) {
+    if (value.find_first_of(",\"\n\r") == string::npos) {
+        out += value;
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+}
+
+/**
+ * @brief Конструктор класса FileBatchSolver.
+ * @param threads Количество рабочих потоков (0 - по числу ядер).
+ * @param maxInFlight Наибольшее количество сеток в памяти (0 - вдвое больше потоков).
+ */
+FileBatchSolver::FileBatchSolver(int threads, size_t maxInFlight)
+    : threads(threads > 0 ? threads : max(1u, thread::hardware_concurrency())),
+      maxInFlight(maxInFlight > 0 ? maxInFlight : 2 * (size_t)this->threads) {}
+
+/**
+ * @brief Решает файлы.
+ * Файлы читает пул из min(threads, количество файлов) потоков, включая вызывающий, и раздает
+ * сетки по очередям рабочих потоков по кругу; крупные файлы читаются первыми, чтобы в конце
+ * пакета на ядрах оставались только мелкие сетки.
+ * @param files Имена файлов.
+ * @param done Вызывается для каждого файла сразу после решения.
+ * @return Количество файлов, которые не удалось решить.
+ */
+size_t FileBatchSolver::solve(const vector<string>& files, const function<void(const FileResult&)>& done) {
+    vector<pair<uintmax_t, string>> order;
+    for (const string& file : files) {
+        error_code error;
+        uintmax_t size = filesystem::file_size(file, error);
+        order.emplace_back(error ? 0 : size, file);
+    }
+    stable_sort(order.begin(), order.end(), [](const pair<uintmax_t, string>& a, const pair<uintmax_t, string>& b) {
+        return a.first > b.first;
+    });
+
+    vector<WorkerQueue> queues(threads);
+    mutex stateLock;
+    condition_variable stateChanged;
+    size_t inFlight = 0; // Читаемые и прочитанные, но еще не решенные сетки
+    size_t queued = 0; // Сетки в очередях
+    size_t nextFile = 0; // Следующий файл для чтения
+    size_t nextQueue = 0; // Очередь для следующей прочитанной сетки
+    bool reading = true;
+    mutex outputLock;
+    size_t failures = 0;
+
+    auto report = [&](const FileResult& result) {
+        lock_guard<mutex> guard(outputLock);
+        if (!result.error.empty())
+            failures++;
+        done(result);
+    };
+
+    // Своя очередь - с начала, чужие - с конца, начиная со следующего потока
+    auto take = [&](int w) -> unique_ptr<GridTask> {
+        for (int k = 0; k < threads; k++) {
+            WorkerQueue& queue = queues[(w + k) % threads];
+            lock_guard<mutex> guard(queue.lock);
+            if (queue.tasks.empty())
+                continue;
+            unique_ptr<GridTask> task;
+            if (k == 0) {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return task;
+        }
+        return nullptr;
+    };
+
+    auto work = [&](int w) {
+        WaterVolumeSolver solver;
+        solver.setEngine(SolverEngine::PriorityFloodPlus);
+        while (true) {
+            unique_ptr<GridTask> task = take(w);
+            if (!task) {
+                unique_lock<mutex> lock(stateLock);
+                stateChanged.wait(lock, [&]() { return queued > 0 || !reading; });
+                if (queued == 0 && !reading)
+                    return;
+                continue;
+            }
+            {
+                lock_guard<mutex> guard(stateLock);
+                queued--;
+            }
+
+            FileResult& result = task->result;
+            const GridView& view = task->view;
+            auto start = chrono::steady_clock::now();
+            GridKey key;
+            if (solveCache) {
+                key = gridKey(view);
+                result.cached = solveCache->lookup(key, view, result.volume);
+            }
+            if (result.cached) {
+                // Объем уже найден в кэше
+            } else if (task->packed) {
+                if (solver.reset(*task->packed)) {
+                    result.volume = solver.solve();
+                } else {
+                    result.volume = -1;
+                    result.error = "сжатый файл сетки поврежден";
+                }
+            } else if (!view.fitsInt()) {
+                if (!solveNativeWidth(view, result.volume)) {
+                    result.volume = -1;
+                    result.error = "объем воды не помещается в 64-битное целое";
+                }
+            } else if ((size_t)view.rows * view.cols >= parallelCells) {
+                ParallelWaterVolumeSolver parallel(view, threads);
+                result.volume = parallel.solve();
+            } else {
+                solver.reset(view);
+                result.volume = solver.solve();
+            }
+            if (solveCache && !result.cached && result.error.empty())
+                solveCache->store(key, view, result.volume);
+            result.solveSeconds = secondsSince(start);
+
+            // Память сетки освобождается до отчета, чтобы следующая сетка могла читаться сразу
+            FileResult finished = move(result);
+            task.reset();
+            {
+                lock_guard<mutex> guard(stateLock);
+                inFlight--;
+            }
+            stateChanged.notify_all();
+            report(finished);
+        }
+    };
+
+    vector<thread> pool;
+    for (int w = 0; w < threads; w++)
+        pool.emplace_back(work, w);
+
+    // Сжатые файлы распаковываются в несколько потоков, только если читателей меньше ядер
+    int readers = (int)max((size_t)1, min((size_t)threads, order.size()));
+    int decodeThreads = max(1, threads / readers);
+    auto read = [&]() {
+        while (true) {
+            size_t file;
+            {
+                unique_lock<mutex> lock(stateLock);
+                stateChanged.wait(lock, [&]() { return inFlight < maxInFlight || nextFile == order.size(); });
+                if (nextFile == order.size())
+                    return;
+                file = nextFile++;
+                inFlight++;
+            }
+            unique_ptr<GridTask> task(new GridTask());
+            task->result.fileName = order[file].second;
+            auto start = chrono::steady_clock::now();
+            // Без кэша небольшие сжатые сетки загружаются прямо в решатель: ключ кэша считается по матрице
+            bool ok = readTask(*task, decodeThreads, solveCache ? 0 : parallelCells);
+            task->result.readSeconds = secondsSince(start);
+            if (!ok) {
+                task->result.error = "не удалось прочитать матрицу";
+                {
+                    lock_guard<mutex> guard(stateLock);
+                    inFlight--;
+                }
+                stateChanged.notify_all();
+                report(task->result);
+                continue;
+            }
+            // Сетка кладется в очередь и учитывается в queued под одной блокировкой: иначе рабочий
+            // поток мог бы забрать ее и уменьшить счетчик раньше, чем тот увеличен
+            {
+                lock_guard<mutex> guard(stateLock);
+                WorkerQueue& queue = queues[nextQueue++ % threads];
+                lock_guard<mutex> queueGuard(queue.lock);
+                queue.tasks.push_back(move(task));
+                queued++;
+            }
+            stateChanged.notify_all();
+        }
+    };
+    vector<thread> readerPool;
+    for (int r = 1; r < readers; r++)
+        readerPool.emplace_back(read);
+    read();
+    for (thread& reader : readerPool)
+        reader.join();
+    {
+        lock_guard<mutex> guard(stateLock);
+        reading = false;
+    }
+    stateChanged.notify_all();
+    for (thread& worker : pool)
+        worker.join();
+    return failures;
+}
+
+/**
+ * @brief Возвращает обычные файлы каталога, отсортированные по имени (без подкаталогов).
+ * @param directory Каталог.
+ * @param files Найденные файлы добавляются сюда.
+ * @return false, если каталог не удалось прочитать.
+ */
+bool FileBatchSolver::listDirectory(const string& directory, vector<string>& files) {
+    error_code error;
+    filesystem::directory_iterator it(directory, error);
+    if (error)
+        return false;
+    vector<string> found;
+    for (const filesystem::directory_entry& entry : it) {
+        if (entry.is_regular_file(error))
+            found.push_back(entry.path().string());
+    }
+    sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
+
+/**
+ * @brief Записывает результат строкой JSON.
+ * @param result Результат решения файла.
+ */
+string resultToJson(const FileResult& result) {
+    string out = "{\"file\":";
+    appendJsonString(out, result.fileName);
+    char fields[256];
+    snprintf(fields, sizeof(fields), ",\"rows\":%d,\"cols\":%d,\"volume\":%lld,\"read_seconds\":%.6f,\"solve_seconds\":%.6f,\"cached\":%s",
+             result.rows, result.cols, result.volume, result.readSeconds, result.solveSeconds, result.cached ? "true" : "false");
+    out += fields;
+    if (!result.error.empty()) {
+        out += ",\"error\":";
+        appendJsonString(out, result.error);
+    }
+    out += '}';
+    return out;
+}
+
+/**
+ * @brief Записывает результат строкой CSV (поля как в resultCsvHeader()).
+ * @param result Результат решения файла.
+ */
+string resultToCsv(const FileResult& result) {
+    string out;
+    appendCsvField(out, result.fileName);
+    char fields[256];
+    snprintf(fields, sizeof(fields), ",%d,%d,%lld,%.6f,%.6f,%d,", result.rows, result.cols, result.volume,
+             result.readSeconds, result.solveSeconds, result.cached ? 1 : 0);
+    out += fields;
+    appendCsvField(out, result.error);
+    return out;
+}
+
+/**
+ * @brief Возвращает строку заголовка CSV.
+ */
+const char* resultCsvHeader() {
+    return "file,rows,cols,volume,read_seconds,solve_seconds,cached,error";
+}
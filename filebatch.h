@@ -0,0 +1,98 @@
+#ifndef FILEBATCH_H
+#define FILEBATCH_H
+
+#include "solvecache.h"
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Результат решения одного файла пакета.
+ */
+struct FileResult {
+    string fileName; /**< Имя файла. */
+    int rows = 0; /**< Количество строк в матрице. */
+    int cols = 0; /**< Количество столбцов в матрице. */
+    ll volume = -1; /**< Объем воды (-1 при ошибке). */
+    double readSeconds = 0; /**< Время чтения файла. */
+    double solveSeconds = 0; /**< Время решения. */
+    bool cached = false; /**< Решение взято из кэша. */
+    string error; /**< Описание ошибки (пусто при успехе). */
+};
+
+/**
+ * @brief Класс FileBatchSolver решает много файлов сеток в пуле потоков с перехватом работы.
+ * Пул потоков чтения (не больше threads) читает файлы от больших к маленьким и раздает сетки
+ * по очередям рабочих потоков; поток, у которого закончилась работа, забирает сетки из чужих
+ * очередей. Маленькие сетки решаются по одной на поток решателем, который переиспользует память, большие (от
+ * parallelCells клеток) - многопоточным решателем по блокам на всех ядрах. Прочитанных, но еще
+ * не решенных сеток не больше maxInFlight, поэтому память ограничена независимо от числа файлов.
+ * Результат каждого файла отдается сразу после решения.
+ */
+class FileBatchSolver {
+public:
+    /**
+     * @brief Конструктор класса FileBatchSolver.
+     * @param threads Количество рабочих потоков (0 - по числу ядер).
+     * @param maxInFlight Наибольшее количество сеток в памяти (0 - вдвое больше потоков).
+     */
+    explicit FileBatchSolver(int threads = 0, size_t maxInFlight = 0);
+
+    /**
+     * @brief Подключает кэш решений (nullptr - без кэша).
+     */
+    void setCache(SolveCache* cache) { solveCache = cache; }
+
+    /**
+     * @brief Задает размер сетки, начиная с которого она решается многопоточным решателем.
+     * @param cells Количество клеток.
+     */
+    void setParallelCells(size_t cells) { parallelCells = cells; }
+
+    /**
+     * @brief Решает файлы.
+     * @param files Имена файлов (файл сетки, сжатый файл сетки, .bin приложения или текст).
+     * @param done Вызывается для каждого файла сразу после решения; вызовы не пересекаются,
+     * но идут из рабочих потоков и в порядке окончания решений.
+     * @return Количество файлов, которые не удалось решить.
+     */
+    size_t solve(const vector<string>& files, const function<void(const FileResult&)>& done);
+
+    /**
+     * @brief Возвращает обычные файлы каталога, отсортированные по имени (без подкаталогов).
+     * @param directory Каталог.
+     * @param files Найденные файлы добавляются сюда.
+     * @return false, если каталог не удалось прочитать.
+     */
+    static bool listDirectory(const string& directory, vector<string>& files);
+
+    static const size_t defaultParallelCells = (size_t)1 << 20; /**< Порог многопоточного решения по умолчанию. */
+
+private:
+    int threads; /**< Количество рабочих потоков. */
+    size_t maxInFlight; /**< Наибольшее количество сеток в памяти. */
+    size_t parallelCells = defaultParallelCells; /**< Порог многопоточного решения. */
+    SolveCache* solveCache = nullptr; /**< Кэш решений. */
+};
+
+/**
+ * @brief Записывает результат строкой JSON.
+ * @param result Результат решения файла.
+ */
+string resultToJson(const FileResult& result);
+
+/**
+ * @brief Записывает результат строкой CSV (поля как в resultCsvHeader()).
+ * @param result Результат решения файла.
+ */
+string resultToCsv(const FileResult& result);
+
+/**
+ * @brief Возвращает строку заголовка CSV.
+ */
+const char* resultCsvHeader();
+
+#endif // FILEBATCH_H
@@ -0,0 +1,355 @@
+#include "filltree.h"
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * @brief Упорядочивает клетки по высоте устойчивой поразрядной сортировкой (два прохода по 16 бит).
+ * Проход, в котором у всех клеток одинаковая цифра, пропускается: на узком диапазоне высот
+ * сортировка стоит одного подсчета.
+ * @param cells Клетки.
+ * @param order Номера клеток по возрастанию высоты (при равной высоте - в исходном порядке).
+ */
+static void sortByHeight(const vector<FloodedCell>& cells, vector<int>& order) {
+    int count = (int)cells.size();
+    order.resize(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    vector<int> buffer(count);
+    vector<int> start(1 << 16);
+    for (int shift = 0; shift < 32; shift += 16) {
+        auto digit = [&](int i) { return (((uint32_t)cells[i].height ^ 0x80000000u) >> shift) & 0xffff; };
+        fill(start.begin(), start.end(), 0);
+        for (int i = 0; i < count; i++)
+            start[digit(i)]++;
+        if (count == 0 || start[digit(0)] == count)
+            continue;
+        int sum = 0;
+        for (int& bucket : start) {
+            int size = bucket;
+            bucket = sum;
+            sum += size;
+        }
+        for (int i : order)
+            buffer[start[digit(i)]++] = i;
+        order.swap(buffer);
+    }
+}
+
+/**
+ * @brief Строит дерево по затопленным клеткам.
+ * Клетки обрабатываются по возрастанию высоты. Соседние уже обработанные части делятся на
+ * старые (дно ниже текущей высоты) и свежие (заведены на этой же высоте). Две и больше старых
+ * части становятся дочерними узлами узла слияния; свежие части поглощаются, чтобы плато не
+ * порождало узлов с пустым диапазоном уровней.
+ * @param cols Количество столбцов в матрице.
+ * @param cells Все клетки, у которых уровень воды выше высоты, по строкам.
+ */
+void FillTree::build(int cols, const vector<FloodedCell>& cells) {
+    clear();
+    colsGrid = cols;
+    int count = (int)cells.size();
+    cellIndex.resize(count);
+    for (int i = 0; i < count; i++)
+        cellIndex[i] = (ll)cells[i].row * cols + cells[i].col;
+    // Соседи сверху и снизу находятся одним проходом двух указателей по упорядоченным индексам
+    vector<int> above(count, -1), below(count, -1);
+    for (int p = 0, q = 0; p < count; p++) {
+        ll wanted = cellIndex[p] + cols;
+        q = max(q, p + 1);
+        while (q < count && cellIndex[q] < wanted)
+            q++;
+        if (q < count && cellIndex[q] == wanted) {
+            below[p] = q;
+            above[q] = p;
+        }
+    }
+    vector<int> order;
+    sortByHeight(cells, order);
+
+    // Узлы, их дочерние узлы и точки излома во время построения - списки в общих массивах,
+    // чтобы миллион мелких узлов не стоил миллиона выделений памяти
+    vector<FillNode> building;
+    vector<int> lastPoint, firstChild, nextSibling, absorbedInto;
+    vector<Point> buildPoints;
+    vector<int> previousPoint;
+    auto addNode = [&](const FloodedCell& cell) {
+        building.push_back(FillNode{-1, cell.height, cell.height, cell.row, cell.col, 0});
+        lastPoint.push_back(-1);
+        firstChild.push_back(-1);
+        nextSibling.push_back(-1);
+        absorbedInto.push_back(-1);
+        return (int)building.size() - 1;
+    };
+    auto addChild = [&](int n, int child) {
+        building[child].parent = n;
+        nextSibling[child] = firstChild[n];
+        firstChild[n] = child;
+    };
+
+    // Система непересекающихся множеств по клеткам; все поля части рядом, чтобы обращение
+    // к соседу в порядке высот стоило одного промаха кэша (parent = -1 - клетка еще не обработана)
+    struct Component {
+        int parent; /**< Родитель в системе множеств. */
+        int node; /**< Узел части (у корня множества). */
+        ll area; /**< Количество клеток части (у корня). */
+        ll heightSum; /**< Сумма высот клеток части (у корня). */
+    };
+    vector<Component> components(count, Component{-1, -1, 0, 0});
+    cellNode.assign(count, -1);
+    auto findRoot = [&](int x) {
+        while (components[x].parent != x) {
+            components[x].parent = components[components[x].parent].parent;
+            x = components[x].parent;
+        }
+        return x;
+    };
+
+    vector<int> roots, old, freshLeaves, freshMerges;
+    for (int c : order) {
+        const FloodedCell& cell = cells[c];
+        int h = cell.height;
+        ll index = cellIndex[c];
+        int neighbours[4] = {
+            cell.col > 0 && c > 0 && cellIndex[c - 1] == index - 1 ? c - 1 : -1,
+            cell.col < cols - 1 && c + 1 < count && cellIndex[c + 1] == index + 1 ? c + 1 : -1,
+            above[c],
+            below[c],
+        };
+        roots.clear();
+        for (int v : neighbours) {
+            if (v < 0 || components[v].parent < 0)
+                continue;
+            int root = findRoot(v);
+            if (find(roots.begin(), roots.end(), root) == roots.end())
+                roots.push_back(root);
+        }
+
+        old.clear();
+        freshLeaves.clear();
+        freshMerges.clear();
+        for (int root : roots) {
+            int n = components[root].node;
+            if (building[n].bottom < h)
+                old.push_back(n);
+            else if (firstChild[n] < 0)
+                freshLeaves.push_back(n);
+            else
+                freshMerges.push_back(n);
+        }
+        int target;
+        if (!freshMerges.empty())
+            target = freshMerges[0];
+        else if (old.size() >= 2)
+            target = addNode(cell);
+        else if (old.size() == 1)
+            target = old[0];
+        else if (!freshLeaves.empty())
+            target = freshLeaves[0];
+        else
+            target = addNode(cell);
+
+        auto absorb = [&](int n) {
+            if (n == target)
+                return;
+            for (int child = firstChild[n]; child >= 0;) {
+                int next = nextSibling[child];
+                addChild(target, child);
+                child = next;
+            }
+            firstChild[n] = -1;
+            absorbedInto[n] = target;
+        };
+        for (int n : freshMerges)
+            absorb(n);
+        for (int n : freshLeaves)
+            absorb(n);
+        for (int n : old) {
+            if (n == target)
+                continue;
+            building[n].top = h;
+            addChild(target, n);
+        }
+
+        // Объединение по размеру: меньшая часть подвешивается к большей
+        components[c] = Component{c, -1, 1, h};
+        int merged = c;
+        for (int root : roots) {
+            int a = findRoot(root), b = merged;
+            if (components[a].area < components[b].area)
+                swap(a, b);
+            components[b].parent = a;
+            components[a].area += components[b].area;
+            components[a].heightSum += components[b].heightSum;
+            merged = a;
+        }
+        const Component& component = components[merged];
+        components[merged].node = target;
+        cellNode[c] = target;
+
+        Point point{h, component.area, component.heightSum, component.area * h - component.heightSum};
+        int last = lastPoint[target];
+        if (last >= 0 && buildPoints[last].height == h) {
+            buildPoints[last] = point;
+        } else {
+            buildPoints.push_back(point);
+            previousPoint.push_back(last);
+            lastPoint[target] = (int)buildPoints.size() - 1;
+        }
+    }
+
+    // У всех клеток озера один уровень, он и есть уровень перелива корня
+    for (int c = 0; c < count; c++) {
+        if (components[c].parent == c)
+            building[components[c].node].top = cells[c].level;
+    }
+
+    // Поглощенные узлы выбрасываются; дочерние узлы заведены раньше родителей, порядок сохраняется
+    vector<int> renumber(building.size(), -1);
+    for (size_t n = 0; n < building.size(); n++) {
+        if (absorbedInto[n] < 0) {
+            renumber[n] = (int)nodeTable.size();
+            nodeTable.push_back(building[n]);
+        }
+    }
+    pointStart.push_back(0);
+    for (size_t n = 0; n < building.size(); n++) {
+        if (absorbedInto[n] >= 0)
+            continue;
+        FillNode& node = nodeTable[renumber[n]];
+        if (node.parent >= 0)
+            node.parent = renumber[node.parent];
+        else
+            lakeTable.push_back(renumber[n]);
+        const Point& last = buildPoints[lastPoint[n]];
+        node.capacity = last.area * node.top - last.heightSum;
+        // Список точек узла идет от последней к первой
+        size_t first = points.size();
+        for (int p = lastPoint[n]; p >= 0; p = previousPoint[p])
+            points.push_back(buildPoints[p]);
+        reverse(points.begin() + first, points.end());
+        pointStart.push_back((int)points.size());
+    }
+    for (int& n : cellNode) {
+        while (absorbedInto[n] >= 0)
+            n = absorbedInto[n];
+        n = renumber[n];
+    }
+
+    int nodes = (int)nodeTable.size();
+    ancestors.assign(1, vector<int>(nodes));
+    for (int v = 0; v < nodes; v++)
+        ancestors[0][v] = nodeTable[v].parent;
+    while ((1 << ancestors.size()) < nodes) {
+        const vector<int>& below = ancestors.back();
+        vector<int> next(nodes);
+        for (int v = 0; v < nodes; v++)
+            next[v] = below[v] < 0 ? -1 : below[below[v]];
+        ancestors.push_back(move(next));
+    }
+}
+
+/**
+ * @brief Строит дерево по высотам и рабочей матрице любого решателя.
+ * @param view Матрица высот (до 32 бит).
+ * @param levels Уровни воды построчно.
+ */
+void FillTree::build(const GridView& view, const vector<int>& levels) {
+    vector<FloodedCell> cells;
+    for (int i = 0; i < view.rows; i++) {
+        for (int j = 0; j < view.cols; j++) {
+            int height = view.at(i, j);
+            int level = levels[(size_t)i * view.cols + j];
+            if (level > height)
+                cells.push_back(FloodedCell{height, level, i, j});
+        }
+    }
+    build(view.cols, cells);
+}
+
+/**
+ * @brief Удаляет дерево.
+ */
+void FillTree::clear() {
+    nodeTable.clear();
+    lakeTable.clear();
+    pointStart.clear();
+    points.clear();
+    cellIndex.clear();
+    cellNode.clear();
+    ancestors.clear();
+}
+
+/**
+ * @brief Возвращает самый глубокий узел, которому принадлежит клетка.
+ * @param row Строка клетки.
+ * @param col Столбец клетки.
+ * @return Номер узла или -1, если над клеткой нет воды.
+ */
+int FillTree::nodeAt(int row, int col) const {
+    ll index = (ll)row * colsGrid + col;
+    auto it = lower_bound(cellIndex.begin(), cellIndex.end(), index);
+    if (it == cellIndex.end() || *it != index)
+        return -1;
+    return cellNode[it - cellIndex.begin()];
+}
+
+/**
+ * @brief Возвращает объем воды в узле при заданном уровне.
+ * @param node Номер узла.
+ * @param level Уровень воды (ограничивается диапазоном bottom..top узла).
+ */
+ll FillTree::volumeAt(int node, ll level) const {
+    const FillNode& fillNode = nodeTable[node];
+    level = max((ll)fillNode.bottom, min((ll)fillNode.top, level));
+    auto first = points.begin() + pointStart[node];
+    auto last = points.begin() + pointStart[node + 1];
+    auto it = upper_bound(first, last, level, [](ll value, const Point& point) { return value < point.height; });
+    const Point& point = *(it - 1);
+    return point.area * level - point.heightSum;
+}
+
+/**
+ * @brief Возвращает уровень, до которого поднимется вода в узле при заданном объеме.
+ * Если объема не хватает даже на заполнение дочерних узлов до седловины, уровень равен дну узла.
+ * @param node Номер узла.
+ * @param volume Объем воды (ограничивается диапазоном 0..capacity узла).
+ */
+double FillTree::levelFor(int node, ll volume) const {
+    const FillNode& fillNode = nodeTable[node];
+    if (volume >= fillNode.capacity)
+        return fillNode.top;
+    auto first = points.begin() + pointStart[node];
+    auto last = points.begin() + pointStart[node + 1];
+    auto it = upper_bound(first, last, volume, [](ll value, const Point& point) { return value < point.volume; });
+    if (it == first)
+        return fillNode.bottom;
+    const Point& point = *(it - 1);
+    return point.height + (double)(volume - point.volume) / point.area;
+}
+
+/**
+ * @brief Выливает воду в узел.
+ * Емкость не убывает от узла к предкам, поэтому ближайший вмещающий предок ищется двоичными прыжками.
+ * Объем сверх емкости дочернего узла сначала заполняет соседние части до седловины.
+ * @param node Номер узла.
+ * @param volume Объем воды.
+ */
+FillResult FillTree::pour(int node, ll volume) const {
+    int x = node;
+    if (nodeTable[x].capacity < volume) {
+        for (int k = (int)ancestors.size() - 1; k >= 0; k--) {
+            int above = ancestors[k][x];
+            if (above >= 0 && nodeTable[above].capacity < volume)
+                x = above;
+        }
+        if (nodeTable[x].parent < 0)
+            return FillResult{x, (double)nodeTable[x].top, volume - nodeTable[x].capacity};
+        // Пока соседние части не заполнены до седловины, вода со стороны выливания стоит на ее уровне
+        int saddle = nodeTable[x].top;
+        x = nodeTable[x].parent;
+        if (volume <= volumeAt(x, saddle))
+            return FillResult{x, (double)saddle, 0};
+    }
+    return FillResult{x, levelFor(x, volume), 0};
+}
@@ -0,0 +1,136 @@
+#ifndef FILLTREE_H
+#define FILLTREE_H
+
+#include "gridview.h"
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Затопленная клетка, из которой строится дерево заполнения.
+ */
+struct FloodedCell {
+    int height; /**< Высота столбца. */
+    int level; /**< Уровень воды при полном заполнении (больше высоты). */
+    int row; /**< Строка клетки. */
+    int col; /**< Столбец клетки. */
+};
+
+/**
+ * @brief Узел дерева заполнения: связная часть озера ниже уровня слияния с соседней частью.
+ */
+struct FillNode {
+    int parent; /**< Узел, в который сливается этот (-1 - озеро целиком). */
+    int bottom; /**< Высота, с которой начинается узел: дно листа или седловина узла слияния. */
+    int top; /**< Уровень слияния с соседней частью (у озера - уровень перелива). */
+    int row; /**< Строка самой низкой клетки листа или седловины, на которой слились дочерние узлы. */
+    int col; /**< Столбец той же клетки. */
+    ll capacity; /**< Объем воды при уровне top. */
+};
+
+/**
+ * @brief Результат выливания воды в узел дерева заполнения.
+ */
+struct FillResult {
+    int node; /**< Узел, в котором стоит вода (он сам или предок). */
+    double level; /**< Уровень воды со стороны выливания. */
+    ll overflow; /**< Объем, ушедший через перелив озера. */
+};
+
+/**
+ * @brief Класс FillTree отвечает на вопросы о частичном заполнении озер без повторного решения.
+ * Дерево строится только по затопленным клеткам: у части озера ниже уровня слияния все клетки
+ * затоплены, поэтому суша в дереве не участвует. Клетки перебираются по возрастанию высоты и
+ * объединяются с затопленными соседями системой непересекающихся множеств. Когда клетка соединяет
+ * несколько частей, заведенных ниже ее высоты, появляется узел слияния; части на одной высоте
+ * (плато) узлов не заводят. Для каждого узла запоминаются точки излома: высота, количество клеток
+ * и сумма их высот, начиная с которой объем при уровне L равен area * L - sum. Поэтому объем при
+ * уровне, уровень при объеме и выливание воды (с подъемом к предкам по двоичным прыжкам) стоят
+ * O(log n) и не трогают сетку.
+ */
+class FillTree {
+public:
+    /**
+     * @brief Строит дерево по затопленным клеткам.
+     * @param cols Количество столбцов в матрице.
+     * @param cells Все клетки, у которых уровень воды выше высоты, по строкам.
+     */
+    void build(int cols, const vector<FloodedCell>& cells);
+
+    /**
+     * @brief Строит дерево по высотам и рабочей матрице любого решателя.
+     * @param view Матрица высот (до 32 бит).
+     * @param levels Уровни воды построчно.
+     */
+    void build(const GridView& view, const vector<int>& levels);
+
+    /**
+     * @brief Удаляет дерево.
+     */
+    void clear();
+
+    /**
+     * @brief Возвращает узлы; дочерние узлы идут раньше родителя.
+     */
+    const vector<FillNode>& nodes() const { return nodeTable; }
+
+    /**
+     * @brief Возвращает корни дерева - озера целиком.
+     */
+    const vector<int>& lakes() const { return lakeTable; }
+
+    /**
+     * @brief Возвращает самый глубокий узел, которому принадлежит клетка.
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     * @return Номер узла или -1, если над клеткой нет воды.
+     */
+    int nodeAt(int row, int col) const;
+
+    /**
+     * @brief Возвращает объем воды в узле при заданном уровне.
+     * @param node Номер узла.
+     * @param level Уровень воды (ограничивается диапазоном bottom..top узла).
+     */
+    ll volumeAt(int node, ll level) const;
+
+    /**
+     * @brief Возвращает уровень, до которого поднимется вода в узле при заданном объеме.
+     * @param node Номер узла.
+     * @param volume Объем воды (ограничивается диапазоном 0..capacity узла).
+     */
+    double levelFor(int node, ll volume) const;
+
+    /**
+     * @brief Выливает воду в узел.
+     * Переполнивший узел объем уходит через седловину к соседним частям и поднимает воду
+     * у ближайшего предка, вмещающего весь объем (выше седловины - только когда соседние части
+     * заполнены); объем сверх емкости озера уходит через перелив.
+     * @param node Номер узла.
+     * @param volume Объем воды.
+     */
+    FillResult pour(int node, ll volume) const;
+
+private:
+    /**
+     * @brief Точка излома объема узла.
+     */
+    struct Point {
+        int height; /**< Высота, начиная с которой действуют area и heightSum. */
+        ll area; /**< Количество клеток части ниже уровня. */
+        ll heightSum; /**< Сумма высот этих клеток. */
+        ll volume; /**< Объем при уровне height. */
+    };
+
+    int colsGrid = 0; /**< Количество столбцов в матрице. */
+    vector<FillNode> nodeTable; /**< Узлы дерева. */
+    vector<int> lakeTable; /**< Корни дерева. */
+    vector<int> pointStart; /**< Начало точек излома каждого узла в points (и конец последнего). */
+    vector<Point> points; /**< Точки излома всех узлов по возрастанию высоты. */
+    vector<ll> cellIndex; /**< Затопленные клетки (строка * cols + столбец) по возрастанию. */
+    vector<int> cellNode; /**< Самый глубокий узел каждой затопленной клетки. */
+    vector<vector<int>> ancestors; /**< ancestors[k][v] - предок узла v через 2^k шагов (-1 - нет). */
+};
+
+#endif // FILLTREE_H
@@ -0,0 +1,145 @@
+#ifndef FIXEDWATERVOLUMESOLVER_H
+#define FIXEDWATERVOLUMESOLVER_H
+
+#include "cellgrid.h"
+#include "gridview.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Класс FixedWaterVolumeSolver решает задачу для сетки, размер которой известен при компиляции.
+ * Рабочая сетка с рамкой, куча и стек Priority-Flood+ лежат в std::array внутри объекта,
+ * поэтому решение не обращается к куче памяти, а смещения соседей - константы.
+ * Каждая клетка попадает в кучу или стек не более одного раза, так что их размер - Rows * Cols.
+ * Объект занимает около 20 байт на клетку. Очередь - двоичная куча, поэтому начиная с 16x16
+ * переиспользуемый BasicWaterVolumeSolver с корзинной очередью обычно быстрее.
+ * @tparam Rows Количество строк в матрице.
+ * @tparam Cols Количество столбцов в матрице.
+ */
+template <int Rows, int Cols>
+class FixedWaterVolumeSolver {
+    static_assert(Rows > 0 && Cols > 0, "Размер сетки должен быть положительным");
+
+public:
+    FixedWaterVolumeSolver() {
+        cells.fill(Cell{0, 0, true, 0});
+    }
+
+    /**
+     * @brief Решает задачу для сетки из непрерывного буфера.
+     * @param heights Высоты построчно.
+     * @param rowStride Шаг между строками в элементах.
+     * @return Объем воды, который можно собрать.
+     */
+    ll solve(const int* heights, size_t rowStride = Cols) {
+        // Клетки рамки не меняются между решениями, перезаписываем только матрицу
+        for (int i = 0; i < Rows; i++) {
+            for (int j = 0; j < Cols; j++) {
+                int h = heights[(size_t)i * rowStride + j];
+                cells[index(i, j)] = Cell{h, h, onBorder(i, j), 0};
+            }
+        }
+
+        heapSize = 0;
+        pitSize = 0;
+        for (int i = 0; i < Rows; i++) {
+            for (int j = 0; j < Cols; j++) {
+                if (onBorder(i, j))
+                    push(cells[index(i, j)].height, index(i, j));
+            }
+        }
+
+        sumWater = 0;
+        while (true) {
+            if (pitSize != 0) {
+                int u = pit[--pitSize];
+                spill(u, cells[u].level);
+            } else if (heapSize != 0) {
+                uint64_t x = pop();
+                spill((int)(uint32_t)x, (int)((uint32_t)(x >> 32) ^ signBit));
+            } else {
+                break;
+            }
+        }
+        return sumWater;
+    }
+
+    /**
+     * @brief Решает задачу для сетки из представления с высотами int.
+     * @param view Матрица с высотами столбцов размера Rows x Cols, elementWidth = 4.
+     * @return Объем воды, который можно собрать.
+     */
+    ll solve(const GridView& view) {
+        return solve(view.row<int32_t>(0), view.rowStride);
+    }
+
+    /**
+     * @brief Возвращает уровень воды в клетке после solve().
+     */
+    int level(int row, int col) const { return cells[index(row, col)].level; }
+
+    vector<vector<int>> getWorkingMatrix() const {
+        vector<vector<int>> matrixOutput(Rows, vector<int>(Cols));
+        for (int i = 0; i < Rows; i++) {
+            for (int j = 0; j < Cols; j++)
+                matrixOutput[i][j] = level(i, j);
+        }
+        return matrixOutput;
+    }
+
+private:
+    static const int stride = Cols + 2; /**< Длина строки с рамкой. */
+    static const int cellCount = Rows * Cols; /**< Количество клеток матрицы. */
+    static const uint32_t signBit = 0x80000000u; /**< Переводит знаковую высоту в беззнаковый ключ с тем же порядком. */
+
+    array<Cell, (Rows + 2) * (Cols + 2)> cells; /**< Рабочая сетка с рамкой шириной в одну клетку. */
+    array<uint64_t, cellCount> heap; /**< Двоичная куча ключей (высота << 32 | индекс клетки). */
+    array<int, cellCount> pit; /**< Стек клеток, затопленных до текущего уровня перелива. */
+    int heapSize = 0; /**< Количество элементов в куче. */
+    int pitSize = 0; /**< Количество элементов в стеке. */
+    ll sumWater = 0; /**< Суммарный объем воды. */
+
+    static int index(int row, int col) { return (row + 1) * stride + col + 1; }
+    static bool onBorder(int row, int col) { return row == 0 || row == Rows - 1 || col == 0 || col == Cols - 1; }
+
+    void push(int height, int u) {
+        heap[heapSize++] = (uint64_t)((uint32_t)height ^ signBit) << 32 | (uint32_t)u;
+        push_heap(heap.begin(), heap.begin() + heapSize, greater<uint64_t>());
+    }
+
+    uint64_t pop() {
+        pop_heap(heap.begin(), heap.begin() + heapSize, greater<uint64_t>());
+        return heap[--heapSize];
+    }
+
+    /**
+     * @brief Помечает соседей клетки и распределяет их между стеком и кучей.
+     * @param u Линейный индекс клетки с окончательным уровнем.
+     * @param L Уровень воды в клетке u.
+     */
+    void spill(int u, int L) {
+        const int offsets[4] = {1, -1, stride, -stride};
+        for (int d = 0; d < 4; d++) {
+            int v = u + offsets[d];
+            Cell& cell = cells[v];
+            if (cell.visited)
+                continue;
+            cell.visited = true;
+            if (cell.height <= L) {
+                sumWater += (ll)L - cell.height;
+                cell.level = L;
+                pit[pitSize++] = v;
+            } else {
+                push(cell.height, v);
+            }
+        }
+    }
+};
+
+#endif // FIXEDWATERVOLUMESOLVER_H
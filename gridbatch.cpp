@@ -0,0 +1,138 @@
+#include "gridbatch.h"
+#include "watervolumesolver.h"
+#include "fixedwatervolumesolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief Резервирует память под сетки.
+ * @param grids Ожидаемое количество сеток.
+ * @param cells Ожидаемое суммарное количество клеток.
+ */
+void GridBatch::reserve(size_t grids, size_t cells) {
+    entries.reserve(grids);
+    arena.reserve(cells);
+}
+
+/**
+ * @brief Добавляет сетку в конец буфера.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param heights Высоты построчно, rows * cols элементов.
+ */
+void GridBatch::add(int rows, int cols, const int* heights) {
+    entries.push_back(Entry{rows, cols, arena.size()});
+    arena.insert(arena.end(), heights, heights + (size_t)rows * cols);
+}
+
+void GridBatch::clear() {
+    arena.clear();
+    entries.clear();
+}
+
+/**
+ * @brief Возвращает представление сетки с номером k (действительно до следующего add()).
+ */
+GridView GridBatch::view(size_t k) const {
+    GridView view;
+    view.rows = entries[k].rows;
+    view.cols = entries[k].cols;
+    view.elementWidth = 4;
+    view.rowStride = entries[k].cols;
+    view.data = arena.data() + entries[k].offset;
+    return view;
+}
+
+namespace {
+
+/**
+ * @brief Решатели фиксированного размера для квадратных сеток от 3x3 до NxN.
+ * Каждый занимает не больше пары килобайт, поэтому все они лежат прямо в объекте рабочего потока.
+ */
+template <int N>
+struct FixedSolvers : FixedSolvers<N - 1> {
+    FixedWaterVolumeSolver<N, N> solver;
+
+    bool solve(const GridView& view, ll& volume) {
+        if (view.rows != N)
+            return FixedSolvers<N - 1>::solve(view, volume);
+        volume = solver.solve(view);
+        return true;
+    }
+};
+
+template <>
+struct FixedSolvers<2> {
+    bool solve(const GridView&, ll&) { return false; }
+};
+
+/**
+ * @brief Решатели одного рабочего потока.
+ */
+struct BatchWorker {
+    WaterVolumeSolver solver;
+    FixedSolvers<8> fixed;
+
+    BatchWorker() {
+        solver.setEngine(SolverEngine::PriorityFloodPlus);
+    }
+
+    ll solve(const GridView& view) {
+        ll volume;
+        if (view.rows == view.cols && fixed.solve(view, volume))
+            return volume;
+        solver.reset(view);
+        return solver.solve();
+    }
+};
+
+}
+
+/**
+ * @brief Решает все сетки пакета.
+ * Потоки забирают сетки порциями по 256, чтобы счетчик порций не стал узким местом на мелких сетках.
+ * @param batch Пакет сеток.
+ * @param threads Количество рабочих потоков (0 - по числу ядер).
+ * @param cache Кэш решений (nullptr - без кэша).
+ * @return Объем воды для каждой сетки в порядке добавления.
+ */
+vector<ll> solveBatch(const GridBatch& batch, int threads, SolveCache* cache) {
+    const size_t chunk = 256;
+    vector<ll> volumes(batch.size());
+    size_t chunks = (batch.size() + chunk - 1) / chunk;
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    int workers = (int)min((size_t)threads, chunks);
+
+    atomic<size_t> next(0);
+    auto work = [&]() {
+        BatchWorker worker;
+        for (size_t c = next++; c < chunks; c = next++) {
+            size_t end = min(batch.size(), (c + 1) * chunk);
+            for (size_t k = c * chunk; k < end; k++) {
+                GridView view = batch.view(k);
+                if (!cache || (size_t)view.rows * view.cols < batchCacheCells) {
+                    volumes[k] = worker.solve(view);
+                    continue;
+                }
+                GridKey key = gridKey(view);
+                if (!cache->lookup(key, view, volumes[k])) {
+                    volumes[k] = worker.solve(view);
+                    cache->store(key, view, volumes[k]);
+                }
+            }
+        }
+    };
+    if (workers <= 1) {
+        work();
+        return volumes;
+    }
+    vector<thread> pool;
+    for (int w = 0; w < workers; w++)
+        pool.emplace_back(work);
+    for (thread& worker : pool)
+        worker.join();
+    return volumes;
+}
@@ -0,0 +1,71 @@
+#ifndef GRIDBATCH_H
+#define GRIDBATCH_H
+
+#include "gridview.h"
+#include "solvecache.h"
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Класс GridBatch хранит много сеток в одном непрерывном буфере.
+ * Высоты всех сеток лежат подряд построчно, для каждой сетки запоминаются размер и смещение,
+ * поэтому добавление сетки - это одно копирование без отдельного выделения памяти.
+ */
+class GridBatch {
+public:
+    /**
+     * @brief Резервирует память под сетки.
+     * @param grids Ожидаемое количество сеток.
+     * @param cells Ожидаемое суммарное количество клеток.
+     */
+    void reserve(size_t grids, size_t cells);
+
+    /**
+     * @brief Добавляет сетку в конец буфера.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param heights Высоты построчно, rows * cols элементов.
+     */
+    void add(int rows, int cols, const int* heights);
+
+    void clear();
+    size_t size() const { return entries.size(); }
+
+    /**
+     * @brief Возвращает представление сетки с номером k (действительно до следующего add()).
+     */
+    GridView view(size_t k) const;
+
+private:
+    /**
+     * @brief Размер сетки и ее положение в буфере.
+     */
+    struct Entry {
+        int rows; /**< Количество строк в матрице. */
+        int cols; /**< Количество столбцов в матрице. */
+        size_t offset; /**< Смещение первой клетки в буфере. */
+    };
+
+    vector<int> arena; /**< Высоты всех сеток подряд. */
+    vector<Entry> entries; /**< Сетки в порядке добавления. */
+};
+
+const size_t batchCacheCells = 64 * 64; /**< Наименьшая сетка пакета, решение которой ищется в кэше. */
+
+/**
+ * @brief Решает все сетки пакета.
+ * Каждый поток заводит один решатель и переиспользует его память для всех своих сеток;
+ * квадратные сетки от 3x3 до 8x8 решаются решателем фиксированного размера, который на них
+ * быстрее: на больших сетках корзинная очередь BasicWaterVolumeSolver выигрывает у его двоичной кучи.
+ * С кэшем повторяющиеся сетки от batchCacheCells клеток не решаются заново; меньшие решаются
+ * почти так же быстро, как хэшируются, и в кэш не попадают.
+ * @param batch Пакет сеток.
+ * @param threads Количество рабочих потоков (0 - по числу ядер).
+ * @param cache Кэш решений (nullptr - без кэша).
+ * @return Объем воды для каждой сетки в порядке добавления.
+ */
+vector<ll> solveBatch(const GridBatch& batch, int threads = 1, SolveCache* cache = nullptr);
+
+#endif // GRIDBATCH_H
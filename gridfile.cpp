@@ -0,0 +1,196 @@
+#include "gridfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char gridFileMagic[8] = {'W', 'C', 'G', 'R', 'I', 'D', 0, 0};
+
+/**
+ * @brief Проверяет, начинаются ли данные с сигнатуры файла сетки.
+ * @param data Начало файла.
+ * @param size Количество доступных байт.
+ */
+bool isGridFile(const void* data, size_t size) {
+    return size >= sizeof(gridFileMagic) && memcmp(data, gridFileMagic, sizeof(gridFileMagic)) == 0;
+}
+
+/**
+ * @brief Возвращает наименьшую ширину высоты (1, 2, 4 или 8 байт), в которую помещаются значения.
+ * @param view Матрица высот.
+ */
+int minimalElementWidth(const GridView& view) {
+    int width = 1;
+    for (int i = 0; i < view.rows; i++) {
+        for (int j = 0; j < view.cols; j++) {
+            int64_t h = view.at64(i, j);
+            if (h < INT32_MIN || h > INT32_MAX)
+                return 8;
+            if (h < INT16_MIN || h > INT16_MAX)
+                width = 4;
+            else if (width < 2 && (h < INT8_MIN || h > INT8_MAX))
+                width = 2;
+        }
+    }
+    return width;
+}
+
+/**
+ * @brief Записывает матрицу в двоичный файл сетки.
+ * @param fileName Имя файла.
+ * @param view Матрица высот.
+ * @param elementWidth Ширина высоты в файле (0 - наименьшая подходящая).
+ * @return true, если файл записан, иначе false.
+ */
+bool writeGridFile(const string& fileName, const GridView& view, int elementWidth) {
+    // MappedGrid::open() не открывает файлы без клеток, поэтому такие файлы не пишутся
+    if (view.rows <= 0 || view.cols <= 0)
+        return false;
+    if (elementWidth == 0)
+        elementWidth = minimalElementWidth(view);
+
+    GridFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, gridFileMagic, sizeof(gridFileMagic));
+    header.version = gridFileVersion;
+    header.elementWidth = elementWidth;
+    header.rows = view.rows;
+    header.cols = view.cols;
+    header.dataOffset = gridFileAlignment;
+    header.alignment = gridFileAlignment;
+
+    ofstream file(fileName, ios::binary | ios::trunc);
+    if (!file)
+        return false;
+    vector<char> block(gridFileAlignment, 0);
+    memcpy(block.data(), &header, sizeof(header));
+    file.write(block.data(), block.size());
+
+    // Строки переводятся в ширину файла по одной, чтобы не держать копию всей матрицы
+    vector<char> row((size_t)view.cols * elementWidth);
+    for (int i = 0; i < view.rows; i++) {
+        for (int j = 0; j < view.cols; j++) {
+            int64_t h = view.at64(i, j);
+            if (elementWidth == 1) {
+                int8_t v = (int8_t)h;
+                memcpy(&row[j], &v, 1);
+            } else if (elementWidth == 2) {
+                int16_t v = (int16_t)h;
+                memcpy(&row[(size_t)j * 2], &v, 2);
+            } else if (elementWidth == 4) {
+                int32_t v = (int32_t)h;
+                memcpy(&row[(size_t)j * 4], &v, 4);
+            } else {
+                memcpy(&row[(size_t)j * 8], &h, 8);
+            }
+        }
+        file.write(row.data(), row.size());
+    }
+    return (bool)file;
+}
+
+MappedGrid::~MappedGrid() {
+    close();
+}
+
+/**
+ * @brief Открывает и проверяет файл сетки.
+ * @param fileName Имя файла.
+ * @return true, если файл открыт и заголовок корректен, иначе false.
+ */
+bool MappedGrid::open(const string& fileName) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(GridFileHeader)) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* address = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!address) {
+        if (section)
+            CloseHandle(section);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = section;
+    mapping = address;
+    mappingSize = (size_t)size.QuadPart;
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(GridFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* address = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+        return false;
+    mapping = address;
+    mappingSize = (size_t)st.st_size;
+#endif
+
+    const GridFileHeader& h = header();
+    bool valid = isGridFile(mapping, mappingSize) && h.version == gridFileVersion
+            && (h.elementWidth == 1 || h.elementWidth == 2 || h.elementWidth == 4 || h.elementWidth == 8)
+            && h.rows > 0 && h.cols > 0 && h.rows <= INT32_MAX && h.cols <= INT32_MAX
+            && h.dataOffset >= sizeof(GridFileHeader) && h.dataOffset % h.elementWidth == 0
+            && h.dataOffset <= mappingSize && (mappingSize - h.dataOffset) / h.elementWidth / h.cols >= h.rows;
+    if (!valid) {
+        close();
+        return false;
+    }
+#ifndef _WIN32
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+/**
+ * @brief Закрывает отображение.
+ */
+void MappedGrid::close() {
+    if (!mapping)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+}
+
+/**
+ * @brief Возвращает представление матрицы поверх отображения.
+ */
+GridView MappedGrid::view() const {
+    GridView view;
+    const GridFileHeader& h = header();
+    view.rows = (int)h.rows;
+    view.cols = (int)h.cols;
+    view.elementWidth = (int)h.elementWidth;
+    view.rowStride = (size_t)h.cols;
+    view.data = static_cast<const char*>(mapping) + h.dataOffset;
+    return view;
+}
@@ -0,0 +1,95 @@
+#ifndef GRIDFILE_H
+#define GRIDFILE_H
+
+#include "gridview.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Заголовок двоичного файла сетки (64 байта, little-endian).
+ * За заголовком с отступом dataOffset (кратным alignment) построчно лежат rows * cols
+ * знаковых высот шириной elementWidth байт, без разделителей.
+ */
+struct GridFileHeader {
+    char magic[8]; /**< Сигнатура "WCGRID\0\0". */
+    uint32_t version; /**< Версия формата. */
+    uint32_t elementWidth; /**< Ширина высоты в байтах (1, 2, 4 или 8). */
+    uint64_t rows; /**< Количество строк в матрице. */
+    uint64_t cols; /**< Количество столбцов в матрице. */
+    uint64_t dataOffset; /**< Смещение первой высоты от начала файла. */
+    uint32_t alignment; /**< Выравнивание начала данных. */
+    uint32_t flags; /**< Зарезервировано, 0. */
+    uint8_t reserved[16]; /**< Зарезервировано, нули. */
+};
+
+static_assert(sizeof(GridFileHeader) == 64, "GridFileHeader must be 64 bytes");
+
+const uint32_t gridFileVersion = 1; /**< Текущая версия формата. */
+const uint32_t gridFileAlignment = 4096; /**< Выравнивание данных по странице памяти. */
+
+/**
+ * @brief Проверяет, начинаются ли данные с сигнатуры файла сетки.
+ * @param data Начало файла.
+ * @param size Количество доступных байт.
+ */
+bool isGridFile(const void* data, size_t size);
+
+/**
+ * @brief Возвращает наименьшую ширину высоты (1, 2, 4 или 8 байт), в которую помещаются значения.
+ * @param view Матрица высот.
+ */
+int minimalElementWidth(const GridView& view);
+
+/**
+ * @brief Записывает матрицу в двоичный файл сетки.
+ * @param fileName Имя файла.
+ * @param view Матрица высот.
+ * @param elementWidth Ширина высоты в файле (0 - наименьшая подходящая).
+ * @return true, если файл записан, иначе false (в том числе для матрицы без клеток).
+ */
+bool writeGridFile(const string& fileName, const GridView& view, int elementWidth = 0);
+
+/**
+ * @brief Класс MappedGrid отображает файл сетки в память только для чтения.
+ * Высоты читаются прямо из отображения без разбора и копирования: загрузка стоит
+ * по одному отказу страницы на каждую затронутую страницу.
+ */
+class MappedGrid {
+public:
+    MappedGrid() = default;
+    ~MappedGrid();
+    MappedGrid(const MappedGrid&) = delete;
+    MappedGrid& operator=(const MappedGrid&) = delete;
+
+    /**
+     * @brief Открывает и проверяет файл сетки.
+     * @param fileName Имя файла.
+     * @return true, если файл открыт и заголовок корректен, иначе false.
+     */
+    bool open(const string& fileName);
+
+    /**
+     * @brief Закрывает отображение.
+     */
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    const GridFileHeader& header() const { return *static_cast<const GridFileHeader*>(mapping); }
+
+    /**
+     * @brief Возвращает представление матрицы поверх отображения.
+     */
+    GridView view() const;
+
+private:
+    void* mapping = nullptr; /**< Начало отображения. */
+    size_t mappingSize = 0; /**< Размер отображения в байтах. */
+#ifdef _WIN32
+    void* fileHandle = nullptr; /**< Дескриптор файла. */
+    void* mappingHandle = nullptr; /**< Дескриптор отображения. */
+#endif
+};
+
+#endif // GRIDFILE_H
@@ -0,0 +1,139 @@
+#include "gridio.h"
+#include "gridfile.h"
+#include "packedgrid.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+/**
+ * @brief Читает матрицу в текстовом формате: количество строк и столбцов, затем высоты построчно.
+ * @param in Входной поток.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @return true, если матрица прочитана, иначе false.
+ */
+bool readTextGrid(istream& in, int& rows, int& cols, vector<vector<int>>& matrix) {
+    if (!(in >> rows >> cols) || rows <= 0 || cols <= 0)
+        return false;
+    matrix.assign(rows, vector<int>(cols));
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (!(in >> matrix[i][j]))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Читает одно число int32 в порядке big-endian, как его пишет QDataStream.
+ */
+static bool readBigEndianInt(istream& in, int& value) {
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), 4))
+        return false;
+    value = (int)(((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3]);
+    return true;
+}
+
+/**
+ * @brief Читает матрицу в формате .bin, который сохраняет приложение (QDataStream, int32 big-endian).
+ * @param in Входной поток, открытый в двоичном режиме.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @return true, если матрица прочитана, иначе false.
+ */
+bool readLegacyBinGrid(istream& in, int& rows, int& cols, vector<vector<int>>& matrix) {
+    if (!readBigEndianInt(in, rows) || !readBigEndianInt(in, cols) || rows <= 0 || cols <= 0)
+        return false;
+    matrix.assign(rows, vector<int>(cols));
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (!readBigEndianInt(in, matrix[i][j]))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Читает матрицу из файла: файл сетки и сжатый файл сетки узнаются по сигнатуре, остальные по расширению (.bin или текст).
+ * @param fileName Имя файла ("-" - стандартный ввод, всегда текст).
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @return true, если матрица прочитана, иначе false.
+ */
+bool readGridFile(const string& fileName, int& rows, int& cols, vector<vector<int>>& matrix) {
+    if (fileName == "-")
+        return readTextGrid(cin, rows, cols, matrix);
+
+    MappedGrid mapped;
+    if (mapped.open(fileName)) {
+        GridView view = mapped.view();
+        if (!view.fitsInt())
+            return false;
+        rows = view.rows;
+        cols = view.cols;
+        matrix.assign(rows, vector<int>(cols));
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++)
+                matrix[i][j] = view.at(i, j);
+        }
+        return true;
+    }
+
+    // Сжатый файл распаковывается по блокам: в памяти кроме матрицы только один блок
+    PackedGrid packed;
+    if (packed.open(fileName)) {
+        if (!packed.fitsInt())
+            return false;
+        rows = packed.rows();
+        cols = packed.cols();
+        int chunkRows = packed.chunkRows();
+        vector<int> chunk((size_t)chunkRows * cols);
+        matrix.resize(rows);
+        for (int c = 0; c < packed.chunkCount(); c++) {
+            if (!packed.decodeChunk(c, chunk.data()))
+                return false;
+            for (int i = c * chunkRows; i < min(rows, (c + 1) * chunkRows); i++)
+                matrix[i].assign(chunk.begin() + (size_t)(i - c * chunkRows) * cols, chunk.begin() + (size_t)(i - c * chunkRows + 1) * cols);
+        }
+        return true;
+    }
+
+    bool binary = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".bin") == 0;
+    ifstream file(fileName, binary ? ios::binary : ios::in);
+    if (!file)
+        return false;
+    return binary ? readLegacyBinGrid(file, rows, cols, matrix) : readTextGrid(file, rows, cols, matrix);
+}
+
+/**
+ * @brief Записывает матрицу построчно, значения через пробел.
+ * @param out Выходной поток.
+ * @param matrix Матрица.
+ */
+template <class T>
+static void writeRows(ostream& out, const vector<vector<T>>& matrix) {
+    for (const vector<T>& row : matrix) {
+        for (size_t j = 0; j < row.size(); j++) {
+            if (j)
+                out << ' ';
+            out << row[j];
+        }
+        out << '\n';
+    }
+}
+
+void writeTextMatrix(ostream& out, const vector<vector<int>>& matrix) {
+    writeRows(out, matrix);
+}
+
+void writeTextMatrix(ostream& out, const vector<vector<long long>>& matrix) {
+    writeRows(out, matrix);
+}
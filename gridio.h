@@ -0,0 +1,48 @@
+#ifndef GRIDIO_H
+#define GRIDIO_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Читает матрицу в текстовом формате: количество строк и столбцов, затем высоты построчно.
+ * @param in Входной поток.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @return true, если матрица прочитана, иначе false.
+ */
+bool readTextGrid(istream& in, int& rows, int& cols, vector<vector<int>>& matrix);
+
+/**
+ * @brief Читает матрицу в формате .bin, который сохраняет приложение (QDataStream, int32 big-endian).
+ * @param in Входной поток, открытый в двоичном режиме.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @return true, если матрица прочитана, иначе false.
+ */
+bool readLegacyBinGrid(istream& in, int& rows, int& cols, vector<vector<int>>& matrix);
+
+/**
+ * @brief Читает матрицу из файла: файл сетки и сжатый файл сетки узнаются по сигнатуре, остальные по расширению (.bin или текст).
+ * @param fileName Имя файла ("-" - стандартный ввод, всегда текст).
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @return true, если матрица прочитана, иначе false.
+ */
+bool readGridFile(const string& fileName, int& rows, int& cols, vector<vector<int>>& matrix);
+
+/**
+ * @brief Записывает матрицу построчно, значения через пробел.
+ * @param out Выходной поток.
+ * @param matrix Матрица.
+ */
+void writeTextMatrix(ostream& out, const vector<vector<int>>& matrix);
+void writeTextMatrix(ostream& out, const vector<vector<long long>>& matrix);
+
+#endif // GRIDIO_H
@@ -0,0 +1,244 @@
+#include "griditem.h"
+
+#include <QGraphicsSceneMouseEvent>
+#include <QPainter>
+#include <QPixmapCache>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+/**
+ * @brief Возвращает новое поколение для ключей кэша, общее для всех элементов.
+ */
+static qint64 nextCacheId() {
+    static atomic<qint64> counter(0);
+    return ++counter;
+}
+
+/**
+ * @brief Конструктор класса GridItem.
+ * @param model Модель, которую рисует элемент.
+ * @param parent Родительский элемент.
+ */
+GridItem::GridItem(GridModel *model, QGraphicsItem *parent) : QGraphicsObject(parent), model(model) {
+    // exposedRect нужен, чтобы рисовать только видимые клетки
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+    connect(model, &GridModel::gridReset, this, &GridItem::handleGridReset);
+    connect(model, &GridModel::dataChanged, this, &GridItem::handleDataChanged);
+    handleGridReset();
+}
+
+/**
+ * @brief Обработчик смены всей матрицы модели.
+ */
+void GridItem::handleGridReset() {
+    prepareGeometryChange();
+    rowsGrid = model->rows();
+    colsGrid = model->cols();
+    tileCols = (colsGrid + tileCells - 1) / tileCells;
+    tileVersion.assign((size_t)((rowsGrid + tileCells - 1) / tileCells) * tileCols, 0);
+    cacheId = nextCacheId();
+    updateRanges();
+    update();
+}
+
+/**
+ * @brief Обработчик изменения клеток модели: сбрасывает затронутые блоки кэша и пиксели обзора.
+ * Большие области сбрасывают кэш целиком; если клетка вышла за диапазон цветов,
+ * обзорное изображение строится заново.
+ * @param region Прямоугольник клеток (x - столбец, y - строка).
+ */
+void GridItem::handleDataChanged(const QRect& region) {
+    QRect cells = region & QRect(0, 0, colsGrid, rowsGrid);
+    if (cells.isEmpty())
+        return;
+
+    if ((qint64)cells.width() * cells.height() * 4 >= (qint64)rowsGrid * colsGrid) {
+        cacheId = nextCacheId();
+        updateRanges();
+    } else {
+        const int* levels = model->levels();
+        const vector<int>& heights = model->heights();
+        for (int i = cells.top(); i <= cells.bottom(); i++) {
+            for (int j = cells.left(); j <= cells.right(); j++) {
+                size_t u = (size_t)i * colsGrid + j;
+                int depth = levels[u] - heights[u];
+                if (heights[u] < minHeight || heights[u] > maxHeight || depth > maxDepth) {
+                    minHeight = min(minHeight, heights[u]);
+                    maxHeight = max(maxHeight, heights[u]);
+                    maxDepth = max(maxDepth, depth);
+                    overviewDirty = true;
+                }
+            }
+        }
+        if (!overviewDirty) {
+            for (int i = cells.top(); i <= cells.bottom(); i++) {
+                for (int j = cells.left(); j <= cells.right(); j++)
+                    overview.setPixel(j, i, overviewColor((size_t)i * colsGrid + j));
+            }
+        }
+        for (int tr = cells.top() / tileCells; tr <= cells.bottom() / tileCells; tr++) {
+            for (int tc = cells.left() / tileCells; tc <= cells.right() / tileCells; tc++)
+                tileVersion[(size_t)tr * tileCols + tc]++;
+        }
+    }
+    update(QRectF(cells.left() * cellSize, cells.top() * cellSize, (qreal)cells.width() * cellSize, (qreal)cells.height() * cellSize));
+}
+
+/**
+ * @brief Пересчитывает диапазоны высот и глубин для цветов обзорного изображения.
+ */
+void GridItem::updateRanges() {
+    const int* levels = model->levels();
+    const vector<int>& heights = model->heights();
+    minHeight = maxHeight = heights.empty() ? 0 : heights[0];
+    maxDepth = 0;
+    for (size_t u = 0; u < heights.size(); u++) {
+        minHeight = min(minHeight, heights[u]);
+        maxHeight = max(maxHeight, heights[u]);
+        maxDepth = max(maxDepth, levels[u] - heights[u]);
+    }
+    overviewDirty = true;
+}
+
+/**
+ * @brief Возвращает цвет клетки: синий, если в ней есть вода, иначе зеленый.
+ */
+QColor GridItem::cellColor(size_t u) const {
+    return model->levels()[u] != model->heights()[u] ? QColor(Qt::blue) : QColor(Qt::green);
+}
+
+/**
+ * @brief Возвращает цвет клетки обзорного изображения.
+ * Сухие клетки - зеленые, тем светлее, чем выше; клетки с водой - синие, тем темнее, чем глубже.
+ */
+QRgb GridItem::overviewColor(size_t u) const {
+    int height = model->heights()[u];
+    int depth = model->levels()[u] - height;
+    if (depth > 0)
+        return QColor::fromHsv(230, 255, 255 - (int)(155LL * depth / max(maxDepth, 1))).rgb();
+    long long range = max(1LL, (long long)maxHeight - minHeight);
+    return QColor::fromHsv(120, 255, 80 + (int)(175 * ((long long)height - minHeight) / range)).rgb();
+}
+
+QRectF GridItem::boundingRect() const {
+    return QRectF(0, 0, (qreal)colsGrid * cellSize, (qreal)rowsGrid * cellSize);
+}
+
+/**
+ * @brief Рисует видимую часть матрицы в режиме, подходящем для текущего масштаба.
+ */
+void GridItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    Q_UNUSED(widget);
+    if (rowsGrid == 0 || colsGrid == 0)
+        return;
+
+    QRectF exposed = option->exposedRect & boundingRect();
+    int r0 = max(0, (int)floor(exposed.top() / cellSize));
+    int c0 = max(0, (int)floor(exposed.left() / cellSize));
+    int r1 = min(rowsGrid, (int)ceil(exposed.bottom() / cellSize));
+    int c1 = min(colsGrid, (int)ceil(exposed.right() / cellSize));
+    if (r0 >= r1 || c0 >= c1)
+        return;
+
+    qreal screenCell = cellSize * QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
+    if (screenCell < overviewLimit) {
+        if (overviewDirty) {
+            overview = QImage(colsGrid, rowsGrid, QImage::Format_RGB32);
+            for (int i = 0; i < rowsGrid; i++) {
+                QRgb *line = reinterpret_cast<QRgb*>(overview.scanLine(i));
+                for (int j = 0; j < colsGrid; j++)
+                    line[j] = overviewColor((size_t)i * colsGrid + j);
+            }
+            overviewDirty = false;
+        }
+        painter->drawImage(QRectF(c0 * cellSize, r0 * cellSize, (qreal)(c1 - c0) * cellSize, (qreal)(r1 - r0) * cellSize),
+                           overview, QRectF(c0, r0, c1 - c0, r1 - r0));
+        return;
+    }
+
+    if (screenCell < numbersLimit) {
+        // Блоки кэшируются для степени двойки не меньше размера клетки на экране
+        int cellPixels = 4;
+        while (cellPixels < screenCell)
+            cellPixels *= 2;
+        for (int tr = r0 / tileCells; tr * tileCells < r1; tr++) {
+            for (int tc = c0 / tileCells; tc * tileCells < c1; tc++) {
+                int th = min(tileCells, rowsGrid - tr * tileCells);
+                int tw = min(tileCells, colsGrid - tc * tileCells);
+                QPixmap pixmap = tilePixmap(tr, tc, cellPixels);
+                painter->drawPixmap(QRectF(tc * tileCells * cellSize, tr * tileCells * cellSize, tw * cellSize, th * cellSize),
+                                    pixmap, QRectF(pixmap.rect()));
+            }
+        }
+        return;
+    }
+
+    drawCells(painter, r0, c0, r1, c1, QPointF(0, 0), cellSize, true);
+}
+
+/**
+ * @brief Рисует прямоугольник клеток.
+ */
+void GridItem::drawCells(QPainter *painter, int r0, int c0, int r1, int c1, const QPointF& origin, qreal size, bool numbers) const {
+    const int* levels = model->levels();
+    painter->setPen(size >= 8 ? QPen(Qt::black, 0) : QPen(Qt::NoPen));
+    if (numbers) {
+        QFont font = painter->font();
+        font.setPixelSize(16);
+        painter->setFont(font);
+    }
+    for (int i = r0; i < r1; i++) {
+        for (int j = c0; j < c1; j++) {
+            size_t u = (size_t)i * colsGrid + j;
+            QRectF rect(origin.x() + j * size, origin.y() + i * size, size, size);
+            painter->setBrush(cellColor(u));
+            painter->drawRect(rect);
+            if (numbers)
+                painter->drawText(rect, Qt::AlignCenter, QString::number(levels[u]));
+        }
+    }
+}
+
+/**
+ * @brief Возвращает отрисованный блок из кэша или рисует его.
+ * Ключ включает поколения матрицы и блока, поэтому устаревшие блоки просто вытесняются из кэша.
+ * @param tileRow Строка блока.
+ * @param tileCol Столбец блока.
+ * @param cellPixels Сторона клетки в пикселях.
+ */
+QPixmap GridItem::tilePixmap(int tileRow, int tileCol, int cellPixels) const {
+    size_t t = (size_t)tileRow * tileCols + tileCol;
+    QString key = QString("griditem-%1-%2-%3-%4").arg(cacheId).arg(t).arg(tileVersion[t]).arg(cellPixels);
+
+    QPixmap pixmap;
+    if (QPixmapCache::find(key, &pixmap))
+        return pixmap;
+
+    int r0 = tileRow * tileCells;
+    int c0 = tileCol * tileCells;
+    int r1 = min(rowsGrid, r0 + tileCells);
+    int c1 = min(colsGrid, c0 + tileCells);
+    pixmap = QPixmap((c1 - c0) * cellPixels, (r1 - r0) * cellPixels);
+    QPainter painter(&pixmap);
+    drawCells(&painter, r0, c0, r1, c1, QPointF(-c0 * cellPixels, -r0 * cellPixels), cellPixels, false);
+    painter.end();
+    QPixmapCache::insert(key, pixmap);
+    return pixmap;
+}
+
+/**
+ * @brief Сообщает о двойном щелчке по клетке.
+ */
+void GridItem::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) {
+    int row = (int)floor(event->pos().y() / cellSize);
+    int col = (int)floor(event->pos().x() / cellSize);
+    if (row >= 0 && row < rowsGrid && col >= 0 && col < colsGrid) {
+        emit cellDoubleClicked(row, col);
+        event->accept();
+        return;
+    }
+    QGraphicsObject::mouseDoubleClickEvent(event);
+}
@@ -0,0 +1,107 @@
+#ifndef GRIDITEM_H
+#define GRIDITEM_H
+
+#include "gridmodel.h"
+#include <QColor>
+#include <QGraphicsObject>
+#include <QImage>
+#include <QPixmap>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Класс GridItem рисует всю матрицу модели GridModel одним элементом сцены.
+ * Клетки рисуются прямо из буферов модели, поэтому стоимость перерисовки зависит
+ * от размера видимой области, а не от размера сетки. Режим выбирается по размеру клетки на экране:
+ * - меньше overviewLimit пикселей - обзорное изображение, пиксель на клетку (высота или глубина воды цветом);
+ * - до numbersLimit пикселей - блоки tileCells x tileCells клеток, отрисованные в QPixmapCache;
+ * - крупнее - видимые клетки рисуются напрямую вместе с числами.
+ */
+class GridItem : public QGraphicsObject {
+    Q_OBJECT
+
+public:
+    static constexpr int cellSize = 50; /**< Сторона клетки в координатах сцены. */
+
+    /**
+     * @brief Конструктор класса GridItem.
+     * @param model Модель, которую рисует элемент (должна жить дольше элемента).
+     * @param parent Родительский элемент (по умолчанию nullptr).
+     */
+    explicit GridItem(GridModel *model, QGraphicsItem *parent = nullptr);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+signals:
+    /**
+     * @brief Сигнал двойного щелчка по клетке.
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     */
+    void cellDoubleClicked(int row, int col);
+
+protected:
+    void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
+
+private slots:
+    /**
+     * @brief Обработчик смены всей матрицы модели.
+     */
+    void handleGridReset();
+
+    /**
+     * @brief Обработчик изменения клеток модели: сбрасывает затронутые блоки кэша и пиксели обзора.
+     * @param region Прямоугольник клеток (x - столбец, y - строка).
+     */
+    void handleDataChanged(const QRect& region);
+
+private:
+    static constexpr int tileCells = 16; /**< Сторона кэшируемого блока в клетках. */
+    static constexpr int overviewLimit = 3; /**< Размер клетки на экране, ниже которого рисуется обзорное изображение. */
+    static constexpr int numbersLimit = 32; /**< Размер клетки на экране, с которого рисуются числа. */
+
+    GridModel *model; /**< Модель с высотами и уровнями воды. */
+    int rowsGrid = 0; /**< Количество строк, для которого заведены кэши. */
+    int colsGrid = 0; /**< Количество столбцов, для которого заведены кэши. */
+    int tileCols = 0; /**< Количество блоков в строке. */
+    int minHeight = 0; /**< Наименьшая высота (для цвета обзорного изображения). */
+    int maxHeight = 0; /**< Наибольшая высота. */
+    int maxDepth = 0; /**< Наибольшая глубина воды. */
+    QImage overview; /**< Обзорное изображение, пиксель на клетку. */
+    bool overviewDirty = true; /**< Обзорное изображение нужно построить заново. */
+    qint64 cacheId = 0; /**< Поколение всей матрицы в ключах QPixmapCache. */
+    vector<quint32> tileVersion; /**< Поколение каждого блока в ключах QPixmapCache. */
+
+    /**
+     * @brief Пересчитывает диапазоны высот и глубин для цветов обзорного изображения.
+     */
+    void updateRanges();
+
+    QColor cellColor(size_t u) const;
+    QRgb overviewColor(size_t u) const;
+
+    /**
+     * @brief Рисует прямоугольник клеток.
+     * @param painter Объект рисования.
+     * @param r0 Первая строка.
+     * @param c0 Первый столбец.
+     * @param r1 Строка после последней.
+     * @param c1 Столбец после последнего.
+     * @param origin Положение клетки (0, 0).
+     * @param size Сторона клетки.
+     * @param numbers Рисовать ли числа.
+     */
+    void drawCells(QPainter *painter, int r0, int c0, int r1, int c1, const QPointF& origin, qreal size, bool numbers) const;
+
+    /**
+     * @brief Возвращает отрисованный блок из кэша или рисует его.
+     * @param tileRow Строка блока.
+     * @param tileCol Столбец блока.
+     * @param cellPixels Сторона клетки в пикселях.
+     */
+    QPixmap tilePixmap(int tileRow, int tileCol, int cellPixels) const;
+};
+
+#endif // GRIDITEM_H
@@ -0,0 +1,151 @@
+#include "gridmodel.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+
+/**
+ * @brief Конструктор класса GridModel.
+ * @param parent Родительский объект.
+ */
+GridModel::GridModel(QObject *parent) : QObject(parent) {
+    applyTimer.setInterval(frameInterval);
+    connect(&applyTimer, &QTimer::timeout, this, &GridModel::applyQueuedLevels);
+}
+
+/**
+ * @brief Задает новую матрицу высот, вода сбрасывается.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param heights Высоты построчно, rows * cols элементов.
+ */
+void GridModel::reset(int rows, int cols, vector<int> heights) {
+    rowsGrid = rows;
+    colsGrid = cols;
+    heightData = move(heights);
+    levelGrid.reset();
+    levelData.clear();
+    clearQueuedLevels();
+    emit gridReset();
+}
+
+/**
+ * @brief Задает уровни воды всей матрицы (решение).
+ * @param levels Рабочая матрица того же размера.
+ */
+void GridModel::setLevels(SharedGrid levels) {
+    levelGrid = move(levels);
+    levelData.clear();
+    clearQueuedLevels();
+    emit dataChanged(QRect(0, 0, colsGrid, rowsGrid));
+}
+
+/**
+ * @brief Меняет уровни воды в перечисленных клетках одним уведомлением.
+ * Областью изменения становится охватывающий прямоугольник клеток.
+ * @param changes Клетки и их новые уровни.
+ */
+void GridModel::setLevels(const vector<CellChange>& changes) {
+    if (changes.empty())
+        return;
+    int* data = mutableLevels();
+    QRect region;
+    for (const CellChange& change : changes) {
+        data[(size_t)change.row * colsGrid + change.col] = change.level;
+        region |= QRect(change.col, change.row, 1, 1);
+    }
+    emit dataChanged(region);
+}
+
+/**
+ * @brief Ставит в очередь блоки с окончательными уровнями воды.
+ * @param regions Блоки уровней.
+ */
+void GridModel::queueLevels(const vector<GridRegion>& regions) {
+    queuedLevels.insert(queuedLevels.end(), regions.begin(), regions.end());
+    if (!queuedLevels.empty() && !applyTimer.isActive()) {
+        applyTimer.start();
+        applyQueuedLevels();
+    }
+}
+
+/**
+ * @brief Принимает решение целиком без общей перерисовки.
+ * Уровни ожидающих блоков уже есть в решении, поэтому у них остаются только прямоугольники.
+ * @param levels Рабочая матрица того же размера.
+ */
+void GridModel::adoptLevels(SharedGrid levels) {
+    levelGrid = move(levels);
+    levelData.clear();
+    for (GridRegion& region : queuedLevels)
+        vector<int>().swap(region.values);
+}
+
+/**
+ * @brief Применяет блоки из очереди, пока не истечет время кадра.
+ * Большой блок применяется полосами по bandCells клеток, об изменении каждой полосы сообщается отдельно.
+ */
+void GridModel::applyQueuedLevels() {
+    QElapsedTimer frame;
+    frame.start();
+    while (!queuedLevels.empty() && frame.elapsed() < frameBudget) {
+        const GridRegion& region = queuedLevels.front();
+        int band = max(1, bandCells / max(region.cols, 1));
+        int end = min(region.rows, queuedRow + band);
+        if (!region.values.empty()) {
+            int* data = mutableLevels();
+            for (int i = queuedRow; i < end; i++)
+                copy_n(region.values.begin() + (size_t)i * region.cols, region.cols, data + (size_t)(region.row + i) * colsGrid + region.col);
+        }
+        QRect changed(region.col, region.row + queuedRow, region.cols, end - queuedRow);
+        queuedRow = end;
+        if (queuedRow == region.rows) {
+            queuedLevels.pop_front();
+            queuedRow = 0;
+        }
+        emit dataChanged(changed);
+    }
+    if (queuedLevels.empty())
+        applyTimer.stop();
+}
+
+/**
+ * @brief Очищает очередь блоков.
+ */
+void GridModel::clearQueuedLevels() {
+    queuedLevels.clear();
+    queuedRow = 0;
+    applyTimer.stop();
+}
+
+/**
+ * @brief Меняет высоту одной клетки; до следующего решения клетка считается сухой.
+ */
+void GridModel::setHeight(int row, int col, int height) {
+    size_t u = (size_t)row * colsGrid + col;
+    heightData[u] = height;
+    mutableLevels()[u] = height;
+    emit dataChanged(QRect(col, row, 1, 1));
+}
+
+/**
+ * @brief Возвращает уровни воды построчно (до решения - высоты).
+ */
+const int* GridModel::levels() const {
+    if (!levelData.empty())
+        return levelData.data();
+    if (levelGrid)
+        return levelGrid->values().data();
+    return heightData.data();
+}
+
+/**
+ * @brief Отделяет собственную копию уровней перед изменением отдельной клетки.
+ * Копия делается один раз после решения; дальнейшие правки меняют ее на месте.
+ */
+int* GridModel::mutableLevels() {
+    if (levelData.empty()) {
+        levelData = levelGrid ? levelGrid->values() : heightData;
+        levelGrid.reset();
+    }
+    return levelData.data();
+}
@@ -0,0 +1,134 @@
+#ifndef GRIDMODEL_H
+#define GRIDMODEL_H
+
+#include "heightgrid.h"
+#include "incrementalwatervolumesolver.h"
+#include <QObject>
+#include <QRect>
+#include <QTimer>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Класс GridModel хранит матрицу высот и уровни воды и сообщает об их изменениях.
+ * Высоты и уровни лежат построчно в непрерывных буферах с доступом за O(1). Представления
+ * (GridItem) рисуют модель и перерисовывают только области из сигнала dataChanged.
+ * Уровни решения не копируются, пока не изменится отдельная клетка.
+ * Блоки уровней, приходящие во время долгого решения, ставятся в очередь и применяются по таймеру
+ * полосами строк, не дольше frameBudget мс за кадр, чтобы основной поток не замирал.
+ */
+class GridModel : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Конструктор класса GridModel.
+     * @param parent Родительский объект (по умолчанию nullptr).
+     */
+    explicit GridModel(QObject *parent = nullptr);
+
+    /**
+     * @brief Задает новую матрицу высот, вода сбрасывается.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param heights Высоты построчно, rows * cols элементов.
+     */
+    void reset(int rows, int cols, vector<int> heights);
+
+    /**
+     * @brief Задает уровни воды всей матрицы (решение).
+     * @param levels Рабочая матрица того же размера.
+     */
+    void setLevels(SharedGrid levels);
+
+    /**
+     * @brief Меняет уровни воды в перечисленных клетках одним уведомлением.
+     * @param changes Клетки и их новые уровни.
+     */
+    void setLevels(const vector<CellChange>& changes);
+
+    /**
+     * @brief Ставит в очередь блоки с окончательными уровнями воды.
+     * @param regions Блоки уровней.
+     */
+    void queueLevels(const vector<GridRegion>& regions);
+
+    /**
+     * @brief Очищает очередь блоков, например блоки отмененного расчета.
+     */
+    void clearQueuedLevels();
+
+    /**
+     * @brief Принимает решение целиком без общей перерисовки.
+     * Подходит, когда все блоки решения уже пришли через queueLevels(): блоки, ожидающие в очереди,
+     * только перерисовываются.
+     * @param levels Рабочая матрица того же размера.
+     */
+    void adoptLevels(SharedGrid levels);
+
+    /**
+     * @brief Меняет высоту одной клетки; до следующего решения клетка считается сухой.
+     */
+    void setHeight(int row, int col, int height);
+
+    int rows() const { return rowsGrid; }
+    int cols() const { return colsGrid; }
+    int height(int row, int col) const { return heightData[(size_t)row * colsGrid + col]; }
+    int level(int row, int col) const { return levels()[(size_t)row * colsGrid + col]; }
+
+    /**
+     * @brief Возвращает высоты построчно.
+     */
+    const vector<int>& heights() const { return heightData; }
+
+    /**
+     * @brief Возвращает уровни воды построчно (до решения - высоты).
+     */
+    const int* levels() const;
+
+    /**
+     * @brief Возвращает представление матрицы высот для решателей и записи в файл.
+     */
+    GridView heightView() const { return GridView(rowsGrid, colsGrid, heightData); }
+
+signals:
+    /**
+     * @brief Сигнал смены размера или всей матрицы.
+     */
+    void gridReset();
+
+    /**
+     * @brief Сигнал изменения клеток.
+     * @param region Прямоугольник клеток (x - столбец, y - строка).
+     */
+    void dataChanged(const QRect& region);
+
+private slots:
+    /**
+     * @brief Применяет блоки из очереди, пока не истечет время кадра.
+     */
+    void applyQueuedLevels();
+
+private:
+    static constexpr int frameInterval = 16; /**< Период применения очереди блоков, мс. */
+    static constexpr int frameBudget = 8; /**< Время на очередь блоков за кадр, мс. */
+    static constexpr int bandCells = 16384; /**< Клеток в полосе, после которой проверяется время. */
+
+    int rowsGrid = 0; /**< Количество строк в матрице. */
+    int colsGrid = 0; /**< Количество столбцов в матрице. */
+    vector<int> heightData; /**< Высоты построчно. */
+    SharedGrid levelGrid; /**< Решение, пока ни одна клетка не изменилась. */
+    vector<int> levelData; /**< Собственная копия уровней после изменения отдельных клеток. */
+    deque<GridRegion> queuedLevels; /**< Блоки уровней, еще не примененные к модели. */
+    int queuedRow = 0; /**< Первая непримененная строка первого блока очереди. */
+    QTimer applyTimer; /**< Таймер применения очереди блоков. */
+
+    /**
+     * @brief Отделяет собственную копию уровней перед изменением отдельной клетки.
+     */
+    int* mutableLevels();
+};
+
+#endif // GRIDMODEL_H
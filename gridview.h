@@ -0,0 +1,77 @@
+#ifndef GRIDVIEW_H
+#define GRIDVIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Невладеющее представление матрицы высот в непрерывном буфере.
+ * Высоты - знаковые целые шириной elementWidth байт, строки идут подряд с шагом rowStride элементов.
+ * 64-битные высоты (elementWidth = 8) читает только TypedWaterVolumeSolver; остальным решателям нужен int.
+ * Буфер может принадлежать вектору или отображенному в память файлу (MappedGrid).
+ */
+struct GridView {
+    int rows = 0; /**< Количество строк в матрице. */
+    int cols = 0; /**< Количество столбцов в матрице. */
+    int elementWidth = 4; /**< Ширина высоты в байтах (1, 2, 4 или 8). */
+    size_t rowStride = 0; /**< Шаг между строками в элементах. */
+    const void* data = nullptr; /**< Первая клетка матрицы. */
+
+    GridView() = default;
+
+    /**
+     * @brief Представление построчного вектора высот int.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param heights Высоты построчно, не меньше rows * cols элементов.
+     */
+    GridView(int rows, int cols, const vector<int>& heights)
+        : rows(rows), cols(cols), elementWidth(4), rowStride(cols), data(heights.data()) {}
+
+    /**
+     * @brief Возвращает указатель на начало строки.
+     * @tparam T Тип высоты, соответствующий elementWidth.
+     * @param row Номер строки.
+     */
+    template <class T>
+    const T* row(int row) const {
+        return static_cast<const T*>(data) + (size_t)row * rowStride;
+    }
+
+    /**
+     * @brief Проверяет, помещаются ли высоты в int по ширине элемента.
+     */
+    bool fitsInt() const { return elementWidth <= 4; }
+
+    /**
+     * @brief Возвращает высоту клетки (медленный путь с выбором ширины на каждую клетку).
+     * Для 64-битных высот используйте at64().
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     */
+    int at(int row, int col) const {
+        switch (elementWidth) {
+        case 1:
+            return this->row<int8_t>(row)[col];
+        case 2:
+            return this->row<int16_t>(row)[col];
+        default:
+            return this->row<int32_t>(row)[col];
+        }
+    }
+
+    /**
+     * @brief Возвращает высоту клетки любой ширины, включая 64-битную.
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     */
+    int64_t at64(int row, int col) const {
+        if (elementWidth == 8)
+            return this->row<int64_t>(row)[col];
+        return at(row, col);
+    }
+};
+
+#endif // GRIDVIEW_H
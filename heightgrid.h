@@ -0,0 +1,64 @@
+#ifndef HEIGHTGRID_H
+#define HEIGHTGRID_H
+
+#include "gridview.h"
+#include <memory>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Класс HeightGrid - неизменяемая матрица в одном непрерывном буфере.
+ * Буфер передается в конструктор перемещением и больше не меняется, поэтому одну матрицу
+ * могут одновременно читать интерфейс и рабочие потоки через SharedGrid без копирования.
+ */
+class HeightGrid {
+public:
+    /**
+     * @brief Конструктор класса HeightGrid.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param values Значения построчно, rows * cols элементов.
+     */
+    HeightGrid(int rows, int cols, vector<int> values)
+        : rowsGrid(rows), colsGrid(cols), data(move(values)) {}
+
+    int rows() const { return rowsGrid; }
+    int cols() const { return colsGrid; }
+    int at(int row, int col) const { return data[(size_t)row * colsGrid + col]; }
+    const vector<int>& values() const { return data; }
+
+    /**
+     * @brief Возвращает представление матрицы для решателей (действительно, пока жив объект).
+     */
+    GridView view() const { return GridView(rowsGrid, colsGrid, data); }
+
+private:
+    int rowsGrid; /**< Количество строк в матрице. */
+    int colsGrid; /**< Количество столбцов в матрице. */
+    vector<int> data; /**< Значения построчно. */
+};
+
+typedef shared_ptr<const HeightGrid> SharedGrid;
+
+/**
+ * @brief Прямоугольная часть матрицы со своими значениями (например, уровни воды готового блока).
+ */
+struct GridRegion {
+    int row = 0; /**< Верхняя строка. */
+    int col = 0; /**< Левый столбец. */
+    int rows = 0; /**< Количество строк. */
+    int cols = 0; /**< Количество столбцов. */
+    vector<int> values; /**< Значения построчно, rows * cols элементов. */
+};
+
+/**
+ * @brief Создает разделяемую матрицу, забирая буфер без копирования.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param values Значения построчно, rows * cols элементов.
+ */
+inline SharedGrid makeSharedGrid(int rows, int cols, vector<int>&& values) {
+    return make_shared<const HeightGrid>(rows, cols, move(values));
+}
+
+#endif // HEIGHTGRID_H
@@ -0,0 +1,69 @@
+#include "heightqueue.h"
+
+/**
+ * @brief Выбирает режим и подготавливает очередь к работе.
+ * Корзины выбираются, когда их не больше, чем клеток, и не больше bucketLimit;
+ * на маленьких сетках двоичная куча дешевле подготовки корзин.
+ * @param minHeight Минимальная высота в сетке.
+ * @param maxHeight Максимальная высота в сетке.
+ * @param cells Количество клеток в сетке.
+ */
+void HeightQueue::init(int minHeight, int maxHeight, int cells) {
+    long long range = (long long)maxHeight - minHeight + 1;
+    QueueMode mode;
+    if (range <= bucketLimit && range <= cells)
+        mode = QueueMode::Bucket;
+    else if (cells >= smallGrid)
+        mode = QueueMode::RadixHeap;
+    else
+        mode = QueueMode::BinaryHeap;
+    init(mode, minHeight, maxHeight);
+}
+
+/**
+ * @brief Принудительно задает режим.
+ * Корзины и их память сохраняются между вызовами; опустошать их нужно, только если
+ * прошлое заполнение было прервано, после полного извлечения все корзины уже пусты.
+ * @param mode Режим работы очереди.
+ * @param minHeight Минимальная высота в сетке.
+ * @param maxHeight Максимальная высота в сетке.
+ */
+void HeightQueue::init(QueueMode mode, int minHeight, int maxHeight) {
+    if (count != 0) {
+        for (size_t b = 0; b < bucketCount; b++)
+            buckets[b].clear();
+        for (auto& bucket : radix)
+            bucket.clear();
+    }
+    queueMode = mode;
+    base = minHeight;
+    count = 0;
+    current = 0;
+    last = 0;
+    bucketCount = 0;
+    heap.init(minHeight, maxHeight, 0);
+    if (mode == QueueMode::Bucket) {
+        bucketCount = (size_t)((long long)maxHeight - minHeight + 1);
+        if (buckets.size() < bucketCount)
+            buckets.resize(bucketCount);
+    }
+}
+
+/**
+ * @brief Переносит элементы первой непустой корзины радиксной кучи в нижние корзины.
+ * Новым последним ключом становится минимум этой корзины, поэтому он попадает в корзину 0.
+ */
+void HeightQueue::refill() {
+    int i = 1;
+    while (radix[i].empty())
+        i++;
+    uint32_t minKey = radix[i][0].first;
+    for (const auto& x : radix[i]) {
+        if (x.first < minKey)
+            minKey = x.first;
+    }
+    last = minKey;
+    for (const auto& x : radix[i])
+        radix[radixBucket(x.first)].push_back(x);
+    radix[i].clear();
+}
@@ -0,0 +1,198 @@
+#ifndef HEIGHTQUEUE_H
+#define HEIGHTQUEUE_H
+
+#include <algorithm>
+#include <vector>
+#include <queue>
+#include <cstdint>
+using namespace std;
+
+typedef pair<int, int> pii;
+
+/**
+ * @brief Класс BasicBinaryHeapQueue - очередь с приоритетом на двоичной куче.
+ * Пары (высота, индекс клетки) хранятся в куче поверх вектора, push и pop стоят O(log n).
+ * Вектор не освобождается в init(), поэтому повторное использование очереди не выделяет память.
+ * @tparam Height Тип высоты (любой целый, в том числе 64-битный).
+ */
+template <class Height>
+class BasicBinaryHeapQueue {
+public:
+    typedef pair<Height, int> Entry;
+
+    /**
+     * @brief Подготавливает очередь к работе.
+     * @param minHeight Минимальная высота в сетке.
+     * @param maxHeight Максимальная высота в сетке.
+     * @param cells Количество клеток в сетке.
+     */
+    void init(Height minHeight, Height maxHeight, int cells) {
+        (void)minHeight;
+        (void)maxHeight;
+        (void)cells;
+        heap.clear();
+    }
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+
+    void push(Height height, int index) {
+        heap.push_back({height, index});
+        push_heap(heap.begin(), heap.end(), greater<Entry>());
+    }
+
+    /**
+     * @brief Извлекает клетку с минимальной высотой.
+     * @return Пара (высота, индекс клетки).
+     */
+    Entry pop() {
+        pop_heap(heap.begin(), heap.end(), greater<Entry>());
+        Entry x = heap.back();
+        heap.pop_back();
+        return x;
+    }
+
+private:
+    vector<Entry> heap; /**< Двоичная куча пар (высота, индекс клетки). */
+};
+
+typedef BasicBinaryHeapQueue<int> BinaryHeapQueue;
+
+/**
+ * @brief Режим работы очереди HeightQueue.
+ */
+enum class QueueMode {
+    Bucket, /**< Корзина на каждую высоту, элемент - 32-битный индекс клетки. */
+    RadixHeap, /**< Радиксная куча для широкого диапазона высот. */
+    BinaryHeap /**< Двоичная куча для маленьких сеток. */
+};
+
+/**
+ * @brief Класс HeightQueue - очередь с приоритетом, специализированная для целых высот.
+ * Режим выбирается в init() по наблюдаемому диапазону высот и размеру сетки.
+ * Корзинный и радиксный режимы рассчитаны на монотонное извлечение: высота нового элемента
+ * не меньше последней извлеченной, что выполняется для заполнения от границы.
+ */
+class HeightQueue {
+public:
+    /**
+     * @brief Выбирает режим и подготавливает очередь к работе.
+     * @param minHeight Минимальная высота в сетке.
+     * @param maxHeight Максимальная высота в сетке.
+     * @param cells Количество клеток в сетке.
+     */
+    void init(int minHeight, int maxHeight, int cells);
+
+    /**
+     * @brief Принудительно задает режим (для замеров и тестов).
+     * @param mode Режим работы очереди.
+     * @param minHeight Минимальная высота в сетке.
+     * @param maxHeight Максимальная высота в сетке.
+     */
+    void init(QueueMode mode, int minHeight, int maxHeight);
+
+    QueueMode mode() const { return queueMode; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void push(int height, int index) {
+        count++;
+        if (queueMode == QueueMode::Bucket) {
+            int b = height - base;
+            if (b < current)
+                current = b;
+            buckets[b].push_back(index);
+        } else if (queueMode == QueueMode::RadixHeap) {
+            uint32_t key = (uint32_t)((int64_t)height - base);
+            radix[radixBucket(key)].push_back({key, index});
+        } else {
+            heap.push(height, index);
+        }
+    }
+
+    /**
+     * @brief Извлекает клетку с минимальной высотой.
+     * @return Пара (высота, индекс клетки).
+     */
+    pii pop() {
+        count--;
+        if (queueMode == QueueMode::Bucket) {
+            while (buckets[current].empty())
+                current++;
+            int index = buckets[current].back();
+            buckets[current].pop_back();
+            return {current + base, index};
+        } else if (queueMode == QueueMode::RadixHeap) {
+            if (radix[0].empty())
+                refill();
+            pair<uint32_t, int> x = radix[0].back();
+            radix[0].pop_back();
+            return {(int)((int64_t)x.first + base), x.second};
+        }
+        return heap.pop();
+    }
+
+private:
+    static const int bucketLimit = 1 << 16; /**< Наибольшее количество корзин. */
+    static const int smallGrid = 4096; /**< Сетки меньше этого размера используют двоичную кучу. */
+
+    QueueMode queueMode = QueueMode::BinaryHeap; /**< Текущий режим. */
+    int base = 0; /**< Минимальная высота, от которой отсчитываются ключи. */
+    size_t count = 0; /**< Количество элементов в очереди. */
+
+    vector<vector<int>> buckets; /**< Корзины индексов клеток по высоте (режим Bucket). */
+    int current = 0; /**< Номер корзины, с которой начинается поиск минимума. */
+
+    vector<pair<uint32_t, int>> radix[33]; /**< Корзины радиксной кучи (режим RadixHeap). */
+    uint32_t last = 0; /**< Последний извлеченный ключ радиксной кучи. */
+
+    size_t bucketCount = 0; /**< Количество корзин, используемых в режиме Bucket. */
+
+    BinaryHeapQueue heap; /**< Двоичная куча (режим BinaryHeap). */
+
+    int radixBucket(uint32_t key) const {
+        return key == last ? 0 : highestBit(key ^ last) + 1;
+    }
+
+    static int highestBit(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 31 - __builtin_clz(x);
+#else
+        int bit = 0;
+        while (x >>= 1)
+            bit++;
+        return bit;
+#endif
+    }
+
+    /**
+     * @brief Переносит элементы первой непустой корзины радиксной кучи в нижние корзины.
+     */
+    void refill();
+};
+
+/**
+ * @brief Обертка над очередью, считающая операции (для замеров).
+ * @tparam Queue Очередь, к которой добавляются счетчики.
+ */
+template <class Queue>
+class CountingQueue : public Queue {
+public:
+    void push(int height, int index) {
+        pushes++;
+        Queue::push(height, index);
+        if (Queue::size() > peak)
+            peak = Queue::size();
+    }
+
+    pii pop() {
+        pops++;
+        return Queue::pop();
+    }
+
+    long long pushes = 0; /**< Количество добавлений. */
+    long long pops = 0; /**< Количество извлечений. */
+    size_t peak = 0; /**< Наибольший размер очереди. */
+};
+
+#endif // HEIGHTQUEUE_H
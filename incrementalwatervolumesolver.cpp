@@ -0,0 +1,290 @@
+#include "incrementalwatervolumesolver.h"
+#include "watervolumesolver.h"
+
+#include <algorithm>
+
+/**
+ * @brief Конструктор класса IncrementalWaterVolumeSolver, выполняющий полное решение.
+ * @param view Матрица с высотами столбцов.
+ */
+IncrementalWaterVolumeSolver::IncrementalWaterVolumeSolver(const GridView& view)
+    : rowsMatrix(view.rows), colsMatrix(view.cols), heights((size_t)view.rows * view.cols), levels((size_t)view.rows * view.cols) {
+    WaterVolumeSolver solver(view);
+    solver.setEngine(SolverEngine::PriorityFloodPlus);
+    sumWater = solver.solve();
+    vector<vector<int>> workingMatrix = solver.getWorkingMatrix();
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++) {
+            heights[(size_t)i * colsMatrix + j] = view.at(i, j);
+            levels[(size_t)i * colsMatrix + j] = workingMatrix[i][j];
+        }
+    }
+    mark.assign(heights.size(), 0);
+    changedMark.assign(heights.size(), 0);
+}
+
+/**
+ * @brief Конструктор класса IncrementalWaterVolumeSolver из готового решения.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param heights Высоты столбцов, построчно.
+ * @param levels Уровни воды (рабочая матрица), построчно.
+ * @param volume Объем воды.
+ */
+IncrementalWaterVolumeSolver::IncrementalWaterVolumeSolver(int rows, int cols, vector<int> heights, vector<int> levels, ll volume)
+    : rowsMatrix(rows), colsMatrix(cols), sumWater(volume), heights(move(heights)), levels(move(levels)) {
+    mark.assign(this->heights.size(), 0);
+    changedMark.assign(this->heights.size(), 0);
+}
+
+bool IncrementalWaterVolumeSolver::onBorder(int u) const {
+    int i = u / colsMatrix;
+    int j = u % colsMatrix;
+    return i == 0 || i == rowsMatrix - 1 || j == 0 || j == colsMatrix - 1;
+}
+
+/**
+ * @brief Возвращает индекс соседа клетки или -1, если сосед вне сетки.
+ */
+int IncrementalWaterVolumeSolver::neighbour(int u, int direction) const {
+    int j = u % colsMatrix;
+    switch (direction) {
+    case 0:
+        return j + 1 < colsMatrix ? u + 1 : -1;
+    case 1:
+        return j > 0 ? u - 1 : -1;
+    case 2:
+        return u + colsMatrix < rowsMatrix * colsMatrix ? u + colsMatrix : -1;
+    default:
+        return u >= colsMatrix ? u - colsMatrix : -1;
+    }
+}
+
+/**
+ * @brief Записывает уровень клетки и запоминает ее как измененную.
+ */
+void IncrementalWaterVolumeSolver::setLevel(int v, int level) {
+    if (changedMark[v] != updateGeneration) {
+        changedMark[v] = updateGeneration;
+        changed.push_back({v, levels[v]});
+    }
+    levels[v] = level;
+}
+
+/**
+ * @brief Применяет правки и обновляет решение.
+ * @param edits Новые высоты клеток, применяются по порядку.
+ * @param changes Если не nullptr, сюда записываются клетки, уровень которых изменился.
+ * @return Новый объем воды.
+ */
+ll IncrementalWaterVolumeSolver::update(const vector<CellEdit>& edits, vector<CellChange>* changes) {
+    updateGeneration++;
+    changed.clear();
+    for (const CellEdit& edit : edits) {
+        int u = edit.row * colsMatrix + edit.col;
+        if (edit.height > heights[u])
+            raise(u, edit.height);
+        else if (edit.height < heights[u])
+            lower(u, edit.height);
+    }
+
+    if (changes) {
+        changes->clear();
+        for (const pii& c : changed) {
+            if (levels[c.first] != c.second)
+                changes->push_back(CellChange{c.first / colsMatrix, c.first % colsMatrix, levels[c.first]});
+        }
+    }
+    return sumWater;
+}
+
+/**
+ * @brief Строит дерево стока по текущим уровням.
+ * Клетки на краю сетки - корни; сток соседа w идет в клетку v, если max(высота w, уровень v)
+ * равен уровню w. Такие ребра от края достигают всех клеток, поэтому хватает обхода в ширину.
+ */
+void IncrementalWaterVolumeSolver::buildDrain() {
+    drain.assign(heights.size(), root);
+    generation++;
+    region.clear();
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j += (i == 0 || i == rowsMatrix - 1 || j == colsMatrix - 1) ? 1 : colsMatrix - 1) {
+            mark[i * colsMatrix + j] = generation;
+            region.push_back(i * colsMatrix + j);
+        }
+    }
+    for (size_t k = 0; k < region.size(); k++) {
+        int v = region[k];
+        int j = v % colsMatrix;
+        // Соседи в порядке направлений neighbour(): справа, слева, снизу, сверху
+        int next[4] = {j + 1 < colsMatrix ? v + 1 : -1, j > 0 ? v - 1 : -1,
+                       v + colsMatrix < (int)heights.size() ? v + colsMatrix : -1, v >= colsMatrix ? v - colsMatrix : -1};
+        for (int d = 0; d < 4; d++) {
+            int w = next[d];
+            if (w >= 0 && mark[w] != generation && max(heights[w], levels[v]) == levels[w]) {
+                mark[w] = generation;
+                drain[w] = d ^ 1;
+                region.push_back(w);
+            }
+        }
+    }
+    drainBuilt = true;
+}
+
+/**
+ * @brief Решает сетку заново целиком и записывает изменившиеся уровни.
+ * Дерево стока после этого строится заново при следующем повышении клетки.
+ */
+void IncrementalWaterVolumeSolver::solveFull() {
+    WaterVolumeSolver solver(GridView(rowsMatrix, colsMatrix, heights));
+    solver.setEngine(SolverEngine::PriorityFloodPlus);
+    sumWater = solver.solve();
+    vector<vector<int>> workingMatrix = solver.getWorkingMatrix();
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++) {
+            int v = i * colsMatrix + j;
+            if (levels[v] != workingMatrix[i][j])
+                setLevel(v, workingMatrix[i][j]);
+        }
+    }
+    drainBuilt = false;
+}
+
+/**
+ * @brief Повышает клетку и заново заполняет область, уровни которой могут подняться.
+ * Если новая высота не выше уровня воды, вода по-прежнему покрывает клетку и уровни не меняются.
+ * Иначе у клетки, вода которой уходит не через u, путь стока остается прежним и уровень не
+ * растет; подняться могут только клетки поддерева u в дереве стока, причем с уровнем ниже новой
+ * высоты (их потомки не выше своего предка с прежним путем через u). Уровни клеток вокруг этой
+ * области не меняются и служат берегом при повторном заполнении.
+ * @param u Индекс клетки.
+ * @param newHeight Новая высота.
+ */
+void IncrementalWaterVolumeSolver::raise(int u, int newHeight) {
+    int oldHeight = heights[u];
+    if (newHeight <= levels[u]) {
+        heights[u] = newHeight;
+        sumWater -= (ll)newHeight - oldHeight;
+        return;
+    }
+    // Дерево стока строится по прежней высоте: уровни еще соответствуют ей
+    if (!drainBuilt)
+        buildDrain();
+    heights[u] = newHeight;
+
+    // Два поколения меток на вызов: generation - клетка в области, generation + 1 - уровень найден
+    generation += 2;
+    unsigned inRegion = generation;
+    unsigned done = generation + 1;
+    size_t regionLimit = heights.size() / fullSolveFraction;
+    region.clear();
+    region.push_back(u);
+    mark[u] = inRegion;
+    for (size_t k = 0; k < region.size(); k++) {
+        int v = region[k];
+        for (int d = 0; d < 4; d++) {
+            int w = neighbour(v, d);
+            if (w >= 0 && drain[w] == (d ^ 1) && mark[w] != inRegion && levels[w] < newHeight) {
+                mark[w] = inRegion;
+                region.push_back(w);
+            }
+        }
+        if (region.size() > regionLimit) {
+            solveFull();
+            return;
+        }
+    }
+
+    sumWater -= (ll)levels[u] - oldHeight;
+    for (size_t k = 1; k < region.size(); k++)
+        sumWater -= (ll)levels[region[k]] - heights[region[k]];
+    // Уровни области не выше новой высоты: путь через u дает ее. Берег не ниже новой высоты
+    // не нужен, а среди таких клеток есть потомки области, и сток в них замкнул бы дерево в цикл
+    for (int v : region) {
+        if (onBorder(v))
+            refill.push({heights[v], {v, root}});
+        for (int d = 0; d < 4; d++) {
+            int w = neighbour(v, d);
+            if (w >= 0 && mark[w] != inRegion && levels[w] < newHeight)
+                refill.push({max(levels[w], heights[v]), {v, d}});
+        }
+    }
+    while (!refill.empty()) {
+        pair<int, pii> x = refill.top();
+        refill.pop();
+        int v = x.second.first;
+        if (mark[v] != inRegion)
+            continue;
+        mark[v] = done;
+        drain[v] = onBorder(v) ? root : x.second.second;
+        if (levels[v] != x.first)
+            setLevel(v, x.first);
+        sumWater += (ll)x.first - heights[v];
+        for (int d = 0; d < 4; d++) {
+            int w = neighbour(v, d);
+            if (w >= 0 && mark[w] == inRegion)
+                refill.push({max(x.first, heights[w]), {w, d ^ 1}});
+        }
+    }
+}
+
+/**
+ * @brief Понижает клетку и распространяет понижение уровней от нее.
+ * Новый уровень клетки - ее высота на краю сетки, иначе максимум из высоты и наименьшего уровня соседей.
+ * Если он ниже прежнего, уровни соседей понижаются, пока вода может уйти через эту клетку.
+ * @param u Индекс клетки.
+ * @param newHeight Новая высота.
+ */
+void IncrementalWaterVolumeSolver::lower(int u, int newHeight) {
+    int oldHeight = heights[u];
+    int oldLevel = levels[u];
+    heights[u] = newHeight;
+
+    int level = newHeight;
+    int lowestDirection = root;
+    if (!onBorder(u)) {
+        lowestDirection = 0;
+        for (int d = 1; d < 4; d++) {
+            if (levels[neighbour(u, d)] < levels[neighbour(u, lowestDirection)])
+                lowestDirection = d;
+        }
+        level = max(newHeight, levels[neighbour(u, lowestDirection)]);
+    }
+    sumWater += (ll)level - newHeight - ((ll)oldLevel - oldHeight);
+    if (level == oldLevel)
+        return;
+
+    // Понизившиеся клетки стекают в клетку, от которой получили новый уровень; у остальных клеток
+    // прежний сосед стока по-прежнему дает их уровень
+    if (drainBuilt)
+        drain[u] = lowestDirection;
+    setLevel(u, level);
+    pq.push({level, u});
+    while (!pq.empty()) {
+        pii x = pq.top();
+        pq.pop();
+        int v = x.second;
+        if (x.first > levels[v])
+            continue;
+        for (int d = 0; d < 4; d++) {
+            int w = neighbour(v, d);
+            if (w < 0)
+                continue;
+            int candidate = max(x.first, heights[w]);
+            if (candidate < levels[w]) {
+                sumWater -= (ll)levels[w] - candidate;
+                setLevel(w, candidate);
+                if (drainBuilt)
+                    drain[w] = d ^ 1;
+                pq.push({candidate, w});
+            }
+        }
+    }
+}
+
+vector<vector<int>> IncrementalWaterVolumeSolver::getWorkingMatrix() const {
+    vector<vector<int>> matrixOutput(rowsMatrix);
+    for (int i = 0; i < rowsMatrix; i++)
+        matrixOutput[i].assign(levels.begin() + (size_t)i * colsMatrix, levels.begin() + (size_t)(i + 1) * colsMatrix);
+    return matrixOutput;
+}
@@ -0,0 +1,132 @@
+#ifndef INCREMENTALWATERVOLUMESOLVER_H
+#define INCREMENTALWATERVOLUMESOLVER_H
+
+#include "gridview.h"
+#include <queue>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+typedef pair<int, int> pii;
+
+/**
+ * @brief Изменение высоты одной клетки.
+ */
+struct CellEdit {
+    int row; /**< Строка клетки. */
+    int col; /**< Столбец клетки. */
+    int height; /**< Новая высота. */
+};
+
+/**
+ * @brief Клетка рабочей матрицы, уровень воды в которой изменился.
+ */
+struct CellChange {
+    int row; /**< Строка клетки. */
+    int col; /**< Столбец клетки. */
+    int level; /**< Новый уровень воды. */
+};
+
+/**
+ * @brief Класс IncrementalWaterVolumeSolver хранит решение и обновляет его после правки отдельных клеток.
+ * Для каждой клетки хранится сосед, через которого уходит ее вода (дерево стока с корнями на
+ * краю сетки). Понижение клетки может только понизить уровни: новый уровень клетки находится по
+ * соседям и распространяется от нее, пока уровни уменьшаются. Повышение клетки выше ее уровня
+ * воды может поднять уровни только у клеток, вода которых уходит через нее и уровень которых ниже
+ * новой высоты; эта область заново заполняется от своей границы. Время обновления зависит от
+ * размера затронутой области, а не всей сетки; если область больше 1/fullSolveFraction сетки,
+ * сетка решается заново целиком.
+ */
+class IncrementalWaterVolumeSolver {
+public:
+    /**
+     * @brief Конструктор класса IncrementalWaterVolumeSolver, выполняющий полное решение.
+     * @param view Матрица с высотами столбцов.
+     */
+    explicit IncrementalWaterVolumeSolver(const GridView& view);
+
+    /**
+     * @brief Конструктор класса IncrementalWaterVolumeSolver из готового решения.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param heights Высоты столбцов, построчно.
+     * @param levels Уровни воды (рабочая матрица), построчно.
+     * @param volume Объем воды.
+     */
+    IncrementalWaterVolumeSolver(int rows, int cols, vector<int> heights, vector<int> levels, ll volume);
+
+    /**
+     * @brief Применяет правки и обновляет решение.
+     * @param edits Новые высоты клеток, применяются по порядку.
+     * @param changes Если не nullptr, сюда записываются клетки, уровень которых изменился.
+     * @return Новый объем воды.
+     */
+    ll update(const vector<CellEdit>& edits, vector<CellChange>* changes = nullptr);
+
+    ll volume() const { return sumWater; }
+    int rows() const { return rowsMatrix; }
+    int cols() const { return colsMatrix; }
+    int height(int row, int col) const { return heights[(size_t)row * colsMatrix + col]; }
+    int level(int row, int col) const { return levels[(size_t)row * colsMatrix + col]; }
+
+    vector<vector<int>> getWorkingMatrix() const;
+
+    static const int fullSolveFraction = 4; /**< Область больше 1/fullSolveFraction сетки решается полным решением. */
+
+private:
+    static constexpr unsigned char root = 4; /**< Направление стока клетки на краю сетки: вода уходит за край. */
+
+    int rowsMatrix; /**< Количество строк в матрице. */
+    int colsMatrix; /**< Количество столбцов в матрице. */
+    ll sumWater; /**< Суммарный объем воды. */
+    vector<int> heights; /**< Высоты столбцов, построчно. */
+    vector<int> levels; /**< Уровни воды, построчно. */
+    vector<unsigned> mark; /**< Метки поколений: клетка входит в текущую область, если ее метка равна generation. */
+    vector<unsigned> changedMark; /**< Метки вызовов update() для клеток, уже записанных в список изменений. */
+    vector<unsigned char> drain; /**< Направление к соседу, через которого уходит вода клетки (как в neighbour()), или root. */
+    bool drainBuilt = false; /**< Дерево стока построено и соответствует уровням. */
+    unsigned generation = 0; /**< Текущее поколение меток области. */
+    unsigned updateGeneration = 0; /**< Номер текущего вызова update(). */
+    priority_queue<pii, vector<pii>, greater<pii>> pq; /**< Очередь (уровень, индекс клетки). */
+    priority_queue<pair<int, pii>, vector<pair<int, pii>>, greater<pair<int, pii>>> refill; /**< Очередь (уровень, (индекс клетки, направление стока)). */
+    vector<int> region; /**< Клетки заново заполняемой области. */
+    vector<pii> changed; /**< Пары (индекс клетки, уровень до вызова update()) для клеток, уровень которых менялся. */
+
+    /**
+     * @brief Строит дерево стока по текущим уровням.
+     */
+    void buildDrain();
+
+    /**
+     * @brief Решает сетку заново целиком и записывает изменившиеся уровни.
+     */
+    void solveFull();
+
+    /**
+     * @brief Повышает клетку и заново заполняет область, уровни которой могут подняться.
+     * @param u Индекс клетки.
+     * @param newHeight Новая высота.
+     */
+    void raise(int u, int newHeight);
+
+    /**
+     * @brief Понижает клетку и распространяет понижение уровней от нее.
+     * @param u Индекс клетки.
+     * @param newHeight Новая высота.
+     */
+    void lower(int u, int newHeight);
+
+    /**
+     * @brief Записывает уровень клетки и запоминает ее как измененную.
+     */
+    void setLevel(int v, int level);
+
+    bool onBorder(int u) const;
+
+    /**
+     * @brief Возвращает индекс соседа клетки или -1, если сосед вне сетки.
+     */
+    int neighbour(int u, int direction) const;
+};
+
+#endif // INCREMENTALWATERVOLUMESOLVER_H
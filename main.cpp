@@ -1,4 +1,3 @@
-#include "unittests.h"
 #include "mainwindow.h"
 
 #include <QApplication>
@@ -13,7 +12,6 @@ using namespace std;
  * @return Код завершения приложения.
  */
 int main(int argc, char *argv[]) {
-    unitTests();
     QApplication app(argc, argv);
 
     MainWindow mainWindow;
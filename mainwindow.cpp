@@ -1,6 +1,9 @@
 #include "mainwindow.h"
 #include "watervolumesolver.h"
-#include "solverthread.h"
+#include "gridfile.h"
+#include "packedgrid.h"
+
+#include <climits>
 
 /**
  * @brief Конструктор класса MainWindow.
@@ -10,6 +13,12 @@ MainWindow::MainWindow(QWidget *parent) : QWidget(parent) {
     setMinimumSize(500, 500);
 
     mainLayout = new QVBoxLayout(this);
+    solverScheduler = new SolverScheduler(0, this);
+
+    // Решения хранятся и на диске, поэтому после перезапуска загруженный файл решается сразу;
+    // каталог занимает не больше SolveCache::defaultDiskLimit, давно не использованные файлы удаляются
+    QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/solves";
+    solverScheduler->cache().setDirectory(QFile::encodeName(cacheDirectory).toStdString());
 
     // Создание элементов интерфейса
     createInputWidgets();
@@ -23,6 +32,11 @@ MainWindow::MainWindow(QWidget *parent) : QWidget(parent) {
     connect(solveButton, &QPushButton::clicked, this, &MainWindow::handleSolveButtonClicked);
     connect(saveButton, &QPushButton::clicked, this, &MainWindow::handleSaveButtonClicked);
     connect(loadButton, &QPushButton::clicked, this, &MainWindow::handleLoadButtonClicked);
+    connect(gridItem, &GridItem::cellDoubleClicked, this, &MainWindow::handleCellDoubleClicked);
+    connect(solverScheduler, &SolverScheduler::finished, this, &MainWindow::handleCalculationComplete);
+    connect(solverScheduler, &SolverScheduler::progress, this, &MainWindow::handleCalculationProgress);
+    connect(solverScheduler, &SolverScheduler::regionsSolved, this, &MainWindow::handleRegionsSolved);
+    connect(solverScheduler, &SolverScheduler::editsApplied, this, &MainWindow::handleEditsApplied);
 }
 
 /**
@@ -52,6 +66,14 @@ void MainWindow::createInputWidgets() {
 void MainWindow::createButtonWidgets() {
     inputButton = new QPushButton("Ввод");
     randomButton = new QPushButton("Рандом");
+    terrainInput = new QComboBox;
+    terrainInput->addItem("Шум", (int)TerrainKind::Uniform);
+    terrainInput->addItem("Фрактальный", (int)TerrainKind::Fractal);
+    terrainInput->addItem("Чаши", (int)TerrainKind::Bowls);
+    terrainInput->addItem("Котловина", (int)TerrainKind::Plateau);
+    terrainInput->addItem("Спираль", (int)TerrainKind::Spiral);
+    terrainInput->addItem("Змейка", (int)TerrainKind::Serpentine);
+    terrainInput->addItem("Склон", (int)TerrainKind::Ramp);
     solveButton = new QPushButton("Решить");
     loadButton = new QPushButton("Загрузить");
     solveButton->setEnabled(false);
@@ -59,6 +81,7 @@ void MainWindow::createButtonWidgets() {
     QHBoxLayout *buttonLayout = new QHBoxLayout;
     buttonLayout->addWidget(inputButton);
     buttonLayout->addWidget(randomButton);
+    buttonLayout->addWidget(terrainInput);
     buttonLayout->addWidget(loadButton);
     mainLayout->addLayout(buttonLayout);
     mainLayout->addWidget(solveButton);
@@ -78,6 +101,11 @@ void MainWindow::createGraphicsView() {
     graphicsView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     graphicsView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     mainLayout->addWidget(graphicsView);
+
+    // Вся матрица - один элемент сцены, который рисует только видимые клетки
+    gridModel = new GridModel(this);
+    gridItem = new GridItem(gridModel);
+    graphicsScene->addItem(gridItem);
 }
 
 /**
@@ -92,6 +120,12 @@ void MainWindow::createResultWidgets() {
     QHBoxLayout *resultLayout = new QHBoxLayout;
     resultLayout->addWidget(resultLabel);
     resultLayout->addWidget(resultLineEdit);
+    solveProgress = new QProgressBar;
+    solveProgress->setFixedWidth(150);
+    solveProgress->setRange(0, 1000);
+    solveProgress->setTextVisible(false);
+    solveProgress->hide();
+    resultLayout->addWidget(solveProgress);
     resultLayout->addStretch();
     saveButton = new QPushButton("Сохранить");
     resultLayout->addWidget(saveButton);
@@ -102,31 +136,30 @@ void MainWindow::createResultWidgets() {
 }
 
 /**
- * @brief Создает элементы матрицы и размещает их на сцене.
+ * @brief Создает пустую матрицу и показывает ее на сцене.
  * @param rows Количество строк в матрице.
  * @param cols Количество столбцов в матрице.
- * @param randomFill Флаг, указывающий, нужно ли заполнить матрицу случайными значениями.
  */
-void MainWindow::createMatrixItems(int rows, int cols, bool randomFill) {
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            QGraphicsRectItem *matrixItem = new QGraphicsRectItem;
-            QBrush greenBrush(Qt::green);
-            matrixItem->setRect(j * 50, i * 50, 50, 50);
-            matrixItem->setBrush(greenBrush);
-            matrixItem->setAcceptHoverEvents(true);
-            matrixItem->setData(0, "");
-            graphicsScene->addItem(matrixItem);
-
-            QGraphicsTextItem *textItem = new QGraphicsTextItem;
-            QString text = randomFill ? QString::number(QRandomGenerator::global()->bounded(0, 11)) : "";
-            textItem->setPlainText(text);
-            textItem->setPos(j * 50 + 15, i * 50 + 15);
-            textItem->setTextWidth(25);
-            textItem->setTextInteractionFlags(Qt::TextEditorInteraction);
-            graphicsScene->addItem(textItem);
-        }
-    }
+void MainWindow::createMatrixItems(int rows, int cols) {
+    showGrid(rows, cols, vector<int>((size_t)rows * cols, 0));
+}
+
+/**
+ * @brief Показывает новую матрицу высот и сбрасывает прошлое решение.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param heights Высоты построчно.
+ */
+void MainWindow::showGrid(int rows, int cols, vector<int> heights) {
+    ++terrainGeneration;
+    incremental.reset();
+    solverScheduler->cancel();
+    pendingGeneration = 0;
+    solveProgress->hide();
+    pendingEdits.clear();
+    gridModel->reset(rows, cols, move(heights));
+    graphicsScene->setSceneRect(gridItem->boundingRect());
+    resultLineEdit->clear();
 }
 
 /**
@@ -166,10 +199,7 @@ void MainWindow::handleInputButtonClicked() {
         return;
     }
 
-    // Очистить предыдущее содержимое сцены
-    graphicsScene->clear();
-
-    // Создание матрицы элементов
+    // Создание пустой матрицы
     createMatrixItems(rows, cols);
 
     solveButton->setEnabled(true);
@@ -177,7 +207,8 @@ void MainWindow::handleInputButtonClicked() {
 
 /**
  * @brief Обработчик нажатия на кнопку "Рандом".
- * Создает матрицу элементов и заполняет ее случайными значениями.
+ * Генерирует рельеф выбранного вида в фоновом пуле потоков; зерно показывается в подсказке
+ * к кнопке, чтобы рельеф можно было повторить (watercuboids-cli --generate ВИД --seed N).
  */
 void MainWindow::handleRandomButtonClicked() {
     int rows = rowsInput->text().toInt();
@@ -188,143 +219,226 @@ void MainWindow::handleRandomButtonClicked() {
         return;
     }
 
-    // Очистить предыдущее содержимое сцены
-    graphicsScene->clear();
-
-    // Создание матрицы элементов и заполнение случайными значениями
-    createMatrixItems(rows, cols, true);
+    TerrainKind kind = (TerrainKind)terrainInput->currentData().toInt();
+    quint64 seed = QRandomGenerator::global()->generate64();
+    randomButton->setToolTip(QString("Рельеф %1, зерно %2").arg(terrainName(kind)).arg(seed));
+
+    // Высоты пишутся прямо в буфер будущей модели; окно получает его, когда генерация закончится
+    quint64 generation = ++terrainGeneration;
+    terrainPool.start([this, generation, kind, rows, cols, seed]() {
+        auto heights = make_shared<vector<int>>((size_t)rows * cols);
+        generateTerrain(kind, rows, cols, seed, heights->data());
+        QMetaObject::invokeMethod(this, [this, generation, rows, cols, heights]() {
+            handleTerrainGenerated(generation, rows, cols, heights);
+        }, Qt::QueuedConnection);
+    });
+}
 
+/**
+ * @brief Показывает сгенерированный рельеф, если после запуска генерации не появилась другая матрица.
+ * @param generation Номер запуска генерации.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param heights Высоты построчно.
+ */
+void MainWindow::handleTerrainGenerated(quint64 generation, int rows, int cols, shared_ptr<vector<int>> heights) {
+    if (generation != terrainGeneration)
+        return;
+    showGrid(rows, cols, move(*heights));
     solveButton->setEnabled(true);
 }
 
 /**
  * @brief Обработчик нажатия на кнопку "Решить".
- * Извлекает значения матрицы из графической сцены и запускает вычисления в рабочем потоке.
+ * Если матрица уже решена и с тех пор изменено немного клеток, правки применяются к прошлому
+ * решению, иначе запускается полное решение; и то, и другое выполняется в фоновом потоке.
+ * Повторное нажатие во время расчета отменяет его и решает текущую матрицу.
  */
 void MainWindow::handleSolveButtonClicked() {
-    int rows = rowsInput->text().toInt();
-    int cols = colsInput->text().toInt();
-    vector<vector<int>> matrix(rows, vector<int>(cols));
-
-    // Получение значений матрицы из графической сцены
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            QGraphicsTextItem *textItem = qgraphicsitem_cast<QGraphicsTextItem*>(graphicsScene->itemAt(j * 50 + 15, i * 50 + 15, QTransform()));
-            QString text = textItem->toPlainText();
-            matrix[i][j] = text.toInt();
-        }
-    }
+    int rows = gridModel->rows();
+    int cols = gridModel->cols();
 
-    // Создаем объект рабочего потока и передаем ему матрицу
-    SolverThread* solverThread = new SolverThread(rows, cols, matrix);
-    // Соединяем сигнал завершения расчета из потока с соответствующим слотом в MainWindow
-    connect(solverThread, &SolverThread::calculationComplete, this, &MainWindow::handleCalculationComplete);
+    if (incremental && pendingEdits.size() <= (size_t)incrementalEditLimit) {
+        // Прошлое решение обновляется в потоке планировщика, затронутые клетки придут в handleEditsApplied()
+        solverScheduler->update(incremental, move(pendingEdits));
+        pendingEdits.clear();
+        return;
+    }
+    incremental.reset();
+    pendingEdits.clear();
+    // Блоки прошлого (отменяемого) расчета еще могут ждать в очереди модели
+    gridModel->clearQueuedLevels();
+
+    // Копия высот переходит в разделяемый буфер: поток читает ее, пока в окне можно править клетки
+    pendingGeneration = solverScheduler->submit(makeSharedGrid(rows, cols, vector<int>(gridModel->heights())));
+    solveProgress->setValue(0);
+    solveProgress->show();
+}
 
-    // Запускаем поток
-    solverThread->start();
+/**
+ * @brief Обработчик двойного щелчка по клетке: запрашивает новую высоту.
+ * @param row Строка клетки.
+ * @param col Столбец клетки.
+ */
+void MainWindow::handleCellDoubleClicked(int row, int col) {
+    bool ok = false;
+    int height = QInputDialog::getInt(this, "Высота", "Высота клетки:", gridModel->height(row, col), INT_MIN, INT_MAX, 1, &ok);
+    if (!ok || height == gridModel->height(row, col))
+        return;
+    gridModel->setHeight(row, col, height);
+    pendingEdits.push_back(CellEdit{row, col, height});
 }
 
+/**
+ * @brief Обработчик нажатия на кнопку "Сохранить".
+ * Сохраняет матрицу в двоичном файле сетки с заголовком (см. GridFileHeader),
+ * а с расширением .wcp - в сжатом файле сетки (см. PackedGridHeader).
+ */
 void MainWindow::handleSaveButtonClicked() {
-    QString fileName = QFileDialog::getSaveFileName(this, "Сохранить файл", "", "BIN файлы (*.bin)");
+    QString fileName = QFileDialog::getSaveFileName(this, "Сохранить файл", "", "BIN файлы (*.bin);;Сжатые файлы сетки (*.wcp)");
 
     if (!fileName.isEmpty()) {
-        QFile file(fileName);
+        string name = QFile::encodeName(fileName).toStdString();
+        bool saved = fileName.endsWith(".wcp", Qt::CaseInsensitive) ? writePackedGridFile(name, gridModel->heightView())
+                                                                      : writeGridFile(name, gridModel->heightView());
+        if (!saved)
+            QMessageBox::warning(this, "Ошибка", "Не удалось сохранить файл.");
+    }
+}
 
-        if (file.open(QIODevice::WriteOnly)) {
-            QDataStream out(&file);
-            out << rowsInput->text().toInt();
-            out << colsInput->text().toInt();
+/**
+ * @brief Обработчик нажатия на кнопку "Загрузить".
+ * Файл сетки отображается в память и читается без разбора, сжатый файл сетки распаковывается
+ * блоками на всех ядрах прямо в буфер высот; файлы старого формата (QDataStream без заголовка)
+ * читаются как раньше.
+ */
+void MainWindow::handleLoadButtonClicked() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Загрузить файл", "", "Файлы сетки (*.bin *.wcp)");
 
-            for (int i = 0; i < rowsInput->text().toInt(); ++i) {
-                for (int j = 0; j < colsInput->text().toInt(); ++j) {
-                    QGraphicsTextItem *textItem = qgraphicsitem_cast<QGraphicsTextItem*>(graphicsScene->itemAt(j * 50 + 15, i * 50 + 15, QTransform()));
-                    QString text = textItem->toPlainText();
-                    out << text.toInt();
-                }
-            }
+    if (fileName.isEmpty())
+        return;
 
-            file.close();
+    int rows, cols;
+    vector<int> heights;
+    MappedGrid mapped;
+    PackedGrid packed;
+    if (packed.open(QFile::encodeName(fileName).toStdString())) {
+        if (!packed.fitsInt()) {
+            QMessageBox::warning(this, "Ошибка", "Высоты в файле 64-битные, приложение работает с 32-битными.");
+            return;
+        }
+        rows = packed.rows();
+        cols = packed.cols();
+        heights.resize((size_t)rows * cols);
+        if (!packed.decode(heights.data())) {
+            QMessageBox::warning(this, "Ошибка", "Сжатый файл сетки поврежден.");
+            return;
+        }
+    } else if (mapped.open(QFile::encodeName(fileName).toStdString())) {
+        GridView view = mapped.view();
+        if (!view.fitsInt()) {
+            QMessageBox::warning(this, "Ошибка", "Высоты в файле 64-битные, приложение работает с 32-битными.");
+            return;
+        }
+        rows = view.rows;
+        cols = view.cols;
+        heights.resize((size_t)rows * cols);
+        for (int i = 0; i < rows; ++i) {
+            for (int j = 0; j < cols; ++j)
+                heights[(size_t)i * cols + j] = view.at(i, j);
+        }
+    } else {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            QMessageBox::warning(this, "Ошибка", "Не удалось открыть файл.");
+            return;
         }
+        QDataStream in(&file);
+        in >> rows;
+        in >> cols;
+        if (in.status() != QDataStream::Ok || rows <= 0 || cols <= 0) {
+            QMessageBox::warning(this, "Ошибка", "Неизвестный формат файла.");
+            return;
+        }
+        heights.resize((size_t)rows * cols);
+        for (int &value : heights)
+            in >> value;
+        file.close();
     }
+
+    rowsInput->setText(QString::number(rows));
+    colsInput->setText(QString::number(cols));
+
+    showGrid(rows, cols, move(heights));
+
+    solveButton->setEnabled(true);
 }
 
-void MainWindow::handleLoadButtonClicked() {
-    QString fileName = QFileDialog::getOpenFileName(this, "Загрузить файл", "", "BIN файлы (*.bin)");
+/**
+ * @brief Обработчик хода вычислений в фоновом потоке.
+ * @param generation Номер поколения расчета.
+ * @param done Количество пройденных клеток.
+ * @param total Сколько клеток нужно пройти всего.
+ */
+void MainWindow::handleCalculationProgress(quint64 generation, qint64 done, qint64 total) {
+    if (generation != pendingGeneration || total <= 0)
+        return;
+    solveProgress->setValue((int)(done * solveProgress->maximum() / total));
+}
 
-    if (!fileName.isEmpty()) {
-        QFile file(fileName);
+/**
+ * @brief Обработчик готовых блоков решения: модель применяет их постепенно, не задерживая интерфейс.
+ * @param generation Номер поколения расчета.
+ * @param regions Блоки с окончательными уровнями воды.
+ */
+void MainWindow::handleRegionsSolved(quint64 generation, const vector<GridRegion>& regions) {
+    if (generation == pendingGeneration)
+        gridModel->queueLevels(regions);
+}
 
-        if (file.open(QIODevice::ReadOnly)) {
-            QDataStream in(&file);
-            int rows, cols;
-            in >> rows;
-            in >> cols;
-
-            rowsInput->setText(QString::number(rows));
-            colsInput->setText(QString::number(cols));
-
-            graphicsScene->clear();
-
-            for (int i = 0; i < rows; ++i) {
-                for (int j = 0; j < cols; ++j) {
-                    int value;
-                    in >> value;
-
-                    QGraphicsRectItem *matrixItem = new QGraphicsRectItem;
-                    QBrush greenBrush(Qt::green);
-                    matrixItem->setRect(j * 50, i * 50, 50, 50);
-                    matrixItem->setBrush(greenBrush);
-                    matrixItem->setAcceptHoverEvents(true);
-                    matrixItem->setData(0, "");
-                    graphicsScene->addItem(matrixItem);
-
-                    QGraphicsTextItem *textItem = new QGraphicsTextItem;
-                    textItem->setPlainText(QString::number(value));
-                    textItem->setPos(j * 50 + 15, i * 50 + 15);
-                    textItem->setTextWidth(25);
-                    textItem->setTextInteractionFlags(Qt::TextEditorInteraction);
-                    graphicsScene->addItem(textItem);
-                }
-            }
-
-            file.close();
-        }
-    }
+/**
+ * @brief Обработчик применения правок к прошлому решению: перерисовываются только затронутые клетки.
+ * Клетки, измененные после отправки правок, остаются показанными с новой высотой.
+ * @param generation Номер поколения запроса.
+ * @param result Новый объем воды.
+ * @param changes Клетки с новыми уровнями воды.
+ */
+void MainWindow::handleEditsApplied(quint64 generation, ll result, const vector<CellChange>& changes) {
+    Q_UNUSED(generation);
+    gridModel->setLevels(changes);
+    for (const CellEdit& edit : pendingEdits)
+        gridModel->setHeight(edit.row, edit.col, edit.height);
+    resultLineEdit->setText(QString::number(result));
 }
 
 /**
- * @brief Обработчик завершения вычислений в рабочем потоке.
- * Обновляет текст в элементах QGraphicsTextItem на основе значений из рабочей матрицы.
+ * @brief Обработчик завершения вычислений в фоновом потоке.
+ * Все блоки решения уже пришли в модель через handleRegionsSolved(), поэтому рабочая матрица
+ * принимается без общей перерисовки. Решение запоминается для последующих правок.
+ * @param generation Номер поколения расчета.
  * @param result Результат вычислений.
- * @param workingMatrix Рабочая матрица с промежуточными значениями.
+ * @param heights Матрица высот, для которой выполнены вычисления.
+ * @param workingMatrix Рабочая матрица с уровнями воды.
  */
-void MainWindow::handleCalculationComplete(ll result, const vector<vector<int>>& workingMatrix) {
-    // Обновляем текст в элементах QGraphicsTextItem на основе значений из рабочей матрицы
-    int rows = workingMatrix.size();
-    int cols = workingMatrix[0].size();
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            QGraphicsTextItem *textItem = qgraphicsitem_cast<QGraphicsTextItem*>(graphicsScene->itemAt(j * 50 + 15, i * 50 + 15, QTransform()));
-            QString newText = QString::number(workingMatrix[i][j]);
-            QString oldText = textItem->toPlainText();
-
-            if (oldText != newText) {
-                QString displayText = newText;
-                textItem->setPlainText(displayText);
-
-                // Окрасить клетку в синий
-                QBrush blueBrush(Qt::blue);
-                QGraphicsRectItem *matrixItem = qgraphicsitem_cast<QGraphicsRectItem*>(graphicsScene->itemAt(j * 50, i * 50, QTransform()));
-                matrixItem->setBrush(blueBrush);
-            } else {
-                // Окрасить клетку в зеленый
-                QBrush greenBrush(Qt::green);
-                QGraphicsRectItem *matrixItem = qgraphicsitem_cast<QGraphicsRectItem*>(graphicsScene->itemAt(j * 50, i * 50, QTransform()));
-                matrixItem->setBrush(greenBrush);
-            }
-        }
-    }
+void MainWindow::handleCalculationComplete(quint64 generation, ll result, SharedGrid heights, SharedGrid workingMatrix) {
+    // Результат устаревшего расчета (после него уже запущен новый) не показываем
+    if (generation != pendingGeneration)
+        return;
+    pendingGeneration = 0;
+    solveProgress->hide();
+
+    // Клетки, измененные во время расчета, остаются показанными с новой высотой
+    gridModel->adoptLevels(workingMatrix);
+    for (const CellEdit& edit : pendingEdits)
+        gridModel->setHeight(edit.row, edit.col, edit.height);
 
     // Установить результат в LineEdit
     resultLineEdit->setText(QString::number(result));
+
+    // Счетчики решения (в сборке с WATERCUBOIDS_STATS) показываются в подсказке к результату
+    if (SolverStats::enabled())
+        resultLineEdit->setToolTip(QString::fromStdString(statsToJson(solverScheduler->stats(), "parallel")));
+
+    // Решатель для правок меняет высоты и уровни на месте, поэтому получает собственные копии
+    incremental.reset(new IncrementalWaterVolumeSolver(heights->rows(), heights->cols(), heights->values(), workingMatrix->values(), result));
 }
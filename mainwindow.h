@@ -2,11 +2,19 @@
 #define MAINWINDOW_H
 
 #include "watervolumesolver.h"
+#include "incrementalwatervolumesolver.h"
+#include "heightgrid.h"
+#include "griditem.h"
+#include "solverscheduler.h"
+#include "terraingenerator.h"
 #include <QWidget>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QLineEdit>
+#include <QProgressBar>
+#include <QComboBox>
+#include <QThreadPool>
 #include <QPushButton>
 #include <QScrollArea>
 #include <QGridLayout>
@@ -25,6 +33,9 @@
 #include <QFileDialog>
 #include <QFile>
 #include <QDataStream>
+#include <QInputDialog>
+#include <QStandardPaths>
+#include <memory>
 
 using namespace std;
 
@@ -48,13 +59,26 @@ private slots:
     void handleInputButtonClicked();
     void handleRandomButtonClicked();
 
+    /**
+     * @brief Показывает сгенерированный рельеф, если после запуска генерации не появилась другая матрица.
+     * @param generation Номер запуска генерации.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param heights Высоты построчно.
+     */
+    void handleTerrainGenerated(quint64 generation, int rows, int cols, shared_ptr<vector<int>> heights);
+
     /**
      * @brief Обработчик события нажатия кнопки решения.
      */
     void handleSolveButtonClicked();
-    void handleCalculationComplete(ll result, const vector<vector<int>>& workingMatrix);
+    void handleCalculationComplete(quint64 generation, ll result, SharedGrid heights, SharedGrid workingMatrix);
+    void handleCalculationProgress(quint64 generation, qint64 done, qint64 total);
+    void handleRegionsSolved(quint64 generation, const vector<GridRegion>& regions);
+    void handleEditsApplied(quint64 generation, ll result, const vector<CellChange>& changes);
     void handleSaveButtonClicked();
     void handleLoadButtonClicked();
+    void handleCellDoubleClicked(int row, int col);
 
 protected:
     /**
@@ -85,12 +109,21 @@ private:
     void createResultWidgets();
 
     /**
-     * @brief Создает элементы матрицы и размещает их на сцене.
+     * @brief Создает пустую матрицу и показывает ее на сцене.
      * @param rows Количество строк в матрице.
      * @param cols Количество столбцов в матрице.
-     * @param randomFill Флаг, указывающий, нужно ли заполнить матрицу случайными значениями.
      */
-    void createMatrixItems(int rows, int cols, bool randomFill = false);
+    void createMatrixItems(int rows, int cols);
+
+    /**
+     * @brief Показывает новую матрицу высот и сбрасывает прошлое решение.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param heights Высоты построчно.
+     */
+    void showGrid(int rows, int cols, vector<int> heights);
+
+    static const int incrementalEditLimit = 64; /**< Наибольшее количество правок, которые применяются без полного решения. */
 
     QVBoxLayout *mainLayout; /**< Основной вертикальный макет окна. */
     QHBoxLayout *inputLayout; /**< Горизонтальный макет для ввода размеров матрицы. */
@@ -100,17 +133,26 @@ private:
     QLineEdit *colsInput; /**< Поле ввода для количества столбцов. */
     QPushButton *inputButton; /**< Кнопка для ручного ввода матрицы. */
     QPushButton *randomButton; /**< Кнопка для рандомного ввода матрицы. */
+    QComboBox *terrainInput; /**< Вид рельефа для кнопки "Рандом". */
     QPushButton *solveButton; /**< Кнопка для решения задачи. */
     QPushButton *saveButton;
     QPushButton *loadButton;
     QLabel *resultLabel; /**< Метка для отображения текста "Результат". */
     QLineEdit *resultLineEdit; /**< Поле для отображения результата. */
+    QProgressBar *solveProgress; /**< Ход текущего расчета (виден, пока расчет идет). */
     QWidget *matrixWidget; /**< Виджет для отображения матрицы. */
     QScrollArea *scrollArea; /**< Область прокрутки для матрицы. */
     QGridLayout *matrixLayout; /**< Макет для размещения элементов матрицы. */
     QGraphicsScene *graphicsScene; /**< Графическая сцена для отображения матрицы. */
     QGraphicsView *graphicsView; /**< Представление для графической сцены. */
-    vector<QGraphicsTextItem*> textItems; /**< Вектор элементов для хранения текстовых элементов матрицы. */
+    GridModel *gridModel; /**< Матрица высот и уровни воды. */
+    GridItem *gridItem; /**< Элемент сцены, рисующий модель. */
+    vector<CellEdit> pendingEdits; /**< Клетки, измененные после последнего решения. */
+    shared_ptr<IncrementalWaterVolumeSolver> incremental; /**< Последнее решение; после правки клеток обновляется в фоновом потоке без полного решения. */
+    SolverScheduler *solverScheduler; /**< Планировщик расчетов в фоновом потоке. */
+    quint64 pendingGeneration = 0; /**< Номер поколения последнего запущенного расчета (0 - расчет не идет). */
+    QThreadPool terrainPool; /**< Пул для генерации рельефа; при закрытии окна дожидается ее окончания. */
+    quint64 terrainGeneration = 0; /**< Номер последнего запуска генерации; растет и при показе любой новой матрицы. */
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,89 @@
+#include "memorytests.h"
+#include "watervolumesolver.h"
+#include "streamingwatervolumesolver.h"
+#include "gridfile.h"
+#include "terraingenerator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Возвращает поле /proc/self/status в килобайтах (-1, если поля нет).
+ * @param name Имя поля с двоеточием, например "VmHWM:".
+ */
+long statusKilobytes(const char* name) {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, strlen(name), name) == 0)
+            return atol(line.c_str() + strlen(name));
+    }
+    return -1;
+}
+
+/**
+ * @brief Сбрасывает пик резидентной памяти процесса до текущего значения.
+ * @return false, если система не умеет сбрасывать пик.
+ */
+bool resetPeakMemory() {
+#ifdef __linux__
+    ofstream clearRefs("/proc/self/clear_refs");
+    return (bool)(clearRefs << "5" << flush);
+#else
+    return false;
+#endif
+}
+
+}
+
+/**
+ * @brief Проверяет, что потоковый решатель укладывается в заданный предел памяти.
+ * @param out Поток для отчета.
+ * @return Количество непройденных проверок.
+ */
+int memoryTests(ostream& out) {
+    const int rows = 3000, cols = 3000;
+    string directory = (filesystem::temp_directory_path() / "watercuboids-memorytests").string();
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    string name = directory + "/terrain.wcg";
+
+    // Эталон и файл готовятся до замеров; их память возвращается системе
+    ll expected;
+    {
+        vector<int> heights((size_t)rows * cols);
+        generateTerrain(TerrainKind::Fractal, rows, cols, 8, heights.data(), 1);
+        GridView view(rows, cols, heights);
+        if (!writeGridFile(name, view)) {
+            out << "Не удалось записать файл сетки: " << name << endl;
+            filesystem::remove_all(directory);
+            return 1;
+        }
+        WaterVolumeSolver solver(view);
+        solver.setEngine(SolverEngine::PriorityFloodPlus);
+        expected = solver.solve();
+    }
+
+    // Прежний потоковый решатель держал граф переливов в памяти и на этой сетке занимал 11 МБ
+    const size_t megabytes = 8;
+    bool measured = resetPeakMemory();
+    long before = statusKilobytes("VmRSS:");
+    StreamingWaterVolumeSolver solver(name, "", megabytes << 20);
+    ll volume = solver.solve();
+    long peak = measured ? statusKilobytes("VmHWM:") - before : -1;
+    bool passed = volume == expected && (!measured || (peak >= 0 && (size_t)peak <= megabytes << 10));
+    out << "Потоковый решатель, предел " << megabytes << " МБ, блок " << solver.tileSize() << ": ";
+    if (measured)
+        out << "пик " << peak << " КБ";
+    else
+        out << "пик памяти не измерялся";
+    out << (passed ? ", пройдено" : ", не пройдено") << endl;
+    filesystem::remove_all(directory);
+    return passed ? 0 : 1;
+}
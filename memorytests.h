@@ -0,0 +1,19 @@
+#ifndef MEMORYTESTS_H
+#define MEMORYTESTS_H
+
+#include <ostream>
+using namespace std;
+
+/**
+ * @brief Проверяет, что потоковый решатель укладывается в заданный предел памяти.
+ * Рельеф 3000x3000 записывается в файл сетки и решается с пределом 8 МБ; пик резидентной
+ * памяти процесса сбрасывается перед решением через /proc/self/clear_refs и читается из
+ * /proc/self/status (VmHWM). Проверку нужно запускать в отдельном процессе, до других тестов:
+ * память, освобожденная ими, может повторно использоваться и занижать пик. Вне Linux
+ * проверяется только объем воды.
+ * @param out Поток для отчета.
+ * @return Количество непройденных проверок.
+ */
+int memoryTests(ostream& out);
+
+#endif // MEMORYTESTS_H
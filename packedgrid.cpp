@@ -0,0 +1,352 @@
+#include "packedgrid.h"
+#include "gridfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <type_traits>
+
+static const char packedGridMagic[8] = {'W', 'C', 'P', 'A', 'C', 'K', 0, 0};
+static const size_t packedGridChunkCells = 1 << 16; /**< Размер блока по умолчанию в клетках. */
+
+/**
+ * @brief Проверяет, начинаются ли данные с сигнатуры сжатого файла сетки.
+ * @param data Начало файла.
+ * @param size Количество доступных байт.
+ */
+bool isPackedGridFile(const void* data, size_t size) {
+    return size >= sizeof(packedGridMagic) && memcmp(data, packedGridMagic, sizeof(packedGridMagic)) == 0;
+}
+
+/**
+ * @brief Читает 8 байт little-endian с любого адреса.
+ */
+static inline uint64_t load64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+/**
+ * @brief Сжимает строки [firstRow, lastRow) матрицы в один блок.
+ * @param view Матрица высот.
+ * @param firstRow Первая строка блока.
+ * @param lastRow Строка после последней строки блока.
+ * @param out Сжатый блок.
+ */
+static void packChunk(const GridView& view, int firstRow, int lastRow, vector<uint8_t>& out) {
+    size_t cols = view.cols;
+    vector<uint64_t> deltas((size_t)(lastRow - firstRow) * cols);
+    vector<int64_t> above(cols), current(cols);
+    for (int i = firstRow; i < lastRow; i++) {
+        for (size_t j = 0; j < cols; j++)
+            current[j] = view.at64(i, (int)j);
+        uint64_t* row = &deltas[(size_t)(i - firstRow) * cols];
+        for (size_t j = 0; j < cols; j++) {
+            int64_t predicted = i > firstRow ? above[j] : (j ? current[j - 1] : 0);
+            uint64_t delta = (uint64_t)current[j] - (uint64_t)predicted;
+            row[j] = (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+        }
+        swap(above, current);
+    }
+
+    out.clear();
+    out.reserve(deltas.size() / 2 + 16);
+    for (size_t group = 0; group < deltas.size(); group += packGroup) {
+        size_t count = min((size_t)packGroup, deltas.size() - group);
+        uint64_t bits = 0;
+        for (size_t k = 0; k < count; k++)
+            bits |= deltas[group + k];
+        int width = 0;
+        while (width < 64 && (bits >> width))
+            width++;
+        out.push_back((uint8_t)width);
+        if (width == 0)
+            continue;
+
+        // Значения шире 32 бит пишутся двумя половинами, чтобы накопитель не переполнялся
+        uint64_t accumulator = 0;
+        int filled = 0;
+        auto put = [&](uint64_t value, int length) {
+            accumulator |= value << filled;
+            filled += length;
+            while (filled >= 8) {
+                out.push_back((uint8_t)accumulator);
+                accumulator >>= 8;
+                filled -= 8;
+            }
+        };
+        for (size_t k = 0; k < count; k++) {
+            uint64_t value = deltas[group + k];
+            if (width <= 32) {
+                put(value, width);
+            } else {
+                put(value & 0xffffffffu, 32);
+                put(value >> 32, width - 32);
+            }
+        }
+        if (filled > 0)
+            out.push_back((uint8_t)accumulator);
+    }
+}
+
+/**
+ * @brief Записывает матрицу в сжатый файл сетки; блоки сжимаются параллельно.
+ * @param fileName Имя файла.
+ * @param view Матрица высот любой ширины.
+ * @param chunkRows Количество строк в блоке (0 - около 64 тыс. клеток на блок).
+ * @param threads Количество потоков (0 - по числу ядер).
+ * @return true, если файл записан, иначе false.
+ */
+bool writePackedGridFile(const string& fileName, const GridView& view, int chunkRows, int threads) {
+    if (view.rows <= 0 || view.cols <= 0)
+        return false;
+    if (chunkRows <= 0)
+        chunkRows = (int)max((size_t)1, packedGridChunkCells / view.cols);
+    chunkRows = min(chunkRows, view.rows);
+    int chunkCount = (view.rows + chunkRows - 1) / chunkRows;
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    int workers = min(threads, chunkCount);
+
+    vector<vector<uint8_t>> chunks(chunkCount);
+    atomic<int> next(0);
+    auto work = [&]() {
+        for (int chunk = next++; chunk < chunkCount; chunk = next++)
+            packChunk(view, chunk * chunkRows, min(view.rows, (chunk + 1) * chunkRows), chunks[chunk]);
+    };
+    vector<thread> pool;
+    for (int w = 1; w < workers; w++)
+        pool.emplace_back(work);
+    work();
+    for (thread& worker : pool)
+        worker.join();
+
+    PackedGridHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, packedGridMagic, sizeof(packedGridMagic));
+    header.version = packedGridVersion;
+    header.elementWidth = minimalElementWidth(view);
+    header.rows = view.rows;
+    header.cols = view.cols;
+    header.chunkRows = chunkRows;
+    header.chunkCount = chunkCount;
+    header.indexOffset = sizeof(header);
+
+    vector<uint64_t> index(chunkCount + 1);
+    index[0] = header.indexOffset + index.size() * sizeof(uint64_t);
+    for (int chunk = 0; chunk < chunkCount; chunk++)
+        index[chunk + 1] = index[chunk] + chunks[chunk].size();
+
+    ofstream file(fileName, ios::binary | ios::trunc);
+    if (!file)
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint64_t));
+    for (const vector<uint8_t>& chunk : chunks)
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    return (bool)file;
+}
+
+/**
+ * @brief Читает и проверяет сжатый файл сетки.
+ * @param fileName Имя файла.
+ * @return true, если файл прочитан, заголовок и оглавление корректны, иначе false.
+ */
+bool PackedGrid::open(const string& fileName) {
+    bytes.clear();
+    ifstream file(fileName, ios::binary | ios::ate);
+    if (!file)
+        return false;
+    streamoff size = file.tellg();
+    if (size < (streamoff)sizeof(PackedGridHeader))
+        return false;
+    PackedGridHeader header;
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !isPackedGridFile(&header, sizeof(header)))
+        return false;
+    if (header.version != packedGridVersion || header.rows == 0 || header.rows > INT_MAX || header.cols == 0
+            || header.cols > INT_MAX || header.chunkRows == 0 || header.chunkRows > header.rows || header.indexOffset < sizeof(header)
+            || (header.elementWidth != 1 && header.elementWidth != 2 && header.elementWidth != 4 && header.elementWidth != 8)
+            || header.chunkCount != (header.rows + header.chunkRows - 1) / header.chunkRows)
+        return false;
+    uint64_t indexEnd = header.indexOffset + ((uint64_t)header.chunkCount + 1) * sizeof(uint64_t);
+    if (header.indexOffset > (uint64_t)size || indexEnd > (uint64_t)size)
+        return false;
+
+    vector<uint8_t> content((size_t)size + 8, 0);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(content.data()), size))
+        return false;
+    // Блоки должны идти по порядку за оглавлением и не выходить за конец файла. Каждая группа
+    // занимает хотя бы байт ширины, поэтому блок короче числа своих групп поврежден: так размеры
+    // из заголовка не заставят читателя выделить буфер, которого файл не может заполнить
+    uint64_t previous = load64(&content[header.indexOffset]);
+    if (previous < indexEnd || previous > (uint64_t)size)
+        return false;
+    for (uint64_t chunk = 0; chunk < header.chunkCount; chunk++) {
+        uint64_t offset = load64(&content[header.indexOffset + (chunk + 1) * sizeof(uint64_t)]);
+        uint64_t chunkCells = min((uint64_t)header.chunkRows, header.rows - chunk * header.chunkRows) * header.cols;
+        if (offset < previous || offset > (uint64_t)size || offset - previous < (chunkCells + packGroup - 1) / packGroup)
+            return false;
+        previous = offset;
+    }
+    bytes = move(content);
+    return true;
+}
+
+/**
+ * @brief Распаковывает строки одного блока.
+ * Сначала на место высот пишутся разности, затем их накопление по строке (первая строка)
+ * или со строкой сверху; сложение идет по модулю ширины T, поэтому 64-битные разности
+ * дают верные высоты и в int.
+ * @tparam T Тип высоты в буфере.
+ * @param chunk Номер блока.
+ * @param out Буфер строк блока.
+ * @return false, если блок поврежден.
+ */
+template <class T>
+bool PackedGrid::decodeRows(int chunk, T* out) const {
+    typedef typename make_unsigned<T>::type U;
+    const PackedGridHeader& header = this->header();
+    if (chunk < 0 || chunk >= (int)header.chunkCount)
+        return false;
+    size_t cols = header.cols;
+    size_t firstRow = (size_t)chunk * header.chunkRows;
+    size_t rowCount = min((size_t)header.chunkRows, (size_t)header.rows - firstRow);
+    size_t count = rowCount * cols;
+    const uint8_t* index = &bytes[header.indexOffset];
+    const uint8_t* p = bytes.data() + load64(index + (size_t)chunk * sizeof(uint64_t));
+    const uint8_t* end = bytes.data() + load64(index + ((size_t)chunk + 1) * sizeof(uint64_t));
+
+    for (size_t group = 0; group < count; group += packGroup) {
+        size_t length = min((size_t)packGroup, count - group);
+        if (p >= end || *p > 64)
+            return false;
+        int width = *p++;
+        size_t size = (length * width + 7) / 8;
+        if ((size_t)(end - p) < size)
+            return false;
+        T* values = out + group;
+        if (width == 0) {
+            fill(values, values + length, (T)0);
+        } else if (width <= 57) {
+            // Значение с любым сдвигом внутри байта помещается в одно чтение 8 байт
+            uint64_t mask = ((uint64_t)1 << width) - 1;
+            for (size_t k = 0, bit = 0; k < length; k++, bit += width) {
+                uint64_t value = (load64(p + (bit >> 3)) >> (bit & 7)) & mask;
+                values[k] = (T)((value >> 1) ^ (0 - (value & 1)));
+            }
+        } else {
+            uint64_t highMask = width == 64 ? 0xffffffffu : ((uint64_t)1 << (width - 32)) - 1;
+            for (size_t k = 0, bit = 0; k < length; k++, bit += width) {
+                uint64_t low = (load64(p + (bit >> 3)) >> (bit & 7)) & 0xffffffffu;
+                size_t high = bit + 32;
+                uint64_t value = low | (((load64(p + (high >> 3)) >> (high & 7)) & highMask) << 32);
+                values[k] = (T)((value >> 1) ^ (0 - (value & 1)));
+            }
+        }
+        p += size;
+    }
+    if (p != end)
+        return false;
+
+    for (size_t j = 1; j < cols; j++)
+        out[j] = (T)((U)out[j] + (U)out[j - 1]);
+    for (size_t i = 1; i < rowCount; i++) {
+        T* row = out + i * cols;
+        const T* above = row - cols;
+        for (size_t j = 0; j < cols; j++)
+            row[j] = (T)((U)row[j] + (U)above[j]);
+    }
+    return true;
+}
+
+/**
+ * @brief Распаковывает все блоки; потоки берут блоки по одному из общего счетчика.
+ */
+template <class T>
+bool PackedGrid::decodeAll(T* heights, int threads) const {
+    int chunkCount = this->chunkCount();
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    int workers = min(threads, chunkCount);
+    size_t chunkCells = (size_t)header().chunkRows * header().cols;
+    atomic<int> next(0);
+    atomic<bool> ok(true);
+    auto work = [&]() {
+        for (int chunk = next++; chunk < chunkCount && ok; chunk = next++) {
+            if (!decodeRows(chunk, heights + chunk * chunkCells))
+                ok = false;
+        }
+    };
+    vector<thread> pool;
+    for (int w = 1; w < workers; w++)
+        pool.emplace_back(work);
+    work();
+    for (thread& worker : pool)
+        worker.join();
+    return ok;
+}
+
+/**
+ * @brief Распаковывает всю матрицу.
+ * @param heights Буфер не меньше rows() * cols() высот, строки подряд.
+ * @param threads Количество потоков (0 - по числу ядер).
+ * @return false, если высоты не помещаются в int или блок поврежден.
+ */
+bool PackedGrid::decode(int* heights, int threads) const {
+    return isOpen() && fitsInt() && decodeAll(heights, threads);
+}
+
+bool PackedGrid::decode(int64_t* heights, int threads) const {
+    return isOpen() && decodeAll(heights, threads);
+}
+
+/**
+ * @brief Распаковывает матрицу в буфер подходящей ширины и возвращает представление поверх него.
+ * @param heights Буфер для высот, помещающихся в int.
+ * @param wideHeights Буфер для 64-битных высот.
+ * @param view Представление распакованной матрицы.
+ * @param threads Количество потоков (0 - по числу ядер).
+ * @return false, если блок поврежден.
+ */
+bool PackedGrid::decode(vector<int>& heights, vector<int64_t>& wideHeights, GridView& view, int threads) const {
+    if (!isOpen())
+        return false;
+    size_t cells = (size_t)rows() * cols();
+    if (fitsInt()) {
+        heights.resize(cells);
+        if (!decodeAll(heights.data(), threads))
+            return false;
+        view = GridView(rows(), cols(), heights);
+        return true;
+    }
+    wideHeights.resize(cells);
+    if (!decodeAll(wideHeights.data(), threads))
+        return false;
+    view = GridView();
+    view.rows = rows();
+    view.cols = cols();
+    view.elementWidth = 8;
+    view.rowStride = cols();
+    view.data = wideHeights.data();
+    return true;
+}
+
+/**
+ * @brief Распаковывает один блок.
+ * @param chunk Номер блока.
+ * @param heights Буфер строк блока, не меньше chunkRows() * cols() высот: первая строка блока пишется в начало.
+ * @return false, если высоты не помещаются в int или блок поврежден.
+ */
+bool PackedGrid::decodeChunk(int chunk, int* heights) const {
+    return isOpen() && fitsInt() && decodeRows(chunk, heights);
+}
+
+bool PackedGrid::decodeChunk(int chunk, int64_t* heights) const {
+    return isOpen() && decodeRows(chunk, heights);
+}
@@ -0,0 +1,120 @@
+#ifndef PACKEDGRID_H
+#define PACKEDGRID_H
+
+#include "gridview.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Заголовок сжатого файла сетки (64 байта, little-endian).
+ * Матрица разбита на блоки по chunkRows строк. За заголовком лежит оглавление из chunkCount + 1
+ * смещений от начала файла (начало каждого блока и конец последнего), за ним - блоки. Блоки
+ * не зависят друг от друга и распаковываются параллельно.
+ *
+ * Высоты блока заменяются разностями: в первой строке - с левым соседом (первая - с нулем),
+ * в остальных - с клеткой сверху. Разности переводятся в беззнаковые (zigzag) и упаковываются
+ * группами по packGroup значений: байт ширины b, затем значения по b бит подряд. Группа
+ * одинаковых строк или плато занимает один байт (b = 0).
+ */
+struct PackedGridHeader {
+    char magic[8]; /**< Сигнатура "WCPACK\0\0". */
+    uint32_t version; /**< Версия формата. */
+    uint32_t elementWidth; /**< Наименьшая ширина, в которую помещаются высоты (1, 2, 4 или 8 байт). */
+    uint64_t rows; /**< Количество строк в матрице. */
+    uint64_t cols; /**< Количество столбцов в матрице. */
+    uint32_t chunkRows; /**< Количество строк в блоке (в последнем может быть меньше). */
+    uint32_t chunkCount; /**< Количество блоков. */
+    uint64_t indexOffset; /**< Смещение оглавления от начала файла. */
+    uint8_t reserved[16]; /**< Зарезервировано, нули. */
+};
+
+static_assert(sizeof(PackedGridHeader) == 64, "PackedGridHeader must be 64 bytes");
+
+const uint32_t packedGridVersion = 1; /**< Текущая версия формата. */
+const int packGroup = 128; /**< Количество разностей в группе с общей шириной. */
+
+/**
+ * @brief Проверяет, начинаются ли данные с сигнатуры сжатого файла сетки.
+ * @param data Начало файла.
+ * @param size Количество доступных байт.
+ */
+bool isPackedGridFile(const void* data, size_t size);
+
+/**
+ * @brief Записывает матрицу в сжатый файл сетки; блоки сжимаются параллельно.
+ * @param fileName Имя файла.
+ * @param view Матрица высот любой ширины.
+ * @param chunkRows Количество строк в блоке (0 - около 64 тыс. клеток на блок).
+ * @param threads Количество потоков (0 - по числу ядер).
+ * @return true, если файл записан, иначе false.
+ */
+bool writePackedGridFile(const string& fileName, const GridView& view, int chunkRows = 0, int threads = 0);
+
+/**
+ * @brief Класс PackedGrid читает сжатый файл сетки и распаковывает его прямо в буфер высот.
+ * Файл читается в память целиком (он в несколько раз меньше матрицы), распаковка идет по
+ * блокам: всей матрицы в несколько потоков через decode() или блок за блоком через decodeChunk()
+ * в буфер одного блока.
+ */
+class PackedGrid {
+public:
+    /**
+     * @brief Читает и проверяет сжатый файл сетки.
+     * @param fileName Имя файла.
+     * @return true, если файл прочитан, заголовок и оглавление корректны, иначе false.
+     */
+    bool open(const string& fileName);
+
+    bool isOpen() const { return !bytes.empty(); }
+    const PackedGridHeader& header() const { return *reinterpret_cast<const PackedGridHeader*>(bytes.data()); }
+    int rows() const { return (int)header().rows; }
+    int cols() const { return (int)header().cols; }
+    int chunkCount() const { return (int)header().chunkCount; }
+    int chunkRows() const { return (int)header().chunkRows; }
+
+    /**
+     * @brief Проверяет, помещаются ли высоты в int.
+     */
+    bool fitsInt() const { return header().elementWidth <= 4; }
+
+    /**
+     * @brief Распаковывает всю матрицу.
+     * @param heights Буфер не меньше rows() * cols() высот, строки подряд.
+     * @param threads Количество потоков (0 - по числу ядер).
+     * @return false, если высоты не помещаются в int или блок поврежден.
+     */
+    bool decode(int* heights, int threads = 0) const;
+    bool decode(int64_t* heights, int threads = 0) const;
+
+    /**
+     * @brief Распаковывает матрицу в буфер подходящей ширины и возвращает представление поверх него.
+     * @param heights Буфер для высот, помещающихся в int.
+     * @param wideHeights Буфер для 64-битных высот.
+     * @param view Представление распакованной матрицы.
+     * @param threads Количество потоков (0 - по числу ядер).
+     * @return false, если блок поврежден.
+     */
+    bool decode(vector<int>& heights, vector<int64_t>& wideHeights, GridView& view, int threads = 0) const;
+
+    /**
+     * @brief Распаковывает один блок.
+     * @param chunk Номер блока.
+     * @param heights Буфер строк блока, не меньше chunkRows() * cols() высот: первая строка блока пишется в начало.
+     * @return false, если высоты не помещаются в int или блок поврежден.
+     */
+    bool decodeChunk(int chunk, int* heights) const;
+    bool decodeChunk(int chunk, int64_t* heights) const;
+
+private:
+    vector<uint8_t> bytes; /**< Содержимое файла и 8 байт запаса для чтения по 8 байт. */
+
+    template <class T>
+    bool decodeAll(T* heights, int threads) const;
+
+    template <class T>
+    bool decodeRows(int chunk, T* out) const;
+};
+
+#endif // PACKEDGRID_H
@@ -0,0 +1,261 @@
+#include "parallelwatervolumesolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief Конструктор класса ParallelWaterVolumeSolver.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @param threads Количество рабочих потоков (0 - по числу ядер).
+ * @param tileSize Сторона блока.
+ */
+ParallelWaterVolumeSolver::ParallelWaterVolumeSolver(int rows, int cols, const vector<vector<int>>& matrix, int threads, int tileSize)
+    : rowsMatrix(rows), colsMatrix(cols), threadCount(threads), tileSize(max(tileSize, 2)), heights((size_t)rows * cols) {
+    SOLVER_STATS(StatsClock clock);
+    for (int i = 0; i < rowsMatrix; i++)
+        copy(matrix[i].begin(), matrix[i].begin() + colsMatrix, heights.begin() + (size_t)i * colsMatrix);
+    heightData = heights.data();
+    init();
+    SOLVER_STATS(statistics.setupSeconds = clock.seconds());
+}
+
+/**
+ * @brief Конструктор класса ParallelWaterVolumeSolver из непрерывного буфера высот.
+ * @param view Матрица с высотами столбцов.
+ * @param threads Количество рабочих потоков (0 - по числу ядер).
+ * @param tileSize Сторона блока.
+ */
+ParallelWaterVolumeSolver::ParallelWaterVolumeSolver(const GridView& view, int threads, int tileSize)
+    : rowsMatrix(view.rows), colsMatrix(view.cols), threadCount(threads), tileSize(max(tileSize, 2)) {
+    SOLVER_STATS(StatsClock clock);
+    if (view.elementWidth == 4 && view.rowStride == (size_t)view.cols) {
+        heightData = view.row<int32_t>(0);
+    } else {
+        heights.resize((size_t)rowsMatrix * colsMatrix);
+        for (int i = 0; i < rowsMatrix; i++) {
+            for (int j = 0; j < colsMatrix; j++)
+                heights[(size_t)i * colsMatrix + j] = view.at(i, j);
+        }
+        heightData = heights.data();
+    }
+    init();
+    SOLVER_STATS(statistics.setupSeconds = clock.seconds());
+}
+
+/**
+ * @brief Выделяет рабочие буферы и нумерует метки блоков.
+ */
+void ParallelWaterVolumeSolver::init() {
+    SOLVER_STATS(statistics.rows = rowsMatrix, statistics.cols = colsMatrix);
+    if (threadCount <= 0)
+        threadCount = max(1u, thread::hardware_concurrency());
+    levels.resize((size_t)rowsMatrix * colsMatrix);
+    labels.resize((size_t)rowsMatrix * colsMatrix);
+
+    tileRows = (rowsMatrix + this->tileSize - 1) / this->tileSize;
+    tileCols = (colsMatrix + this->tileSize - 1) / this->tileSize;
+    labelBase.assign(tileRows * tileCols + 1, 0);
+    for (int t = 0; t < tileRows * tileCols; t++) {
+        int th = min(this->tileSize, rowsMatrix - t / tileCols * this->tileSize);
+        int tw = min(this->tileSize, colsMatrix - t % tileCols * this->tileSize);
+        labelBase[t + 1] = labelBase[t] + tilePerimeter(th, tw);
+    }
+}
+
+/**
+ * @brief Выполняет функцию для каждого блока в пуле потоков.
+ * Потоки разбирают блоки по атомарному счетчику; при одном потоке или одном блоке работа идет в вызывающем потоке.
+ * @param body Функция, принимающая номер рабочего потока и номер блока.
+ */
+void ParallelWaterVolumeSolver::forEachTile(const function<void(int, int)>& body) {
+    int tiles = tileRows * tileCols;
+    int workers = min(threadCount, tiles);
+    if (workers <= 1) {
+        for (int t = 0; t < tiles; t++)
+            body(0, t);
+        return;
+    }
+    atomic<int> next(0);
+    vector<thread> pool;
+    for (int w = 0; w < workers; w++) {
+        pool.emplace_back([&, w]() {
+            for (int t = next++; t < tiles; t = next++)
+                body(w, t);
+        });
+    }
+    for (thread& worker : pool)
+        worker.join();
+}
+
+/**
+ * @brief Возвращает метку клетки периметра блока по глобальным координатам.
+ * @param row Строка клетки.
+ * @param col Столбец клетки.
+ */
+int ParallelWaterVolumeSolver::perimeterLabel(int row, int col) const {
+    int tr = row / tileSize;
+    int tc = col / tileSize;
+    int th = min(tileSize, rowsMatrix - tr * tileSize);
+    int tw = min(tileSize, colsMatrix - tc * tileSize);
+    return labelBase[tr * tileCols + tc] + tilePerimeterIndex(row - tr * tileSize, col - tc * tileSize, th, tw);
+}
+
+/**
+ * @brief Подключает состояние для отмены и прогресса.
+ * @param control Состояние решения (nullptr - отключить).
+ */
+void ParallelWaterVolumeSolver::setControl(SolveControl* control) {
+    this->control = control;
+}
+
+/**
+ * @brief Задает функцию, получающую окончательные уровни каждого блока.
+ * @param callback Функция, принимающая блок с уровнями воды (пустая - отключить).
+ */
+void ParallelWaterVolumeSolver::setRegionCallback(function<void(GridRegion&&)> callback) {
+    regionCallback = move(callback);
+}
+
+/**
+ * @brief Решает задачу о объеме воды.
+ * @return Объем воды, который можно собрать, или -1, если решение отменено.
+ */
+ll ParallelWaterVolumeSolver::solve() {
+    SOLVER_STATS(StatsClock clock);
+    int tiles = tileRows * tileCols;
+    int workers = min(threadCount, tiles);
+    vector<TileFlooder> flooders(max(workers, 1));
+    vector<vector<SpillEdge>> tileEdges(tiles);
+    if (control)
+        control->total.store(2 * (ll)rowsMatrix * colsMatrix, memory_order_relaxed);
+
+    // Независимо заполняем блоки и собираем ребра переливов, включая ребра к правому и нижнему блокам
+    forEachTile([&](int worker, int t) {
+        if (cancelled())
+            return;
+        int r0 = t / tileCols * tileSize;
+        int c0 = t % tileCols * tileSize;
+        int th = min(tileSize, rowsMatrix - r0);
+        int tw = min(tileSize, colsMatrix - c0);
+        size_t origin = (size_t)r0 * colsMatrix + c0;
+        flooders[worker].flood(heightData + origin, &levels[origin], &labels[origin], colsMatrix, th, tw, labelBase[t], tileEdges[t]);
+
+        // Клетки периметра - сами себе источники, поэтому их локальный уровень равен высоте
+        if (c0 + tw < colsMatrix) {
+            for (int i = r0; i < r0 + th; i++) {
+                int a = perimeterLabel(i, c0 + tw - 1);
+                int b = perimeterLabel(i, c0 + tw);
+                int level = max(heightData[(size_t)i * colsMatrix + c0 + tw - 1], heightData[(size_t)i * colsMatrix + c0 + tw]);
+                tileEdges[t].push_back(SpillEdge{min(a, b), max(a, b), level});
+            }
+        }
+        if (r0 + th < rowsMatrix) {
+            for (int j = c0; j < c0 + tw; j++) {
+                int a = perimeterLabel(r0 + th - 1, j);
+                int b = perimeterLabel(r0 + th, j);
+                int level = max(heightData[(size_t)(r0 + th - 1) * colsMatrix + j], heightData[(size_t)(r0 + th) * colsMatrix + j]);
+                tileEdges[t].push_back(SpillEdge{min(a, b), max(a, b), level});
+            }
+        }
+        if (control)
+            control->advance((ll)th * tw);
+    });
+    if (cancelled())
+        return -1;
+
+    // Граф переливов решается последовательно: в нем только клетки периметров блоков
+    vector<SpillEdge> edges;
+    for (vector<SpillEdge>& e : tileEdges) {
+        edges.insert(edges.end(), e.begin(), e.end());
+        vector<SpillEdge>().swap(e);
+    }
+    vector<pii> shore;
+    for (int i = 0; i < rowsMatrix; i++) {
+        shore.push_back({heightData[(size_t)i * colsMatrix], perimeterLabel(i, 0)});
+        shore.push_back({heightData[(size_t)i * colsMatrix + colsMatrix - 1], perimeterLabel(i, colsMatrix - 1)});
+    }
+    for (int j = 0; j < colsMatrix; j++) {
+        shore.push_back({heightData[j], perimeterLabel(0, j)});
+        shore.push_back({heightData[(size_t)(rowsMatrix - 1) * colsMatrix + j], perimeterLabel(rowsMatrix - 1, j)});
+    }
+    vector<int> labelLevel = resolveSpillGraph(labelBase[tiles], edges, shore);
+    if (cancelled())
+        return -1;
+
+    // Поднимаем локальные уровни до уровней меток и считаем объем
+    vector<ll> tileVolume(tiles, 0);
+    SOLVER_STATS(vector<ll> tileFlooded(tiles, 0));
+    forEachTile([&](int, int t) {
+        if (cancelled())
+            return;
+        int r0 = t / tileCols * tileSize;
+        int c0 = t % tileCols * tileSize;
+        int th = min(tileSize, rowsMatrix - r0);
+        int tw = min(tileSize, colsMatrix - c0);
+        ll volume = 0;
+        for (int i = r0; i < r0 + th; i++) {
+            size_t row = (size_t)i * colsMatrix;
+            for (size_t u = row + c0; u < row + c0 + tw; u++) {
+                int level = max(levels[u], labelLevel[labels[u]]);
+                levels[u] = level;
+                volume += (ll)level - heightData[u];
+                SOLVER_STATS(tileFlooded[t] += level > heightData[u]);
+            }
+        }
+        tileVolume[t] = volume;
+        if (regionCallback) {
+            GridRegion region;
+            region.row = r0;
+            region.col = c0;
+            region.rows = th;
+            region.cols = tw;
+            region.values.resize((size_t)th * tw);
+            for (int i = 0; i < th; i++)
+                copy_n(&levels[(size_t)(r0 + i) * colsMatrix + c0], tw, region.values.begin() + (size_t)i * tw);
+            regionCallback(move(region));
+        }
+        if (control)
+            control->advance((ll)th * tw);
+    });
+    if (cancelled())
+        return -1;
+
+    ll ans = 0;
+    for (ll volume : tileVolume)
+        ans += volume;
+#ifdef WATERCUBOIDS_STATS
+    SolverStats counters;
+    counters.rows = rowsMatrix;
+    counters.cols = colsMatrix;
+    counters.setupSeconds = statistics.setupSeconds;
+    for (const TileFlooder& flooder : flooders)
+        counters.merge(flooder.stats());
+    for (ll flooded : tileFlooded)
+        counters.cellsFlooded += flooded;
+    counters.floodSeconds = clock.seconds();
+    statistics = counters;
+#endif
+    return ans;
+}
+
+vector<vector<int>> ParallelWaterVolumeSolver::getWorkingMatrix() const {
+    SOLVER_STATS(StatsClock clock);
+    vector<vector<int>> matrixOutput(rowsMatrix);
+    for (int i = 0; i < rowsMatrix; i++)
+        matrixOutput[i].assign(levels.begin() + (size_t)i * colsMatrix, levels.begin() + (size_t)(i + 1) * colsMatrix);
+    SOLVER_STATS(statistics.outputSeconds = clock.seconds());
+    return matrixOutput;
+}
+
+/**
+ * @brief Забирает уровни воды (рабочую матрицу построчно) без копирования.
+ * Метки больше не нужны и освобождаются вместе с уровнями.
+ */
+vector<int> ParallelWaterVolumeSolver::takeLevels() {
+    vector<int>().swap(labels);
+    rowsMatrix = 0;
+    return move(levels);
+}
@@ -0,0 +1,120 @@
+#ifndef PARALLELWATERVOLUMESOLVER_H
+#define PARALLELWATERVOLUMESOLVER_H
+
+#include "tileflood.h"
+#include "gridview.h"
+#include "solvecontrol.h"
+#include "heightgrid.h"
+#include <functional>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Класс ParallelWaterVolumeSolver решает задачу о объеме воды на нескольких ядрах.
+ * Сетка делится на блоки, которые заполняются независимо в пуле потоков (TileFlooder).
+ * Затем по уровням переливов на краях блоков строится небольшой граф, он решается
+ * последовательно, и последний параллельный проход поднимает уровни воды в каждом блоке.
+ * Результат совпадает с WaterVolumeSolver::solve() бит в бит.
+ */
+class ParallelWaterVolumeSolver {
+public:
+    /**
+     * @brief Конструктор класса ParallelWaterVolumeSolver.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param matrix Матрица с высотами столбцов.
+     * @param threads Количество рабочих потоков (0 - по числу ядер).
+     * @param tileSize Сторона блока.
+     */
+    ParallelWaterVolumeSolver(int rows, int cols, const vector<vector<int>>& matrix, int threads = 0, int tileSize = 256);
+
+    /**
+     * @brief Конструктор класса ParallelWaterVolumeSolver из непрерывного буфера высот.
+     * Высоты int32 читаются прямо из буфера без копирования, более узкие расширяются один раз.
+     * Буфер должен жить, пока жив решатель.
+     * @param view Матрица с высотами столбцов.
+     * @param threads Количество рабочих потоков (0 - по числу ядер).
+     * @param tileSize Сторона блока.
+     */
+    explicit ParallelWaterVolumeSolver(const GridView& view, int threads = 0, int tileSize = 256);
+
+    /**
+     * @brief Подключает состояние для отмены и прогресса.
+     * Прогресс считается в клетках: каждая клетка проходится дважды (заполнение блока и подъем уровней),
+     * поэтому total равен удвоенному количеству клеток. Отмена проверяется перед каждым блоком.
+     * @param control Состояние решения (nullptr - отключить); должно жить до конца solve().
+     */
+    void setControl(SolveControl* control);
+
+    /**
+     * @brief Задает функцию, получающую окончательные уровни каждого блока, как только они готовы.
+     * Блоки готовы только после решения графа переливов, то есть во втором параллельном проходе.
+     * Функция вызывается из рабочих потоков одновременно и должна быть потокобезопасной.
+     * @param callback Функция, принимающая блок с уровнями воды (пустая - отключить).
+     */
+    void setRegionCallback(function<void(GridRegion&&)> callback);
+
+    /**
+     * @brief Решает задачу о объеме воды.
+     * @return Объем воды, который можно собрать, или -1, если решение отменено.
+     */
+    ll solve();
+
+    vector<vector<int>> getWorkingMatrix() const;
+
+    /**
+     * @brief Забирает уровни воды (рабочую матрицу построчно) без копирования.
+     * После вызова getWorkingMatrix() и takeLevels() возвращают пустой результат.
+     */
+    vector<int> takeLevels();
+
+    /**
+     * @brief Возвращает счетчики: очереди и стеки всех блоков, затопленные клетки и время этапов.
+     * Подготовка измеряется в конструкторе, заполнение - весь solve(), выдача - getWorkingMatrix().
+     * Без WATERCUBOIDS_STATS все поля равны нулю.
+     */
+    const SolverStats& stats() const { return statistics; }
+
+private:
+    int rowsMatrix; /**< Количество строк в матрице. */
+    int colsMatrix; /**< Количество столбцов в матрице. */
+    int threadCount; /**< Количество рабочих потоков. */
+    int tileSize; /**< Сторона блока. */
+    int tileRows; /**< Количество блоков по вертикали. */
+    int tileCols; /**< Количество блоков по горизонтали. */
+    vector<int> heights; /**< Собственная копия высот, если входной буфер нельзя читать напрямую. */
+    const int* heightData; /**< Высоты столбцов, построчно. */
+    vector<int> levels; /**< Уровни воды, построчно (до последнего прохода - локальные уровни блоков). */
+    vector<int> labels; /**< Метки клеток периметра, через которые стекают клетки. */
+    vector<int> labelBase; /**< Метка первой клетки периметра каждого блока. */
+    SolveControl* control = nullptr; /**< Состояние для отмены и прогресса (может отсутствовать). */
+    function<void(GridRegion&&)> regionCallback; /**< Получатель готовых блоков (может отсутствовать). */
+    mutable SolverStats statistics; /**< Счетчики последнего решения. */
+
+    /**
+     * @brief Выполняет функцию для каждого блока в пуле потоков.
+     * @param body Функция, принимающая номер рабочего потока и номер блока.
+     */
+    void forEachTile(const function<void(int, int)>& body);
+
+    /**
+     * @brief Возвращает метку клетки периметра блока по глобальным координатам.
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     */
+    int perimeterLabel(int row, int col) const;
+
+    /**
+     * @brief Проверяет, отменено ли решение.
+     */
+    bool cancelled() const { return control && control->isCancelled(); }
+
+    /**
+     * @brief Выделяет рабочие буферы и нумерует метки блоков.
+     */
+    void init();
+};
+
+#endif // PARALLELWATERVOLUMESOLVER_H
@@ -0,0 +1,218 @@
+#include "reconstructionwatervolumesolver.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define WATERCUBOIDS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Шаг реконструкции от соседней строки обычным циклом.
+ */
+static void stepRowScalar(int* level, const int* other, const int* height, int n) {
+    for (int k = 0; k < n; k++)
+        level[k] = max(height[k], min(level[k], other[k]));
+}
+
+#ifdef WATERCUBOIDS_X86_KERNELS
+/**
+ * @brief Шаг реконструкции от соседней строки на SSE4.1.
+ */
+__attribute__((target("sse4.1")))
+static void stepRowSse41(int* level, const int* other, const int* height, int n) {
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(level + k));
+        __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other + k));
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(height + k));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(level + k), _mm_max_epi32(h, _mm_min_epi32(l, o)));
+    }
+    stepRowScalar(level + k, other + k, height + k, n - k);
+}
+
+/**
+ * @brief Шаг реконструкции от соседней строки на AVX2.
+ */
+__attribute__((target("avx2")))
+static void stepRowAvx2(int* level, const int* other, const int* height, int n) {
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(level + k));
+        __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + k));
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(height + k));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(level + k), _mm256_max_epi32(h, _mm256_min_epi32(l, o)));
+    }
+    stepRowScalar(level + k, other + k, height + k, n - k);
+}
+#endif
+
+/**
+ * @brief Конструктор класса ReconstructionWaterVolumeSolver.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ */
+ReconstructionWaterVolumeSolver::ReconstructionWaterVolumeSolver(int rows, int cols, const vector<vector<int>>& matrix) {
+    init(rows, cols);
+    for (int i = 0; i < rowsMatrix; i++)
+        copy(matrix[i].begin(), matrix[i].begin() + colsMatrix, heights.begin() + (size_t)(i + 1) * stride + 1);
+}
+
+/**
+ * @brief Конструктор класса ReconstructionWaterVolumeSolver из непрерывного буфера высот.
+ * @param view Матрица с высотами столбцов (до 32 бит).
+ */
+ReconstructionWaterVolumeSolver::ReconstructionWaterVolumeSolver(const GridView& view) {
+    init(view.rows, view.cols);
+    for (int i = 0; i < rowsMatrix; i++) {
+        int* row = &heights[(size_t)(i + 1) * stride + 1];
+        for (int j = 0; j < colsMatrix; j++)
+            row[j] = view.at(i, j);
+    }
+}
+
+/**
+ * @brief Выделяет буферы с рамкой: рамка - сток с уровнем INT_MIN, внутри маркер равен INT_MAX.
+ */
+void ReconstructionWaterVolumeSolver::init(int rows, int cols) {
+    rowsMatrix = rows;
+    colsMatrix = cols;
+    stride = cols + 2;
+    simdKernel = detectKernel();
+    heights.assign((size_t)(rows + 2) * stride, INT_MIN);
+    levels.assign((size_t)(rows + 2) * stride, INT_MIN);
+    for (int i = 1; i <= rows; i++)
+        fill_n(&levels[(size_t)i * stride + 1], cols, INT_MAX);
+}
+
+/**
+ * @brief Выбирает набор инструкций (неподдерживаемый процессором заменяется лучшим доступным).
+ * @param kernel Набор инструкций.
+ */
+void ReconstructionWaterVolumeSolver::setKernel(SimdKernel kernel) {
+    simdKernel = min(kernel, detectKernel());
+}
+
+/**
+ * @brief Возвращает лучший набор инструкций, поддерживаемый процессором.
+ */
+SimdKernel ReconstructionWaterVolumeSolver::detectKernel() {
+#ifdef WATERCUBOIDS_X86_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+        return SimdKernel::Avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SimdKernel::Sse41;
+#endif
+    return SimdKernel::Scalar;
+}
+
+/**
+ * @brief Возвращает название набора инструкций.
+ */
+const char* ReconstructionWaterVolumeSolver::kernelName(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Avx2:
+        return "avx2";
+    case SimdKernel::Sse41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief Выполняет шаг реконструкции от соседней строки выбранными инструкциями.
+ */
+void ReconstructionWaterVolumeSolver::stepRow(int* level, const int* other, const int* height, int n) const {
+#ifdef WATERCUBOIDS_X86_KERNELS
+    if (simdKernel == SimdKernel::Avx2) {
+        stepRowAvx2(level, other, height, n);
+        return;
+    }
+    if (simdKernel == SimdKernel::Sse41) {
+        stepRowSse41(level, other, height, n);
+        return;
+    }
+#endif
+    stepRowScalar(level, other, height, n);
+}
+
+/**
+ * @brief Решает задачу о объеме воды.
+ * Прямой проход берет соседей сверху и слева, обратный - снизу и справа. После них в очередь
+ * попадают клетки, у которых есть сосед, способный еще опуститься; очередь доводит маркер до устойчивости.
+ * @return Объем воды, который можно собрать.
+ */
+ll ReconstructionWaterVolumeSolver::solve() {
+    int* J = levels.data();
+    const int* h = heights.data();
+
+    // Прямой проход: сначала векторный шаг от верхней строки, затем цепочка слева направо
+    for (int i = 1; i <= rowsMatrix; i++) {
+        int* row = J + (size_t)i * stride + 1;
+        const int* height = h + (size_t)i * stride + 1;
+        stepRow(row, row - stride, height, colsMatrix);
+        for (int j = 0; j < colsMatrix; j++)
+            row[j] = max(height[j], min(row[j], row[j - 1]));
+    }
+
+    // Обратный проход: шаг от нижней строки, затем цепочка справа налево
+    for (int i = rowsMatrix; i >= 1; i--) {
+        int* row = J + (size_t)i * stride + 1;
+        const int* height = h + (size_t)i * stride + 1;
+        stepRow(row, row + stride, height, colsMatrix);
+        for (int j = colsMatrix - 1; j >= 0; j--)
+            row[j] = max(height[j], min(row[j], row[j + 1]));
+    }
+
+    // Отбор без ветвлений по строке векторизуется компилятором; ветвятся только редкие добавления в очередь
+    fifo.clear();
+    vector<uint8_t> seed(colsMatrix);
+    for (int i = 1; i <= rowsMatrix; i++) {
+        int base = i * stride + 1;
+        for (int j = 0; j < colsMatrix; j++) {
+            int p = base + j;
+            int level = J[p];
+            seed[j] = ((J[p - stride] > level) & (J[p - stride] > h[p - stride]))
+                    | ((J[p + stride] > level) & (J[p + stride] > h[p + stride]))
+                    | ((J[p - 1] > level) & (J[p - 1] > h[p - 1]))
+                    | ((J[p + 1] > level) & (J[p + 1] > h[p + 1]));
+        }
+        for (int j = 0; j < colsMatrix; j++) {
+            if (seed[j])
+                fifo.push_back(base + j);
+        }
+    }
+
+    // Распространяем уровни от клеток очереди, пока соседи опускаются
+    const int offsets[4] = {-stride, 1, stride, -1};
+    for (size_t head = 0; head < fifo.size(); head++) {
+        int p = fifo[head];
+        for (int d : offsets) {
+            int q = p + d;
+            if (J[q] > J[p] && J[q] > h[q]) {
+                J[q] = max(J[p], h[q]);
+                fifo.push_back(q);
+            }
+        }
+    }
+
+    ll ans = 0;
+    for (int i = 1; i <= rowsMatrix; i++) {
+        const int* row = J + (size_t)i * stride + 1;
+        const int* height = h + (size_t)i * stride + 1;
+        for (int j = 0; j < colsMatrix; j++)
+            ans += (ll)row[j] - height[j];
+    }
+    return ans;
+}
+
+vector<vector<int>> ReconstructionWaterVolumeSolver::getWorkingMatrix() const {
+    vector<vector<int>> matrixOutput(rowsMatrix);
+    for (int i = 0; i < rowsMatrix; i++)
+        matrixOutput[i].assign(levels.begin() + (size_t)(i + 1) * stride + 1, levels.begin() + (size_t)(i + 1) * stride + 1 + colsMatrix);
+    return matrixOutput;
+}
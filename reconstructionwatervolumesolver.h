@@ -0,0 +1,91 @@
+#ifndef RECONSTRUCTIONWATERVOLUMESOLVER_H
+#define RECONSTRUCTIONWATERVOLUMESOLVER_H
+
+#include "gridview.h"
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Набор векторных инструкций для проходов по строкам.
+ */
+enum class SimdKernel {
+    Scalar, /**< Обычный цикл (на любом процессоре). */
+    Sse41, /**< SSE4.1, по 4 клетки за инструкцию. */
+    Avx2 /**< AVX2, по 8 клеток за инструкцию. */
+};
+
+/**
+ * @brief Класс ReconstructionWaterVolumeSolver решает задачу морфологической реконструкцией.
+ * Уровень воды - реконструкция эрозией: маркер равен +бесконечности внутри и высоте на краю,
+ * затем J = max(h, min(J, J соседа)) до устойчивости. Используется гибридный алгоритм Винсента:
+ * прямой и обратный проходы растром, затем очередь FIFO для клеток, которые еще могут опуститься.
+ * В проходах шаг от соседней строки выполняется векторно по всей строке (AVX2 или SSE4.1,
+ * выбираются по возможностям процессора при запуске), шаг вдоль строки - последовательная цепочка.
+ * Без очереди с приоритетом: на ровных рельефах с плато проходы почти все решают сами.
+ * Результат совпадает с WaterVolumeSolver::solve() бит в бит.
+ */
+class ReconstructionWaterVolumeSolver {
+public:
+    /**
+     * @brief Конструктор класса ReconstructionWaterVolumeSolver.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param matrix Матрица с высотами столбцов.
+     */
+    ReconstructionWaterVolumeSolver(int rows, int cols, const vector<vector<int>>& matrix);
+
+    /**
+     * @brief Конструктор класса ReconstructionWaterVolumeSolver из непрерывного буфера высот.
+     * @param view Матрица с высотами столбцов (до 32 бит).
+     */
+    explicit ReconstructionWaterVolumeSolver(const GridView& view);
+
+    /**
+     * @brief Решает задачу о объеме воды.
+     * @return Объем воды, который можно собрать.
+     */
+    ll solve();
+
+    vector<vector<int>> getWorkingMatrix() const;
+
+    /**
+     * @brief Выбирает набор инструкций (неподдерживаемый процессором заменяется лучшим доступным).
+     * @param kernel Набор инструкций.
+     */
+    void setKernel(SimdKernel kernel);
+
+    SimdKernel kernel() const { return simdKernel; }
+
+    /**
+     * @brief Возвращает лучший набор инструкций, поддерживаемый процессором.
+     */
+    static SimdKernel detectKernel();
+
+    /**
+     * @brief Возвращает название набора инструкций ("scalar", "sse4.1", "avx2").
+     */
+    static const char* kernelName(SimdKernel kernel);
+
+private:
+    int rowsMatrix; /**< Количество строк в матрице. */
+    int colsMatrix; /**< Количество столбцов в матрице. */
+    int stride; /**< Длина строки с рамкой. */
+    SimdKernel simdKernel; /**< Выбранный набор инструкций. */
+    vector<int> heights; /**< Высоты с рамкой из INT_MIN (рамка - сток за краем сетки). */
+    vector<int> levels; /**< Маркер реконструкции, после solve() - уровни воды. */
+    vector<int> fifo; /**< Очередь клеток, от которых уровень еще распространяется. */
+
+    /**
+     * @brief Выделяет буферы с рамкой.
+     */
+    void init(int rows, int cols);
+
+    /**
+     * @brief Выполняет levels[k] = max(h[k], min(levels[k], other[k])) для строки выбранными инструкциями.
+     */
+    void stepRow(int* level, const int* other, const int* height, int n) const;
+};
+
+#endif // RECONSTRUCTIONWATERVOLUMESOLVER_H
@@ -0,0 +1,599 @@
+#include "solvecache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace {
+
+const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t prime3 = 0x165667B19E3779F9ULL;
+const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+
+uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Перемешивает биты 64-битного значения (финализатор xxHash64).
+ */
+uint64_t avalanche(uint64_t x) {
+    x ^= x >> 33;
+    x *= prime2;
+    x ^= x >> 29;
+    x *= prime3;
+    x ^= x >> 32;
+    return x;
+}
+
+/**
+ * @brief Потоковый хэш: четыре полосы по 8 байт, блоки по 32 байта.
+ * Неполный блок копится в буфере, поэтому результат не зависит от того, как поток разбит на части.
+ */
+class GridHasher {
+public:
+    explicit GridHasher(uint64_t seed) {
+        lane[0] = seed + prime1 + prime2;
+        lane[1] = seed + prime2;
+        lane[2] = seed;
+        lane[3] = seed - prime1;
+    }
+
+    void update(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        total += size;
+        if (buffered > 0) {
+            size_t take = min(size, sizeof(buffer) - buffered);
+            memcpy(buffer + buffered, p, take);
+            buffered += take;
+            p += take;
+            size -= take;
+            if (buffered < sizeof(buffer))
+                return;
+            block(buffer);
+            buffered = 0;
+        }
+        for (; size >= 32; p += 32, size -= 32)
+            block(p);
+        memcpy(buffer, p, size);
+        buffered = size;
+    }
+
+    /**
+     * @brief Возвращает 128 бит хэша: две разные свертки полос и хвоста.
+     */
+    void finish(uint64_t out[2]) {
+        uint64_t tail = total * prime4;
+        for (size_t k = 0; k < buffered; k++)
+            tail = rotl(tail ^ (buffer[k] * prime3), 11) * prime1;
+        out[0] = avalanche(rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18) + tail);
+        out[1] = avalanche((lane[0] ^ rotl(lane[1], 17) ^ rotl(lane[2], 31) ^ rotl(lane[3], 43)) * prime1 + (tail ^ prime2));
+    }
+
+private:
+    uint64_t lane[4];
+    uint8_t buffer[32];
+    size_t buffered = 0;
+    uint64_t total = 0;
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        return rotl(acc + input * prime2, 31) * prime1;
+    }
+
+    void block(const uint8_t* p) {
+        uint64_t word[4];
+        memcpy(word, p, sizeof(word));
+        lane[0] = round(lane[0], word[0]);
+        lane[1] = round(lane[1], word[1]);
+        lane[2] = round(lane[2], word[2]);
+        lane[3] = round(lane[3], word[3]);
+    }
+};
+
+/**
+ * @brief Хэширует строки матрицы как значения типа Value, приводя высоты из Source.
+ */
+template <class Source, class Value>
+void hashRows(GridHasher& hasher, const GridView& view) {
+    vector<Value> row(view.cols);
+    for (int i = 0; i < view.rows; i++) {
+        const Source* src = view.row<Source>(i);
+        for (int j = 0; j < view.cols; j++)
+            row[j] = (Value)src[j];
+        hasher.update(row.data(), row.size() * sizeof(Value));
+    }
+}
+
+void putVarint(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Сжимает глубины воды: пары (длина серии сухих клеток, глубина следующей клетки).
+ */
+vector<uint8_t> encodeDepths(const GridView& view, const int* levels) {
+    vector<uint8_t> out;
+    uint64_t run = 0;
+    for (int i = 0; i < view.rows; i++) {
+        const int* level = levels + (size_t)i * view.cols;
+        for (int j = 0; j < view.cols; j++) {
+            ll depth = (ll)level[j] - view.at(i, j);
+            if (depth == 0) {
+                run++;
+                continue;
+            }
+            putVarint(out, run);
+            putVarint(out, (uint64_t)depth);
+            run = 0;
+        }
+    }
+    if (run > 0)
+        putVarint(out, run);
+    return out;
+}
+
+/**
+ * @brief Наибольший размер сжатых глубин для сетки из cells клеток.
+ * Серия сухих клеток занимает не больше байт, чем клеток в ней, затопленная клетка - байт
+ * серии и до 5 байт глубины (глубина меньше 2^32).
+ */
+uint64_t maxDepthBytes(uint64_t cells) {
+    return cells * 6;
+}
+
+/**
+ * @brief Заголовок файла записи на диске (64 байта, little-endian), за ним сжатые глубины.
+ */
+struct CacheFileHeader {
+    char magic[8]; /**< Сигнатура "WCCACHE\0". */
+    uint32_t version; /**< Версия формата. */
+    uint32_t hasLevels; /**< 1, если за заголовком лежат глубины воды. */
+    uint64_t rows; /**< Количество строк в матрице. */
+    uint64_t cols; /**< Количество столбцов в матрице. */
+    uint64_t hash[2]; /**< Хэш высот. */
+    int64_t volume; /**< Объем воды. */
+    uint64_t depthBytes; /**< Размер сжатых глубин в байтах. */
+};
+
+static_assert(sizeof(CacheFileHeader) == 64, "CacheFileHeader must be 64 bytes");
+
+const char cacheMagic[8] = {'W', 'C', 'C', 'A', 'C', 'H', 'E', '\0'};
+const uint32_t cacheVersion = 1;
+
+}
+
+/**
+ * @brief Вычисляет ключ сетки.
+ * Высоты до 32 бит хэшируются как int32, 64-битные - как int64; строки с шагом, отличным
+ * от ширины, проходятся по одной.
+ * @param view Матрица высот.
+ */
+GridKey gridKey(const GridView& view) {
+    GridKey key;
+    key.rows = view.rows;
+    key.cols = view.cols;
+    GridHasher hasher(((uint64_t)(uint32_t)view.rows << 32) | (uint32_t)view.cols);
+    switch (view.elementWidth) {
+    case 1:
+        hashRows<int8_t, int32_t>(hasher, view);
+        break;
+    case 2:
+        hashRows<int16_t, int32_t>(hasher, view);
+        break;
+    case 8:
+        hasher.update("wide", 4);
+        if (view.rowStride == (size_t)view.cols) {
+            hasher.update(view.data, (size_t)view.rows * view.cols * sizeof(int64_t));
+        } else {
+            for (int i = 0; i < view.rows; i++)
+                hasher.update(view.row<int64_t>(i), (size_t)view.cols * sizeof(int64_t));
+        }
+        break;
+    default:
+        if (view.rowStride == (size_t)view.cols) {
+            hasher.update(view.data, (size_t)view.rows * view.cols * sizeof(int32_t));
+        } else {
+            for (int i = 0; i < view.rows; i++)
+                hasher.update(view.row<int32_t>(i), (size_t)view.cols * sizeof(int32_t));
+        }
+        break;
+    }
+    hasher.finish(key.hash);
+    return key;
+}
+
+/**
+ * @brief Конструктор класса SolveCache.
+ * @param memoryLimit Предел памяти первого уровня в байтах.
+ */
+SolveCache::SolveCache(size_t memoryLimit) : memoryLimit(memoryLimit) {}
+
+/**
+ * @brief Задает предел памяти и вытесняет лишние записи.
+ * @param bytes Предел памяти первого уровня в байтах.
+ */
+void SolveCache::setMemoryLimit(size_t bytes) {
+    lock_guard<mutex> guard(lock);
+    memoryLimit = bytes;
+    evict();
+}
+
+/**
+ * @brief Задает предел дискового уровня и удаляет лишние файлы.
+ * @param bytes Предел суммарного размера файлов кэша в каталоге, байт.
+ */
+void SolveCache::setDiskLimit(uintmax_t bytes) {
+    string dir;
+    {
+        lock_guard<mutex> guard(lock);
+        diskLimit = bytes;
+        dir = directory;
+    }
+    if (dir.empty())
+        return;
+    uintmax_t total = trimDirectory(dir, bytes);
+    lock_guard<mutex> guard(lock);
+    diskBytes = total;
+}
+
+/**
+ * @brief Включает дисковый уровень в каталоге (создает его при необходимости).
+ * Файлы сверх предела дискового уровня, оставшиеся от прошлых запусков, удаляются.
+ * @param directory Каталог для файлов кэша ("" - выключить дисковый уровень).
+ * @return false, если каталог не удалось создать.
+ */
+bool SolveCache::setDirectory(const string& directory) {
+    uintmax_t total = 0;
+    if (!directory.empty()) {
+        error_code error;
+        filesystem::create_directories(directory, error);
+        if (!filesystem::is_directory(directory, error))
+            return false;
+        uintmax_t limit;
+        {
+            lock_guard<mutex> guard(lock);
+            limit = diskLimit;
+        }
+        total = trimDirectory(directory, limit);
+    }
+    lock_guard<mutex> guard(lock);
+    this->directory = directory;
+    diskBytes = total;
+    return true;
+}
+
+/**
+ * @brief Ищет решение сетки в памяти, затем на диске.
+ * Файл читается без блокировки, чтобы медленный диск не задерживал другие потоки.
+ * @param key Ключ сетки (gridKey(view)).
+ * @param view Матрица высот: по ней восстанавливаются уровни воды.
+ * @param volume Объем воды.
+ * @param levels Уровни воды построчно (nullptr - не нужны).
+ * @return true, если решение найдено.
+ */
+bool SolveCache::lookup(const GridKey& key, const GridView& view, ll& volume, vector<int>* levels) {
+    string dir;
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it != index.end() && (!levels || it->second->hasLevels)) {
+            entries.splice(entries.begin(), entries, it->second);
+            const Entry& entry = entries.front();
+            volume = entry.volume;
+            if (levels && !decodeLevels(view, entry.depths, *levels)) {
+                missCount++;
+                return false;
+            }
+            hitCount++;
+            return true;
+        }
+        dir = directory;
+    }
+
+    Entry entry;
+    string path = dir.empty() ? string() : fileName(dir, key);
+    if (dir.empty() || !readEntry(path, key, entry) || (levels && !entry.hasLevels)
+            || (levels && !decodeLevels(view, entry.depths, *levels))) {
+        lock_guard<mutex> guard(lock);
+        missCount++;
+        return false;
+    }
+    // Прочитанный файл становится самым новым и вытесняется с диска последним
+    error_code error;
+    filesystem::last_write_time(path, filesystem::file_time_type::clock::now(), error);
+    volume = entry.volume;
+    lock_guard<mutex> guard(lock);
+    hitCount++;
+    insert(move(entry));
+    return true;
+}
+
+/**
+ * @brief Сохраняет решение сетки в памяти и на диске.
+ * Запись без матрицы не заменяет уже сохраненную запись с матрицей.
+ * @param key Ключ сетки (gridKey(view)).
+ * @param view Матрица высот (не шире int, если передаются уровни).
+ * @param volume Объем воды.
+ * @param levels Уровни воды построчно, rows * cols элементов (nullptr - только объем).
+ */
+void SolveCache::store(const GridKey& key, const GridView& view, ll volume, const int* levels) {
+    Entry entry{key, volume, levels != nullptr && view.fitsInt(), {}};
+    if (entry.hasLevels)
+        entry.depths = encodeDepths(view, levels);
+
+    string dir;
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it != index.end() && it->second->hasLevels && !entry.hasLevels) {
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        dir = directory;
+        if (dir.empty()) {
+            insert(move(entry));
+            return;
+        }
+        insert(Entry(entry));
+    }
+    string path = fileName(dir, key);
+    error_code error;
+    uintmax_t previous = filesystem::file_size(path, error);
+    if (error)
+        previous = 0;
+    if (!writeEntry(path, entry))
+        return;
+    uintmax_t written = filesystem::file_size(path, error);
+    if (error)
+        written = 0;
+
+    uintmax_t limit;
+    {
+        lock_guard<mutex> guard(lock);
+        diskBytes = diskBytes + written > previous ? diskBytes + written - previous : 0;
+        if (diskBytes <= diskLimit || directory != dir)
+            return;
+        limit = diskLimit;
+    }
+    uintmax_t total = trimDirectory(dir, limit);
+    lock_guard<mutex> guard(lock);
+    diskBytes = total;
+}
+
+/**
+ * @brief Очищает первый уровень (файлы на диске остаются).
+ */
+void SolveCache::clear() {
+    lock_guard<mutex> guard(lock);
+    entries.clear();
+    index.clear();
+    memoryBytes = 0;
+}
+
+size_t SolveCache::memoryUsage() const {
+    lock_guard<mutex> guard(lock);
+    return memoryBytes;
+}
+
+uintmax_t SolveCache::diskUsage() const {
+    lock_guard<mutex> guard(lock);
+    return diskBytes;
+}
+
+size_t SolveCache::hits() const {
+    lock_guard<mutex> guard(lock);
+    return hitCount;
+}
+
+size_t SolveCache::misses() const {
+    lock_guard<mutex> guard(lock);
+    return missCount;
+}
+
+/**
+ * @brief Кладет запись в начало списка, заменяя запись с тем же ключом, и вытесняет лишние.
+ * Запись больше всего предела в память не попадает (остается только на диске).
+ * @param entry Запись.
+ */
+void SolveCache::insert(Entry&& entry) {
+    auto it = index.find(entry.key);
+    if (it != index.end()) {
+        memoryBytes -= sizeof(Entry) + it->second->depths.capacity();
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    size_t bytes = sizeof(Entry) + entry.depths.capacity();
+    if (bytes > memoryLimit)
+        return;
+    entries.push_front(move(entry));
+    index[entries.front().key] = entries.begin();
+    memoryBytes += bytes;
+    evict();
+}
+
+/**
+ * @brief Вытесняет давно не использованные записи сверх предела памяти.
+ */
+void SolveCache::evict() {
+    while (memoryBytes > memoryLimit && !entries.empty()) {
+        const Entry& last = entries.back();
+        memoryBytes -= sizeof(Entry) + last.depths.capacity();
+        index.erase(last.key);
+        entries.pop_back();
+    }
+}
+
+/**
+ * @brief Удаляет самые старые файлы кэша, пока их суммарный размер больше предела.
+ * Учитываются только файлы записей (.wcc); файлы, которые не удалось удалить, остаются в сумме.
+ * @return Суммарный размер оставшихся файлов кэша.
+ */
+uintmax_t SolveCache::trimDirectory(const string& directory, uintmax_t limit) {
+    struct CacheFile {
+        filesystem::file_time_type time;
+        uintmax_t size;
+        filesystem::path path;
+    };
+    vector<CacheFile> files;
+    uintmax_t total = 0;
+    error_code error;
+    for (filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() != ".wcc" || !it->is_regular_file(error))
+            continue;
+        CacheFile file;
+        file.path = it->path();
+        file.time = it->last_write_time(error);
+        if (error)
+            continue;
+        file.size = it->file_size(error);
+        if (error)
+            continue;
+        files.push_back(file);
+        total += file.size;
+    }
+    if (total <= limit)
+        return total;
+    sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.time < b.time; });
+    for (const CacheFile& file : files) {
+        if (total <= limit)
+            break;
+        if (filesystem::remove(file.path, error))
+            total -= file.size;
+    }
+    return total;
+}
+
+/**
+ * @brief Возвращает имя файла записи: размеры и хэш в шестнадцатеричной записи.
+ */
+string SolveCache::fileName(const string& directory, const GridKey& key) {
+    char name[80];
+    snprintf(name, sizeof(name), "%dx%d-%016llx%016llx.wcc", key.rows, key.cols,
+             (unsigned long long)key.hash[0], (unsigned long long)key.hash[1]);
+    return (filesystem::path(directory) / name).string();
+}
+
+/**
+ * @brief Читает запись с диска и сверяет заголовок с ключом.
+ * Размер глубин сверяется с размером файла и с размером сетки.
+ * @return false, если файла нет или он поврежден.
+ */
+bool SolveCache::readEntry(const string& path, const GridKey& key, Entry& entry) {
+    ifstream file(path, ios::binary);
+    CacheFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion
+            || header.rows != (uint64_t)key.rows || header.cols != (uint64_t)key.cols
+            || header.hash[0] != key.hash[0] || header.hash[1] != key.hash[1])
+        return false;
+    // Размер проверяется до выделения памяти: поврежденный заголовок не должен просить гигабайты
+    error_code error;
+    uintmax_t fileSize = filesystem::file_size(path, error);
+    if (error || fileSize < sizeof(header) || header.depthBytes > fileSize - sizeof(header)
+            || header.depthBytes > maxDepthBytes((uint64_t)key.rows * (uint64_t)key.cols))
+        return false;
+    entry.key = key;
+    entry.volume = header.volume;
+    entry.hasLevels = header.hasLevels != 0;
+    entry.depths.resize(header.depthBytes);
+    return (bool)file.read(reinterpret_cast<char*>(entry.depths.data()), entry.depths.size());
+}
+
+/**
+ * @brief Записывает запись на диск через временный файл.
+ * Файл переименовывается только целиком записанным, поэтому прерванная запись не оставляет
+ * поврежденных файлов; одинаковое содержимое под одним именем делает гонки потоков безвредными.
+ * Запись без матрицы не заменяет уже лежащий на диске файл.
+ * @return false, если файл не удалось записать.
+ */
+bool SolveCache::writeEntry(const string& path, const Entry& entry) {
+    CacheFileHeader header = {};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.hasLevels = entry.hasLevels;
+    header.rows = entry.key.rows;
+    header.cols = entry.key.cols;
+    header.hash[0] = entry.key.hash[0];
+    header.hash[1] = entry.key.hash[1];
+    header.volume = entry.volume;
+    header.depthBytes = entry.depths.size();
+
+    error_code error;
+    if (!entry.hasLevels && filesystem::exists(path, error))
+        return true;
+    string temporary = path + ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()))
+            + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count());
+    {
+        ofstream file(temporary, ios::binary | ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(entry.depths.data()), entry.depths.size());
+        if (!file.flush()) {
+            file.close();
+            filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    filesystem::rename(temporary, path, error);
+    if (error) {
+        filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Восстанавливает уровни воды из высот и сжатых глубин.
+ * @return false, если данные повреждены.
+ */
+bool SolveCache::decodeLevels(const GridView& view, const vector<uint8_t>& depths, vector<int>& levels) {
+    size_t cells = (size_t)view.rows * view.cols;
+    levels.resize(cells);
+    for (int i = 0; i < view.rows; i++) {
+        int* level = &levels[(size_t)i * view.cols];
+        if (view.elementWidth == 4) {
+            copy_n(view.row<int32_t>(i), view.cols, level);
+        } else {
+            for (int j = 0; j < view.cols; j++)
+                level[j] = view.at(i, j);
+        }
+    }
+
+    const uint8_t* p = depths.data();
+    const uint8_t* end = p + depths.size();
+    size_t cell = 0;
+    while (p < end) {
+        uint64_t run, depth;
+        if (!getVarint(p, end, run) || run > cells - cell)
+            return false;
+        cell += run;
+        if (p == end)
+            break;
+        if (cell == cells || !getVarint(p, end, depth))
+            return false;
+        levels[cell] = (int)((ll)levels[cell] + (ll)depth);
+        cell++;
+    }
+    return true;
+}
@@ -0,0 +1,179 @@
+#ifndef SOLVECACHE_H
+#define SOLVECACHE_H
+
+#include "gridview.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Ключ сетки в кэше решений: размеры и 128-битный хэш высот.
+ */
+struct GridKey {
+    int rows = 0; /**< Количество строк в матрице. */
+    int cols = 0; /**< Количество столбцов в матрице. */
+    uint64_t hash[2] = {0, 0}; /**< Хэш значений высот. */
+
+    bool operator==(const GridKey& other) const {
+        return rows == other.rows && cols == other.cols && hash[0] == other.hash[0] && hash[1] == other.hash[1];
+    }
+};
+
+/**
+ * @brief Вычисляет ключ сетки.
+ * Хэшируются значения высот, а не их запись: одна и та же матрица из файла с однобайтовыми
+ * высотами и из буфера int получает один ключ. Четыре независимые 64-битные полосы
+ * (раунд как в xxHash64) проходят буфер со скоростью чтения памяти.
+ * @param view Матрица высот.
+ */
+GridKey gridKey(const GridView& view);
+
+/**
+ * @brief Класс SolveCache хранит результаты решений по содержимому сетки.
+ * Первый уровень - в памяти, с вытеснением давно не использованных записей (LRU) по пределу
+ * памяти; второй, необязательный - каталог на диске, по файлу на сетку, переживает перезапуск.
+ * Файлы каталога занимают не больше предела диска: сверх него удаляются файлы, дольше всех не
+ * записанные и не прочитанные (по времени изменения, которое обновляется при попадании).
+ * Вместе с объемом можно сохранить рабочую матрицу: хранится глубина воды над клетками
+ * (серии сухих клеток и глубины в коде переменной длины), поэтому на рельефах с небольшими
+ * озерами запись в десятки раз меньше самой матрицы. Методы можно вызывать из разных потоков.
+ */
+class SolveCache {
+public:
+    static const size_t defaultMemoryLimit = (size_t)256 << 20; /**< Предел памяти по умолчанию, байт. */
+    static const uintmax_t defaultDiskLimit = (uintmax_t)1 << 30; /**< Предел дискового уровня по умолчанию, байт. */
+
+    /**
+     * @brief Конструктор класса SolveCache.
+     * @param memoryLimit Предел памяти первого уровня в байтах.
+     */
+    explicit SolveCache(size_t memoryLimit = defaultMemoryLimit);
+
+    /**
+     * @brief Задает предел памяти и вытесняет лишние записи.
+     * @param bytes Предел памяти первого уровня в байтах.
+     */
+    void setMemoryLimit(size_t bytes);
+
+    /**
+     * @brief Задает предел дискового уровня и удаляет лишние файлы.
+     * @param bytes Предел суммарного размера файлов кэша в каталоге, байт.
+     */
+    void setDiskLimit(uintmax_t bytes);
+
+    /**
+     * @brief Включает дисковый уровень в каталоге (создает его при необходимости).
+     * Файлы сверх предела дискового уровня, оставшиеся от прошлых запусков, удаляются.
+     * @param directory Каталог для файлов кэша ("" - выключить дисковый уровень).
+     * @return false, если каталог не удалось создать.
+     */
+    bool setDirectory(const string& directory);
+
+    /**
+     * @brief Ищет решение сетки в памяти, затем на диске (найденное на диске поднимается в память).
+     * @param key Ключ сетки (gridKey(view)).
+     * @param view Матрица высот: по ней восстанавливаются уровни воды.
+     * @param volume Объем воды.
+     * @param levels Уровни воды построчно (nullptr - не нужны; если нужны, а не сохранены, это промах).
+     * @return true, если решение найдено.
+     */
+    bool lookup(const GridKey& key, const GridView& view, ll& volume, vector<int>* levels = nullptr);
+
+    /**
+     * @brief Сохраняет решение сетки в памяти и на диске.
+     * @param key Ключ сетки (gridKey(view)).
+     * @param view Матрица высот (не шире int, если передаются уровни).
+     * @param volume Объем воды.
+     * @param levels Уровни воды построчно, rows * cols элементов (nullptr - только объем).
+     */
+    void store(const GridKey& key, const GridView& view, ll volume, const int* levels = nullptr);
+
+    /**
+     * @brief Очищает первый уровень (файлы на диске остаются).
+     */
+    void clear();
+
+    size_t memoryUsage() const;
+    uintmax_t diskUsage() const;
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    /**
+     * @brief Запись кэша.
+     */
+    struct Entry {
+        GridKey key; /**< Ключ сетки. */
+        ll volume; /**< Объем воды. */
+        bool hasLevels; /**< Сохранена ли рабочая матрица. */
+        vector<uint8_t> depths; /**< Сжатые глубины воды (пусто, если матрица не сохранена). */
+    };
+
+    /**
+     * @brief Хэш ключа для таблицы (старшие биты хэша сетки уже перемешаны).
+     */
+    struct KeyHash {
+        size_t operator()(const GridKey& key) const { return (size_t)key.hash[0]; }
+    };
+
+    mutable mutex lock; /**< Защищает все поля ниже. */
+    size_t memoryLimit; /**< Предел памяти первого уровня, байт. */
+    size_t memoryBytes = 0; /**< Память, занятая записями. */
+    string directory; /**< Каталог дискового уровня ("" - выключен). */
+    uintmax_t diskLimit = defaultDiskLimit; /**< Предел дискового уровня, байт. */
+    uintmax_t diskBytes = 0; /**< Суммарный размер файлов кэша в каталоге (по последнему просмотру и записям). */
+    list<Entry> entries; /**< Записи от недавно использованных к давно не использованным. */
+    unordered_map<GridKey, list<Entry>::iterator, KeyHash> index; /**< Записи по ключу. */
+    size_t hitCount = 0; /**< Количество попаданий. */
+    size_t missCount = 0; /**< Количество промахов. */
+
+    /**
+     * @brief Кладет запись в начало списка, заменяя запись с тем же ключом, и вытесняет лишние.
+     * Вызывается под lock.
+     * @param entry Запись.
+     */
+    void insert(Entry&& entry);
+
+    /**
+     * @brief Вытесняет давно не использованные записи сверх предела памяти. Вызывается под lock.
+     */
+    void evict();
+
+    /**
+     * @brief Удаляет самые старые файлы кэша, пока их суммарный размер больше предела.
+     * Вызывается без lock: просмотр каталога не задерживает другие потоки.
+     * @return Суммарный размер оставшихся файлов кэша.
+     */
+    static uintmax_t trimDirectory(const string& directory, uintmax_t limit);
+
+    /**
+     * @brief Возвращает имя файла записи в каталоге дискового уровня.
+     */
+    static string fileName(const string& directory, const GridKey& key);
+
+    /**
+     * @brief Читает запись с диска.
+     * @return false, если файла нет или он поврежден.
+     */
+    static bool readEntry(const string& path, const GridKey& key, Entry& entry);
+
+    /**
+     * @brief Записывает запись на диск через временный файл.
+     * @return false, если файл не удалось записать.
+     */
+    static bool writeEntry(const string& path, const Entry& entry);
+
+    /**
+     * @brief Восстанавливает уровни воды из высот и сжатых глубин.
+     * @return false, если данные повреждены.
+     */
+    static bool decodeLevels(const GridView& view, const vector<uint8_t>& depths, vector<int>& levels);
+};
+
+#endif // SOLVECACHE_H
@@ -0,0 +1,36 @@
+#ifndef SOLVECONTROL_H
+#define SOLVECONTROL_H
+
+#include <atomic>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Общее состояние решения, через которое другой поток отменяет его и следит за прогрессом.
+ * Решатель только читает флаг отмены и увеличивает счетчик, поэтому объект можно опрашивать
+ * без блокировок из любого потока, пока идет solve().
+ */
+struct SolveControl {
+    atomic<bool> cancelled{false}; /**< Запрошена отмена; решатель прерывается на ближайшей границе блока. */
+    atomic<ll> done{0}; /**< Количество пройденных клеток. */
+    atomic<ll> total{0}; /**< Сколько клеток нужно пройти всего (задает решатель в начале solve()). */
+
+    /**
+     * @brief Просит решатель остановиться.
+     */
+    void cancel() { cancelled.store(true, memory_order_relaxed); }
+
+    /**
+     * @brief Проверяет, запрошена ли отмена.
+     */
+    bool isCancelled() const { return cancelled.load(memory_order_relaxed); }
+
+    /**
+     * @brief Учитывает пройденные клетки.
+     * @param cells Количество клеток.
+     */
+    void advance(ll cells) { done.fetch_add(cells, memory_order_relaxed); }
+};
+
+#endif // SOLVECONTROL_H
@@ -0,0 +1,182 @@
+#include "solverscheduler.h"
+#include "parallelwatervolumesolver.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <functional>
+
+namespace {
+
+/**
+ * @brief Задача пула: решает одну матрицу и передает результат обратному вызову.
+ * Решение, найденное в кэше, отправляется одним блоком без запуска решателя.
+ */
+class SolverJob : public QRunnable {
+public:
+    typedef function<void(ll, SharedGrid, const SolverStats&)> Callback;
+    typedef function<void(GridRegion&&)> RegionCallback;
+
+    SolverJob(SharedGrid heights, int threads, SolveCache* cache, shared_ptr<SolveControl> control, RegionCallback region, Callback done)
+        : heights(move(heights)), threads(threads), cache(cache), control(move(control)), region(move(region)), done(move(done)) {}
+
+    void run() override {
+        GridView view = heights->view();
+        GridKey key = gridKey(view);
+        ll result;
+        vector<int> levels;
+        if (cache->lookup(key, view, result, &levels)) {
+            region(GridRegion{0, 0, heights->rows(), heights->cols(), levels});
+            done(result, makeSharedGrid(heights->rows(), heights->cols(), move(levels)), SolverStats());
+            return;
+        }
+
+        // Блоки сетки заполняются на всех ядрах, высоты читаются без копирования
+        ParallelWaterVolumeSolver solver(view, threads);
+        solver.setControl(control.get());
+        solver.setRegionCallback(region);
+        result = solver.solve();
+
+        // Рабочую матрицу забираем у решателя только у завершенного решения
+        SharedGrid workingMatrix;
+        if (result >= 0) {
+            levels = solver.takeLevels();
+            cache->store(key, view, result, levels.data());
+            workingMatrix = makeSharedGrid(heights->rows(), heights->cols(), move(levels));
+        }
+        done(result, workingMatrix, solver.stats());
+    }
+
+private:
+    SharedGrid heights; /**< Матрица высот. */
+    int threads; /**< Количество потоков решателя. */
+    SolveCache* cache; /**< Кэш решений планировщика. */
+    shared_ptr<SolveControl> control; /**< Флаг отмены и счетчик прогресса. */
+    RegionCallback region; /**< Вызывается в потоках решателя для каждого готового блока. */
+    Callback done; /**< Вызывается в потоке пула по окончании решения. */
+};
+
+/**
+ * @brief Задача пула: применяет правки к прошлому решению.
+ * В список изменений добавляются и сами правленые клетки: до ответа окно показывает их сухими.
+ */
+class EditJob : public QRunnable {
+public:
+    typedef function<void(ll, vector<CellChange>&&)> Callback;
+
+    EditJob(shared_ptr<IncrementalWaterVolumeSolver> solver, vector<CellEdit> edits, Callback done)
+        : solver(move(solver)), edits(move(edits)), done(move(done)) {}
+
+    void run() override {
+        vector<CellChange> changes;
+        ll result = solver->update(edits, &changes);
+        for (const CellEdit& edit : edits)
+            changes.push_back(CellChange{edit.row, edit.col, solver->level(edit.row, edit.col)});
+        done(result, move(changes));
+    }
+
+private:
+    shared_ptr<IncrementalWaterVolumeSolver> solver; /**< Решатель с прошлым решением. */
+    vector<CellEdit> edits; /**< Правки клеток. */
+    Callback done; /**< Вызывается в потоке пула после применения правок. */
+};
+
+}
+
+SolverScheduler::SolverScheduler(int threads, QObject* parent)
+    : QObject(parent), threads(threads > 0 ? threads : QThread::idealThreadCount())
+{
+    // Решения не выполняются параллельно друг другу: новое ждет, пока отмененное остановится
+    pool.setMaxThreadCount(1);
+    progressTimer.setInterval(progressInterval);
+    connect(&progressTimer, &QTimer::timeout, this, &SolverScheduler::publish);
+}
+
+SolverScheduler::~SolverScheduler() {
+    cancel();
+    pool.waitForDone();
+}
+
+quint64 SolverScheduler::submit(SharedGrid heights) {
+    resetGeneration = ++latestGeneration;
+    if (running) {
+        // Пока текущее решение останавливается, от предыдущих ожидающих запросов остается только последний
+        running->control.cancel();
+        queued = move(heights);
+    } else {
+        start(move(heights));
+    }
+    return latestGeneration;
+}
+
+quint64 SolverScheduler::update(shared_ptr<IncrementalWaterVolumeSolver> solver, vector<CellEdit> edits) {
+    quint64 generation = ++latestGeneration;
+    queued.reset();
+    if (running)
+        running->control.cancel();
+    // Пул однопоточный, поэтому правки применяются после отменяемого решения и друг за другом
+    pool.start(new EditJob(move(solver), move(edits), [this, generation](ll result, vector<CellChange>&& changes) {
+        QMetaObject::invokeMethod(this, [this, generation, result, changes = move(changes)]() {
+            // Каждая пачка правок меняет решатель, поэтому ее изменения нужны и после следующих пачек
+            if (generation > resetGeneration)
+                emit editsApplied(generation, result, changes);
+        }, Qt::QueuedConnection);
+    }));
+    return generation;
+}
+
+void SolverScheduler::cancel() {
+    resetGeneration = ++latestGeneration;
+    queued.reset();
+    if (running)
+        running->control.cancel();
+}
+
+void SolverScheduler::start(SharedGrid heights) {
+    runningGeneration = latestGeneration;
+    running = make_shared<RunningJob>();
+
+    quint64 generation = runningGeneration;
+    SharedGrid source = heights;
+    shared_ptr<RunningJob> job = running;
+    auto region = [job](GridRegion&& tile) {
+        QMutexLocker locker(&job->mutex);
+        job->regions.push_back(move(tile));
+    };
+    pool.start(new SolverJob(move(heights), threads, &solveCache, shared_ptr<SolveControl>(job, &job->control), region, [this, generation, source](ll result, SharedGrid workingMatrix, const SolverStats& stats) {
+        // Результат возвращается в основной поток; если планировщик уже удален, событие пропадет вместе с ним
+        QMetaObject::invokeMethod(this, [this, generation, source, result, workingMatrix, stats]() {
+            handleJobDone(generation, result, source, workingMatrix, stats);
+        }, Qt::QueuedConnection);
+    }));
+    progressTimer.start();
+}
+
+void SolverScheduler::handleJobDone(quint64 generation, ll result, SharedGrid heights, SharedGrid workingMatrix, const SolverStats& stats) {
+    // Блоки, готовые после последнего опроса, уходят раньше итога
+    if (result >= 0)
+        publish();
+    running.reset();
+    if (queued)
+        start(move(queued));
+    else
+        progressTimer.stop();
+
+    if (result >= 0 && generation == latestGeneration) {
+        lastStats = stats;
+        emit finished(generation, result, heights, workingMatrix);
+    }
+}
+
+void SolverScheduler::publish() {
+    if (!running || runningGeneration != latestGeneration)
+        return;
+    vector<GridRegion> regions;
+    {
+        QMutexLocker locker(&running->mutex);
+        regions.swap(running->regions);
+    }
+    if (!regions.empty())
+        emit regionsSolved(runningGeneration, regions);
+    const SolveControl& control = running->control;
+    emit progress(runningGeneration, control.done.load(memory_order_relaxed), control.total.load(memory_order_relaxed));
+}
@@ -0,0 +1,152 @@
+#ifndef SOLVERSCHEDULER_H
+#define SOLVERSCHEDULER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QMutex>
+#include <memory>
+#include "heightgrid.h"
+#include "solvecontrol.h"
+#include "solverstats.h"
+#include "solvecache.h"
+#include "incrementalwatervolumesolver.h"
+
+/**
+ * @brief Класс SolverScheduler запускает решения в фоновом пуле потоков.
+ * Одновременно выполняется не больше одного решения: новый запрос отменяет текущее,
+ * а пока оно останавливается, ждет только самый свежий запрос (серия нажатий сливается в одно решение).
+ * Каждый запрос получает номер поколения; результаты устаревших поколений не отправляются.
+ * Прогресс и готовые блоки уровней текущего решения опрашиваются таймером и отправляются пачками
+ * не чаще раза в progressInterval мс, поэтому интерфейс видит результат задолго до конца решения.
+ * Решения запоминаются в кэше по содержимому матрицы: повторное решение той же матрицы
+ * стоит одного хэширования и отправляется одним блоком.
+ * Правки клеток применяются к прошлому решению в том же пуле, по порядку запросов; их результаты
+ * отправляются, пока после них не запрошено полное решение или отмена.
+ */
+class SolverScheduler : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @brief Конструктор класса SolverScheduler.
+     * @param threads Количество потоков решателя (0 - по числу ядер).
+     * @param parent Родительский объект.
+     */
+    explicit SolverScheduler(int threads = 0, QObject* parent = nullptr);
+
+    /**
+     * @brief Отменяет решения и ждет остановки пула.
+     */
+    ~SolverScheduler() override;
+
+    /**
+     * @brief Ставит решение в очередь, отменяя предыдущее.
+     * @param heights Матрица высот.
+     * @return Номер поколения запроса.
+     */
+    quint64 submit(SharedGrid heights);
+
+    /**
+     * @brief Ставит в очередь применение правок к прошлому решению, отменяя полное решение.
+     * Пока правки применяются, решатель нельзя использовать из других потоков.
+     * @param solver Решатель с прошлым решением.
+     * @param edits Правки клеток.
+     * @return Номер поколения запроса.
+     */
+    quint64 update(shared_ptr<IncrementalWaterVolumeSolver> solver, vector<CellEdit> edits);
+
+    /**
+     * @brief Отменяет текущее и ожидающее решения и правки; их результаты не будут отправлены.
+     */
+    void cancel();
+
+    /**
+     * @brief Возвращает счетчики решения, отправленного последним сигналом finished.
+     */
+    const SolverStats& stats() const { return lastStats; }
+
+    /**
+     * @brief Возвращает кэш решений (например, чтобы включить дисковый уровень).
+     */
+    SolveCache& cache() { return solveCache; }
+
+    static const int progressInterval = 100; /**< Наименьший промежуток между сигналами прогресса, мс. */
+
+signals:
+    /**
+     * @brief Сигнал о ходе решения.
+     * @param generation Номер поколения решения.
+     * @param done Количество пройденных клеток.
+     * @param total Сколько клеток нужно пройти всего.
+     */
+    void progress(quint64 generation, qint64 done, qint64 total);
+
+    /**
+     * @brief Сигнал с блоками, уровни воды в которых уже окончательные.
+     * @param generation Номер поколения решения.
+     * @param regions Готовые блоки с уровнями воды.
+     */
+    void regionsSolved(quint64 generation, const vector<GridRegion>& regions);
+
+    /**
+     * @brief Сигнал, отправляемый по завершению последнего запрошенного решения.
+     * @param generation Номер поколения решения.
+     * @param result Результат вычислений.
+     * @param heights Матрица высот, для которой выполнены вычисления.
+     * @param workingMatrix Матрица с уровнями воды после вычислений.
+     */
+    void finished(quint64 generation, ll result, SharedGrid heights, SharedGrid workingMatrix);
+
+    /**
+     * @brief Сигнал, отправляемый после применения правок к прошлому решению.
+     * @param generation Номер поколения запроса.
+     * @param result Новый объем воды.
+     * @param changes Клетки, уровень которых изменился, и все правленые клетки.
+     */
+    void editsApplied(quint64 generation, ll result, const vector<CellChange>& changes);
+
+private slots:
+    /**
+     * @brief Отправляет накопленные блоки и прогресс текущего решения.
+     */
+    void publish();
+
+private:
+    /**
+     * @brief Состояние выполняемого решения, общее для основного потока и пула.
+     */
+    struct RunningJob {
+        SolveControl control; /**< Флаг отмены и счетчик прогресса. */
+        QMutex mutex; /**< Защищает regions. */
+        vector<GridRegion> regions; /**< Готовые блоки, еще не отправленные в интерфейс. */
+    };
+
+    int threads; /**< Количество потоков решателя. */
+    QThreadPool pool; /**< Пул для решений; блоки сетки распределяет по ядрам сам решатель. */
+    QTimer progressTimer; /**< Таймер опроса прогресса. */
+    quint64 latestGeneration = 0; /**< Номер поколения последнего запроса. */
+    quint64 runningGeneration = 0; /**< Номер поколения выполняемого решения. */
+    quint64 resetGeneration = 0; /**< Номер последнего полного решения или отмены; правки до него не отправляются. */
+    shared_ptr<RunningJob> running; /**< Состояние выполняемого решения (пусто, если пул свободен). */
+    SharedGrid queued; /**< Матрица высот, ожидающая окончания текущего решения. */
+    SolverStats lastStats; /**< Счетчики последнего отправленного решения. */
+    SolveCache solveCache; /**< Кэш решений с рабочими матрицами; его читают и пополняют задачи пула. */
+
+    /**
+     * @brief Запускает решение последнего запроса в пуле.
+     * @param heights Матрица высот.
+     */
+    void start(SharedGrid heights);
+
+    /**
+     * @brief Обрабатывает окончание решения в основном потоке.
+     * @param generation Номер поколения решения.
+     * @param result Результат вычислений или -1, если решение отменено.
+     * @param heights Матрица высот.
+     * @param workingMatrix Матрица с уровнями воды.
+     * @param stats Счетчики решения.
+     */
+    void handleJobDone(quint64 generation, ll result, SharedGrid heights, SharedGrid workingMatrix, const SolverStats& stats);
+};
+
+#endif // SOLVERSCHEDULER_H
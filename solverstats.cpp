@@ -0,0 +1,62 @@
+#include "solverstats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * @brief Добавляет счетчики другого решения: суммы складываются, пики берутся наибольшие.
+ * Время этапов не складывается: части параллельного решения идут одновременно, и его этапы измеряет сам решатель.
+ * @param other Счетчики другого решения.
+ */
+void SolverStats::merge(const SolverStats& other) {
+    queuePushes += other.queuePushes;
+    queuePops += other.queuePops;
+    queuePeak = max(queuePeak, other.queuePeak);
+    cellsFlooded += other.cellsFlooded;
+    maxDepth = max(maxDepth, other.maxDepth);
+}
+
+/**
+ * @brief Записывает счетчики одним объектом JSON.
+ * @param stats Счетчики.
+ * @param engine Название алгоритма.
+ */
+string statsToJson(const SolverStats& stats, const string& engine) {
+    char line[512];
+    snprintf(line, sizeof(line),
+             "{\"engine\":\"%s\",\"rows\":%d,\"cols\":%d,\"queue_pushes\":%lld,\"queue_pops\":%lld,\"queue_peak\":%lld,"
+             "\"cells_flooded\":%lld,\"max_depth\":%lld,\"setup_seconds\":%.6f,\"flood_seconds\":%.6f,\"output_seconds\":%.6f}",
+             engine.c_str(), stats.rows, stats.cols, stats.queuePushes, stats.queuePops, stats.queuePeak,
+             stats.cellsFlooded, stats.maxDepth, stats.setupSeconds, stats.floodSeconds, stats.outputSeconds);
+    return line;
+}
+
+/**
+ * @brief Записывает этапы решения как события Trace Event Format.
+ * Время в трассе - микросекунды от начала решения.
+ * @param stats Счетчики.
+ * @param engine Название алгоритма.
+ * @return Массив JSON с событиями.
+ */
+string statsToTraceEvents(const SolverStats& stats, const string& engine) {
+    const char* names[3] = {"setup", "flood", "output"};
+    double durations[3] = {stats.setupSeconds, stats.floodSeconds, stats.outputSeconds};
+    string out = "[";
+    char line[512];
+    snprintf(line, sizeof(line),
+             "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"%s %dx%d\"}},\n"
+             "{\"name\":\"queue\",\"ph\":\"C\",\"ts\":0,\"pid\":1,\"tid\":1,\"args\":{\"pushes\":%lld,\"pops\":%lld,\"peak\":%lld}},\n"
+             "{\"name\":\"cells\",\"ph\":\"C\",\"ts\":0,\"pid\":1,\"tid\":1,\"args\":{\"flooded\":%lld,\"max_depth\":%lld}}",
+             engine.c_str(), stats.rows, stats.cols, stats.queuePushes, stats.queuePops, stats.queuePeak,
+             stats.cellsFlooded, stats.maxDepth);
+    out += line;
+    double ts = 0;
+    for (int k = 0; k < 3; k++) {
+        snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+                 names[k], ts * 1e6, durations[k] * 1e6);
+        out += line;
+        ts += durations[k];
+    }
+    out += "]\n";
+    return out;
+}
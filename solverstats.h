@@ -0,0 +1,87 @@
+#ifndef SOLVERSTATS_H
+#define SOLVERSTATS_H
+
+#include <chrono>
+#include <string>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Счетчики горячего пути и время этапов решения.
+ * Заполняются, только если библиотека собрана с WATERCUBOIDS_STATS (опция CMake с тем же именем);
+ * без нее код счетчиков не компилируется, а все поля остаются нулями.
+ */
+struct SolverStats {
+    int rows = 0; /**< Количество строк в матрице. */
+    int cols = 0; /**< Количество столбцов в матрице. */
+    ll queuePushes = 0; /**< Добавления в очередь с приоритетом. */
+    ll queuePops = 0; /**< Извлечения из очереди с приоритетом. */
+    ll queuePeak = 0; /**< Наибольший размер очереди. */
+    ll cellsFlooded = 0; /**< Клетки, над которыми стоит вода. */
+    ll maxDepth = 0; /**< Наибольшая глубина обхода: рекурсии поиска в глубину или стека затопленных клеток. */
+    double setupSeconds = 0; /**< Подготовка: рабочая сетка, очередь, граничные клетки. */
+    double floodSeconds = 0; /**< Заполнение. */
+    double outputSeconds = 0; /**< Выдача рабочей матрицы. */
+
+    /**
+     * @brief Проверяет, собраны ли счетчики в библиотеку.
+     */
+    static constexpr bool enabled() {
+#ifdef WATERCUBOIDS_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Добавляет счетчики другого решения (например, блока): суммы складываются, пики берутся наибольшие.
+     * Время этапов не меняется.
+     * @param other Счетчики другого решения.
+     */
+    void merge(const SolverStats& other);
+};
+
+/**
+ * @brief Оставляет код счетчиков только в сборке с WATERCUBOIDS_STATS.
+ */
+#ifdef WATERCUBOIDS_STATS
+#define SOLVER_STATS(...) __VA_ARGS__
+#else
+#define SOLVER_STATS(...)
+#endif
+
+/**
+ * @brief Секундомер для полей времени SolverStats.
+ */
+class StatsClock {
+public:
+    StatsClock() : start(chrono::steady_clock::now()) {}
+
+    /**
+     * @brief Возвращает секунды с момента создания.
+     */
+    double seconds() const { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); }
+
+private:
+    chrono::steady_clock::time_point start; /**< Момент создания. */
+};
+
+/**
+ * @brief Записывает счетчики одним объектом JSON.
+ * @param stats Счетчики.
+ * @param engine Название алгоритма (попадает в поле "engine").
+ */
+string statsToJson(const SolverStats& stats, const string& engine);
+
+/**
+ * @brief Записывает этапы решения как события Trace Event Format (chrome://tracing, Perfetto).
+ * Этапы идут друг за другом полными событиями "X", счетчики - событием "C" в начале решения.
+ * @param stats Счетчики.
+ * @param engine Название алгоритма (имя процесса в трассе).
+ * @return Массив JSON с событиями.
+ */
+string statsToTraceEvents(const SolverStats& stats, const string& engine);
+
+#endif // SOLVERSTATS_H
@@ -0,0 +1,449 @@
+#include "streamingwatervolumesolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <queue>
+#include <thread>
+
+namespace {
+
+/**
+ * @brief Ребра графа переливов, выдаваемые по возрастанию уровня.
+ * Ребра копятся в буфере; заполненный буфер сортируется и дописывается во временный файл
+ * серией. При чтении серии сливаются, и каждая читается своей долей того же буфера.
+ * Если все ребра поместились в буфер, файл не создается.
+ */
+class SpillEdgeRuns {
+public:
+    /**
+     * @param capacity Размер буфера в ребрах.
+     * @param fileName Временный файл для серий; удаляется в деструкторе.
+     */
+    SpillEdgeRuns(size_t capacity, const string& fileName) : capacity(capacity), fileName(fileName) {
+        buffer.reserve(capacity);
+    }
+
+    ~SpillEdgeRuns() {
+        if (file.is_open()) {
+            file.close();
+            error_code error;
+            filesystem::remove(fileName, error);
+        }
+    }
+
+    /**
+     * @brief Добавляет ребро.
+     * @return false, если серию не удалось записать.
+     */
+    bool add(int a, int b, int level) {
+        buffer.push_back(SpillEdge{min(a, b), max(a, b), level});
+        return buffer.size() < capacity || spill();
+    }
+
+    /**
+     * @brief Передает все ребра в visit по возрастанию уровня.
+     * @return false, если серию не удалось прочитать.
+     */
+    template <class Visit>
+    bool forEach(Visit visit) {
+        auto byLevel = [](const SpillEdge& a, const SpillEdge& b) { return a.level < b.level; };
+        if (runs.empty()) {
+            sort(buffer.begin(), buffer.end(), byLevel);
+            for (const SpillEdge& e : buffer)
+                visit(e);
+            return true;
+        }
+        if (!buffer.empty() && !spill())
+            return false;
+        size_t share = max(capacity / runs.size(), (size_t)1024);
+        buffer.resize(share * runs.size());
+        vector<size_t> position(runs.size()), end(runs.size());
+        priority_queue<pii, vector<pii>, greater<pii>> heads;
+        auto refill = [&](size_t r) {
+            Run& run = runs[r];
+            size_t count = (size_t)min((uint64_t)share, run.count);
+            file.seekg((streamoff)(run.offset * sizeof(SpillEdge)));
+            if (!file.read(reinterpret_cast<char*>(&buffer[r * share]), count * sizeof(SpillEdge)))
+                return false;
+            run.offset += count;
+            run.count -= count;
+            position[r] = r * share;
+            end[r] = r * share + count;
+            heads.push({buffer[position[r]].level, (int)r});
+            return true;
+        };
+        for (size_t r = 0; r < runs.size(); r++) {
+            if (!refill(r))
+                return false;
+        }
+        while (!heads.empty()) {
+            size_t r = heads.top().second;
+            heads.pop();
+            visit(buffer[position[r]]);
+            if (++position[r] < end[r])
+                heads.push({buffer[position[r]].level, (int)r});
+            else if (runs[r].count > 0 && !refill(r))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    /**
+     * @brief Серия во временном файле.
+     */
+    struct Run {
+        uint64_t offset; /**< Первое непрочитанное ребро серии (в ребрах от начала файла). */
+        uint64_t count; /**< Количество непрочитанных ребер. */
+    };
+
+    size_t capacity; /**< Размер буфера в ребрах. */
+    string fileName; /**< Временный файл. */
+    vector<SpillEdge> buffer; /**< Ребра текущей серии, при чтении - доли серий. */
+    vector<Run> runs; /**< Записанные серии. */
+    fstream file; /**< Открытый временный файл. */
+    uint64_t fileEdges = 0; /**< Количество ребер в файле. */
+
+    /**
+     * @brief Сортирует буфер и дописывает его в файл серией.
+     */
+    bool spill() {
+        sort(buffer.begin(), buffer.end(), [](const SpillEdge& a, const SpillEdge& b) { return a.level < b.level; });
+        if (!file.is_open()) {
+            file.open(fileName, ios::in | ios::out | ios::binary | ios::trunc);
+            if (!file)
+                return false;
+        }
+        file.seekp((streamoff)(fileEdges * sizeof(SpillEdge)));
+        if (!file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(SpillEdge)) || !file.flush())
+            return false;
+        runs.push_back(Run{fileEdges, buffer.size()});
+        fileEdges += buffer.size();
+        buffer.clear();
+        return true;
+    }
+};
+
+/**
+ * @brief Вычисляет уровни меток графа переливов алгоритмом Краскала.
+ * Ребра приходят по возрастанию уровня; метка labelCount - край сетки. Когда ребро впервые
+ * присоединяет множество меток к множеству края, уровень ребра записывается в корень
+ * присоединенного множества. Пути в лесе не сжимаются (объединение по рангу держит их
+ * короткими), поэтому уровень метки - первый записанный уровень на пути от нее к корню.
+ * @param labelCount Количество меток.
+ * @param runs Ребра между метками и ребра меток края к метке labelCount.
+ * @param level Уровень воды для каждой метки.
+ * @return false, если ребра не удалось прочитать.
+ */
+bool resolveSpillRuns(int labelCount, SpillEdgeRuns& runs, vector<int>& level) {
+    const uint8_t joined = 0x80; // Флаг записанного уровня; младшие биты - ранг
+    vector<int> parent(labelCount + 1);
+    vector<uint8_t> state(labelCount + 1, 0);
+    iota(parent.begin(), parent.end(), 0);
+    level.assign(labelCount + 1, INT_MAX);
+    state[labelCount] = joined;
+    int shore = labelCount;
+    auto findRoot = [&](int x) {
+        while (parent[x] != x)
+            x = parent[x];
+        return x;
+    };
+    bool read = runs.forEach([&](const SpillEdge& e) {
+        int a = findRoot(e.from), b = findRoot(e.to);
+        if (a == b)
+            return;
+        if (a == shore) {
+            level[b] = e.level;
+            state[b] |= joined;
+        } else if (b == shore) {
+            level[a] = e.level;
+            state[a] |= joined;
+        }
+        if ((state[a] & ~joined) < (state[b] & ~joined))
+            swap(a, b);
+        parent[b] = a;
+        if ((state[a] & ~joined) == (state[b] & ~joined))
+            state[a]++;
+        if (b == shore)
+            shore = a;
+    });
+    if (!read)
+        return false;
+
+    // Найденный уровень записывается всем меткам пути, чтобы следующие подъемы были короче
+    vector<int> path;
+    for (int x = 0; x < labelCount; x++) {
+        int y = x;
+        while (!(state[y] & joined) && parent[y] != y) {
+            path.push_back(y);
+            y = parent[y];
+        }
+        for (int z : path) {
+            level[z] = level[y];
+            state[z] |= joined;
+        }
+        path.clear();
+    }
+    level.pop_back();
+    return true;
+}
+
+}
+
+/**
+ * @brief Конструктор класса StreamingWaterVolumeSolver.
+ * @param inputFile Файл сетки с высотами.
+ * @param outputFile Файл сетки для уровней воды (пустая строка - не записывать).
+ * @param memoryLimit Ориентировочный предел памяти в байтах, по нему выбирается сторона блока.
+ */
+StreamingWaterVolumeSolver::StreamingWaterVolumeSolver(const string& inputFile, const string& outputFile, size_t memoryLimit)
+    : inputName(inputFile), outputName(outputFile), memoryLimit(memoryLimit) {
+    memset(&header, 0, sizeof(header));
+}
+
+/**
+ * @brief Возвращает координаты и размер блока.
+ * @param t Номер блока.
+ * @param r0 Первая строка блока.
+ * @param c0 Первый столбец блока.
+ * @param th Количество строк в блоке.
+ * @param tw Количество столбцов в блоке.
+ */
+void StreamingWaterVolumeSolver::tileRect(int t, int& r0, int& c0, int& th, int& tw) const {
+    r0 = t / tileCols * tileSide;
+    c0 = t % tileCols * tileSide;
+    th = min(tileSide, rowsMatrix - r0);
+    tw = min(tileSide, colsMatrix - c0);
+}
+
+/**
+ * @brief Читает блок высот из входного файла.
+ * @param in Входной файл.
+ * @param t Номер блока.
+ * @param heights Буфер высот блока (строки подряд, шаг - ширина блока).
+ * @return true, если блок прочитан, иначе false.
+ */
+bool StreamingWaterVolumeSolver::readTile(ifstream& in, int t, vector<int>& heights) {
+    int r0, c0, th, tw;
+    tileRect(t, r0, c0, th, tw);
+    int width = header.elementWidth;
+    heights.resize((size_t)th * tw);
+    rowBuffer.resize((size_t)tw * width);
+    for (int i = 0; i < th; i++) {
+        in.seekg((streamoff)(header.dataOffset + ((uint64_t)(r0 + i) * colsMatrix + c0) * width));
+        if (!in.read(rowBuffer.data(), rowBuffer.size()))
+            return false;
+        int* row = &heights[(size_t)i * tw];
+        for (int j = 0; j < tw; j++) {
+            if (width == 1) {
+                int8_t v;
+                memcpy(&v, &rowBuffer[j], 1);
+                row[j] = v;
+            } else if (width == 2) {
+                int16_t v;
+                memcpy(&v, &rowBuffer[(size_t)j * 2], 2);
+                row[j] = v;
+            } else {
+                int32_t v;
+                memcpy(&v, &rowBuffer[(size_t)j * 4], 4);
+                row[j] = v;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Пишет блок уровней воды в выходной файл.
+ * Уровень воды не выше наибольшей высоты, поэтому помещается в ширину входного файла.
+ * @param out Выходной файл.
+ * @param t Номер блока.
+ * @param levels Уровни воды блока.
+ * @return true, если блок записан, иначе false.
+ */
+bool StreamingWaterVolumeSolver::writeTile(ofstream& out, int t, const vector<int>& levels) {
+    int r0, c0, th, tw;
+    tileRect(t, r0, c0, th, tw);
+    int width = header.elementWidth;
+    rowBuffer.resize((size_t)tw * width);
+    for (int i = 0; i < th; i++) {
+        const int* row = &levels[(size_t)i * tw];
+        for (int j = 0; j < tw; j++) {
+            if (width == 1) {
+                int8_t v = (int8_t)row[j];
+                memcpy(&rowBuffer[j], &v, 1);
+            } else if (width == 2) {
+                int16_t v = (int16_t)row[j];
+                memcpy(&rowBuffer[(size_t)j * 2], &v, 2);
+            } else {
+                int32_t v = row[j];
+                memcpy(&rowBuffer[(size_t)j * 4], &v, 4);
+            }
+        }
+        out.seekp((streamoff)(header.dataOffset + ((uint64_t)(r0 + i) * colsMatrix + c0) * width));
+        if (!out.write(rowBuffer.data(), rowBuffer.size()))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Выбирает сторону блока так, чтобы блок и метки графа переливов поместились в предел памяти.
+ * Блоку нужно около 40 байт на клетку (высоты, уровни и метки решателя, рабочая сетка, очередь и стек
+ * TileFlooder), разрешению графа - 9 байт на метку периметра, буферу ребер - восьмая часть предела.
+ * Чем больше блок, тем меньше меток, поэтому берется наибольшая сторона, при которой блок и метки
+ * вместе занимают не больше трех четвертей предела; если такой нет (сетка слишком велика для
+ * предела), берется сторона с наименьшей суммой.
+ */
+void StreamingWaterVolumeSolver::chooseTileSide() {
+    const double tileCellBytes = 40;
+    const double labelBytes = 9;
+    double budget = (double)memoryLimit * 3 / 4 - (double)colsMatrix * sizeof(int);
+    int side = (int)sqrt(max(budget, 0.0) / tileCellBytes);
+    side = max(8, min(side, min(max(rowsMatrix, colsMatrix), 1 << 16)));
+    double bestBytes = HUGE_VAL;
+    for (int s = side; s >= 8; s--) {
+        double rowsOfTiles = ceil((double)rowsMatrix / s);
+        double colsOfTiles = ceil((double)colsMatrix / s);
+        double labels = 2.0 * ((double)rowsMatrix * colsOfTiles + (double)colsMatrix * rowsOfTiles);
+        double bytes = tileCellBytes * s * s + labelBytes * labels + sizeof(int) * rowsOfTiles * colsOfTiles;
+        if (bytes < bestBytes) {
+            bestBytes = bytes;
+            tileSide = s;
+        }
+        if (bytes <= budget)
+            break;
+    }
+}
+
+/**
+ * @brief Решает задачу о объеме воды.
+ * @return Объем воды, который можно собрать, или -1 при ошибке чтения или записи.
+ */
+ll StreamingWaterVolumeSolver::solve() {
+    ifstream in(inputName, ios::binary);
+    if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) || !isGridFile(&header, sizeof(header))
+            || header.version != gridFileVersion || header.rows == 0 || header.cols == 0
+            || header.rows > INT_MAX || header.cols > INT_MAX
+            || (header.elementWidth != 1 && header.elementWidth != 2 && header.elementWidth != 4))
+        return -1;
+    rowsMatrix = (int)header.rows;
+    colsMatrix = (int)header.cols;
+
+    chooseTileSide();
+    tileRows = (rowsMatrix + tileSide - 1) / tileSide;
+    tileCols = (colsMatrix + tileSide - 1) / tileSide;
+    int tiles = tileRows * tileCols;
+    labelBase.assign(tiles + 1, 0);
+    for (int t = 0; t < tiles; t++) {
+        int r0, c0, th, tw;
+        tileRect(t, r0, c0, th, tw);
+        if ((ll)labelBase[t] + tilePerimeter(th, tw) >= INT_MAX)
+            return -1;
+        labelBase[t + 1] = labelBase[t] + tilePerimeter(th, tw);
+    }
+    // Метка после меток периметров - край сетки
+    int shore = labelBase[tiles];
+
+    // Ребра пишутся рядом с выходным файлом: временный каталог может оказаться в памяти
+    error_code error;
+    string edgesName = outputName.empty() ? (filesystem::temp_directory_path(error) / "watercuboids").string() : outputName;
+    edgesName += ".edges" + to_string(hash<thread::id>()(this_thread::get_id()))
+            + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count());
+    SpillEdgeRuns runs(max((size_t)1024, memoryLimit / 8 / sizeof(SpillEdge)), edgesName);
+
+    // Первый проход: заполняем блоки; ребра к соседям слева и сверху строятся по сохраненному
+    // правому столбцу предыдущего блока и нижней строке блоков предыдущего ряда
+    auto label = [&](int row, int col) {
+        int t = row / tileSide * tileCols + col / tileSide;
+        int r0, c0, th, tw;
+        tileRect(t, r0, c0, th, tw);
+        return labelBase[t] + tilePerimeterIndex(row - r0, col - c0, th, tw);
+    };
+    TileFlooder flooder;
+    vector<int> heights, levels, labels;
+    vector<SpillEdge> tileEdges;
+    vector<int> bottomRow(colsMatrix), rightColumn(tileSide);
+    bool written = true;
+    for (int t = 0; t < tiles && written; t++) {
+        int r0, c0, th, tw;
+        tileRect(t, r0, c0, th, tw);
+        if (!readTile(in, t, heights))
+            return -1;
+        levels.resize(heights.size());
+        labels.resize(heights.size());
+        tileEdges.clear();
+        flooder.flood(heights.data(), levels.data(), labels.data(), tw, th, tw, labelBase[t], tileEdges);
+        for (const SpillEdge& e : tileEdges)
+            written = written && runs.add(e.from, e.to, e.level);
+
+        auto at = [&](int i, int j) { return (size_t)i * tw + j; };
+        for (int i = 0; i < th; i++) {
+            int left = labels[at(i, 0)], right = labels[at(i, tw - 1)];
+            if (c0 > 0)
+                written = written && runs.add(label(r0 + i, c0 - 1), left, max(rightColumn[i], heights[at(i, 0)]));
+            else
+                written = written && runs.add(left, shore, heights[at(i, 0)]);
+            if (c0 + tw == colsMatrix)
+                written = written && runs.add(right, shore, heights[at(i, tw - 1)]);
+            rightColumn[i] = heights[at(i, tw - 1)];
+        }
+        for (int j = 0; j < tw; j++) {
+            int top = labels[at(0, j)], bottom = labels[at(th - 1, j)];
+            if (r0 > 0)
+                written = written && runs.add(label(r0 - 1, c0 + j), top, max(bottomRow[c0 + j], heights[at(0, j)]));
+            else
+                written = written && runs.add(top, shore, heights[at(0, j)]);
+            if (r0 + th == rowsMatrix)
+                written = written && runs.add(bottom, shore, heights[at(th - 1, j)]);
+            bottomRow[c0 + j] = heights[at(th - 1, j)];
+        }
+    }
+    // Буферы блока не нужны, пока решается граф
+    vector<int>().swap(heights);
+    vector<int>().swap(levels);
+    vector<int>().swap(labels);
+    vector<int>().swap(bottomRow);
+    vector<int> labelLevel;
+    if (!written || !resolveSpillRuns(shore, runs, labelLevel))
+        return -1;
+
+    ofstream out;
+    if (!outputName.empty()) {
+        out.open(outputName, ios::binary | ios::trunc);
+        vector<char> block(header.dataOffset, 0);
+        memcpy(block.data(), &header, sizeof(header));
+        if (!out || !out.write(block.data(), block.size()))
+            return -1;
+    }
+
+    // Второй проход: заполнение блоков детерминировано, поэтому метки совпадают с первым проходом
+    ll volume = 0;
+    for (int t = 0; t < tiles; t++) {
+        int r0, c0, th, tw;
+        tileRect(t, r0, c0, th, tw);
+        if (!readTile(in, t, heights))
+            return -1;
+        levels.resize(heights.size());
+        labels.resize(heights.size());
+        tileEdges.clear();
+        flooder.flood(heights.data(), levels.data(), labels.data(), tw, th, tw, labelBase[t], tileEdges);
+        for (size_t u = 0; u < heights.size(); u++) {
+            levels[u] = max(levels[u], labelLevel[labels[u]]);
+            volume += (ll)levels[u] - heights[u];
+        }
+        if (!outputName.empty() && !writeTile(out, t, levels))
+            return -1;
+    }
+    if (!outputName.empty()) {
+        out.close();
+        if (!out)
+            return -1;
+    }
+    return volume;
+}
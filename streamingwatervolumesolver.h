@@ -0,0 +1,83 @@
+#ifndef STREAMINGWATERVOLUMESOLVER_H
+#define STREAMINGWATERVOLUMESOLVER_H
+
+#include "gridfile.h"
+#include "tileflood.h"
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Класс StreamingWaterVolumeSolver решает задачу для сеток, которые не помещаются в память.
+ * Сетка читается из файла сетки блоками. Первый проход заполняет каждый блок (TileFlooder) и выдает
+ * ребра графа переливов между метками периметров блоков; ребра копятся в буфере и, когда он
+ * заполняется, уходят во временный файл отсортированными по уровню сериями. Граф решается слиянием
+ * серий по возрастанию уровня (алгоритм Краскала с системой непересекающихся множеств), так что
+ * в памяти держится только 9 байт на метку, а не списки смежности. Второй проход заново заполняет
+ * каждый блок и пишет итоговые уровни воды в выходной файл блок за блоком. Объем совпадает
+ * с решением в памяти.
+ */
+class StreamingWaterVolumeSolver {
+public:
+    /**
+     * @brief Конструктор класса StreamingWaterVolumeSolver.
+     * @param inputFile Файл сетки с высотами.
+     * @param outputFile Файл сетки для уровней воды (пустая строка - не записывать).
+     * @param memoryLimit Предел памяти в байтах: по нему выбираются сторона блока и размер буфера ребер.
+     */
+    StreamingWaterVolumeSolver(const string& inputFile, const string& outputFile, size_t memoryLimit = (size_t)512 << 20);
+
+    /**
+     * @brief Решает задачу о объеме воды.
+     * @return Объем воды, который можно собрать, или -1 при ошибке чтения или записи.
+     */
+    ll solve();
+
+    /**
+     * @brief Возвращает выбранную сторону блока (после вызова solve()).
+     */
+    int tileSize() const { return tileSide; }
+
+private:
+    string inputName; /**< Файл сетки с высотами. */
+    string outputName; /**< Файл сетки для уровней воды. */
+    size_t memoryLimit; /**< Предел памяти в байтах. */
+    GridFileHeader header; /**< Заголовок входного файла. */
+    int rowsMatrix = 0; /**< Количество строк в матрице. */
+    int colsMatrix = 0; /**< Количество столбцов в матрице. */
+    int tileSide = 0; /**< Сторона блока. */
+    int tileRows = 0; /**< Количество блоков по вертикали. */
+    int tileCols = 0; /**< Количество блоков по горизонтали. */
+    vector<int> labelBase; /**< Метка первой клетки периметра каждого блока. */
+    vector<char> rowBuffer; /**< Буфер строки блока в формате файла. */
+
+    /**
+     * @brief Выбирает сторону блока так, чтобы блок и метки графа переливов поместились в предел памяти.
+     */
+    void chooseTileSide();
+
+    /**
+     * @brief Читает блок высот из входного файла.
+     * @param in Входной файл.
+     * @param t Номер блока.
+     * @param heights Буфер высот блока (строки подряд, шаг - ширина блока).
+     * @return true, если блок прочитан, иначе false.
+     */
+    bool readTile(ifstream& in, int t, vector<int>& heights);
+
+    /**
+     * @brief Пишет блок уровней воды в выходной файл.
+     * @param out Выходной файл.
+     * @param t Номер блока.
+     * @param levels Уровни воды блока.
+     * @return true, если блок записан, иначе false.
+     */
+    bool writeTile(ofstream& out, int t, const vector<int>& levels);
+
+    void tileRect(int t, int& r0, int& c0, int& th, int& tw) const;
+};
+
+#endif // STREAMINGWATERVOLUMESOLVER_H
@@ -0,0 +1,477 @@
+#include "stresstests.h"
+#include "watervolumesolver.h"
+#include "parallelwatervolumesolver.h"
+#include "reconstructionwatervolumesolver.h"
+#include "typedwatervolumesolver.h"
+#include "incrementalwatervolumesolver.h"
+#include "streamingwatervolumesolver.h"
+#include "gridbatch.h"
+#include "gridfile.h"
+#include "terraingenerator.h"
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef vector<vector<int>> Matrix;
+
+/**
+ * @brief Решение сетки: объем и уровни воды.
+ */
+struct Solution {
+    ll volume = 0; /**< Объем воды. */
+    Matrix levels; /**< Уровни воды (пусто - решатель выдает только объем). */
+};
+
+/**
+ * @brief Проверяемый решатель.
+ */
+struct Engine {
+    string name; /**< Имя в отчете. */
+    function<Solution(const Matrix&)> solve; /**< Решает сетку. */
+};
+
+/**
+ * @brief Сетка как построчный буфер для решателей, принимающих GridView.
+ */
+vector<int> flatten(const Matrix& grid) {
+    vector<int> heights;
+    for (const vector<int>& row : grid)
+        heights.insert(heights.end(), row.begin(), row.end());
+    return heights;
+}
+
+/**
+ * @brief Эталон: заполнение релаксацией.
+ * Граничные клетки стоят на своей высоте, внутренние начинают с наибольшей высоты сетки;
+ * прямой и обратный проходы опускают уровень до max(высота, наименьший уровень соседа),
+ * пока он где-нибудь меняется. Медленно, но без очередей и особых случаев.
+ */
+Solution relaxationOracle(const Matrix& heights) {
+    int rows = heights.size();
+    int cols = heights[0].size();
+    int top = INT_MIN;
+    for (const vector<int>& row : heights)
+        top = max(top, *max_element(row.begin(), row.end()));
+
+    Solution solution;
+    solution.levels = heights;
+    for (int i = 1; i < rows - 1 && cols > 2; i++)
+        fill(solution.levels[i].begin() + 1, solution.levels[i].end() - 1, top);
+    Matrix& level = solution.levels;
+    auto relax = [&](int i, int j) {
+        int lowest = min(min(level[i - 1][j], level[i + 1][j]), min(level[i][j - 1], level[i][j + 1]));
+        int next = max(heights[i][j], lowest);
+        if (next >= level[i][j])
+            return false;
+        level[i][j] = next;
+        return true;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 1; i < rows - 1; i++) {
+            for (int j = 1; j < cols - 1; j++)
+                changed |= relax(i, j);
+        }
+        for (int i = rows - 2; i >= 1; i--) {
+            for (int j = cols - 2; j >= 1; j--)
+                changed |= relax(i, j);
+        }
+    }
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++)
+            solution.volume += (ll)level[i][j] - heights[i][j];
+    }
+    return solution;
+}
+
+/**
+ * @brief Последовательный решатель с заданными очередью, алгоритмом и раскладкой сетки.
+ */
+template <class Queue>
+Solution solveSerial(const Matrix& heights, SolverEngine engine, GridLayout layout) {
+    Matrix matrix = heights;
+    BasicWaterVolumeSolver<Queue> solver(matrix.size(), matrix[0].size(), matrix, layout);
+    solver.setEngine(engine);
+    Solution solution;
+    solution.volume = solver.solve();
+    solution.levels = solver.getWorkingMatrix();
+    return solution;
+}
+
+/**
+ * @brief Решатель с разметкой озер: объем - сумма объемов озер, у сухих клеток не должно быть номера.
+ * Несогласованная разметка дает объем -1.
+ */
+Solution solveLabelled(const Matrix& heights, SolverEngine engine) {
+    Matrix matrix = heights;
+    WaterVolumeSolver solver(matrix.size(), matrix[0].size(), matrix, GridLayout::Tiled);
+    solver.setEngine(engine);
+    solver.setBasinLabelling(true);
+    solver.solve();
+    Solution solution;
+    solution.levels = solver.getWorkingMatrix();
+    for (const Basin& basin : solver.basins())
+        solution.volume += basin.volume;
+    Matrix labels = solver.getBasinMatrix();
+    for (size_t i = 0; i < heights.size(); i++) {
+        for (size_t j = 0; j < heights[i].size(); j++) {
+            if ((labels[i][j] >= 0) != (solution.levels[i][j] > heights[i][j]))
+                solution.volume = -1;
+        }
+    }
+    return solution;
+}
+
+Solution solveParallel(const Matrix& heights, int threads, int tileSize) {
+    ParallelWaterVolumeSolver solver(heights.size(), heights[0].size(), heights, threads, tileSize);
+    Solution solution;
+    solution.volume = solver.solve();
+    solution.levels = solver.getWorkingMatrix();
+    return solution;
+}
+
+Solution solveReconstruction(const Matrix& heights, SimdKernel kernel) {
+    ReconstructionWaterVolumeSolver solver(heights.size(), heights[0].size(), heights);
+    solver.setKernel(kernel);
+    Solution solution;
+    solution.volume = solver.solve();
+    solution.levels = solver.getWorkingMatrix();
+    return solution;
+}
+
+/**
+ * @brief Решатель по ширине высот: высоты записываются в ширине elementWidth (0 - наименьшей подходящей).
+ */
+Solution solveNative(const Matrix& heights, int elementWidth) {
+    int rows = heights.size();
+    int cols = heights[0].size();
+    vector<int> flat = flatten(heights);
+    GridView view(rows, cols, flat);
+    if (elementWidth == 0)
+        elementWidth = minimalElementWidth(view);
+    vector<int64_t> wide(flat.begin(), flat.end());
+    vector<int16_t> narrow(flat.begin(), flat.end());
+    vector<int8_t> byte(flat.begin(), flat.end());
+    view.elementWidth = elementWidth;
+    view.data = elementWidth == 8 ? (const void*)wide.data() : elementWidth == 2 ? (const void*)narrow.data()
+            : elementWidth == 1 ? (const void*)byte.data() : (const void*)flat.data();
+
+    Solution solution;
+    vector<vector<ll>> levels;
+    if (!solveNativeWidth(view, solution.volume, &levels))
+        solution.volume = -1;
+    solution.levels.assign(rows, vector<int>(cols));
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++)
+            solution.levels[i][j] = (int)levels[i][j];
+    }
+    return solution;
+}
+
+/**
+ * @brief Пакетный решатель (квадратные сетки до 8x8 решает решатель фиксированного размера); только объем.
+ */
+Solution solveInBatch(const Matrix& heights) {
+    vector<int> flat = flatten(heights);
+    GridBatch batch;
+    batch.add(heights.size(), heights[0].size(), flat.data());
+    Solution solution;
+    solution.volume = solveBatch(batch)[0];
+    return solution;
+}
+
+/**
+ * @brief Решатель с правками: решает искаженную сетку и правками возвращает исходные высоты.
+ * Искажения зависят только от размеров сетки, поэтому при уменьшении сетки повторяются.
+ * Правок не больше 16.
+ */
+Solution solveIncremental(const Matrix& heights) {
+    int rows = heights.size();
+    int cols = heights[0].size();
+    vector<int> flat = flatten(heights);
+    vector<int> distorted = flat;
+    vector<CellEdit> edits;
+    uint64_t seed = (uint64_t)rows << 32 | (uint32_t)cols;
+    int count = min(16, 1 + rows * cols / 4);
+    for (int k = 0; k < count; k++) {
+        int cell = (int)(terrainRandom(seed, 2 * k) % flat.size());
+        ll shift = (ll)(terrainRandom(seed, 2 * k + 1) % 7) - 3;
+        distorted[cell] = (int)max((ll)INT_MIN, min((ll)INT_MAX, (ll)flat[cell] + shift));
+        edits.push_back(CellEdit{cell / cols, cell % cols, flat[cell]});
+    }
+    IncrementalWaterVolumeSolver solver(GridView(rows, cols, distorted));
+    Solution solution;
+    solution.volume = solver.update(edits);
+    solution.levels = solver.getWorkingMatrix();
+    return solution;
+}
+
+/**
+ * @brief Потоковый решатель через временные файлы сетки; предел памяти дает блоки 8x8.
+ */
+Solution solveStreaming(const Matrix& heights, const string& directory) {
+    int rows = heights.size();
+    int cols = heights[0].size();
+    vector<int> flat = flatten(heights);
+    string input = directory + "/heights.wcg";
+    string output = directory + "/levels.wcg";
+    Solution solution;
+    solution.volume = -1;
+    if (!writeGridFile(input, GridView(rows, cols, flat), 4))
+        return solution;
+    StreamingWaterVolumeSolver solver(input, output, 1);
+    solution.volume = solver.solve();
+    MappedGrid levels;
+    if (solution.volume < 0 || !levels.open(output))
+        return solution;
+    GridView view = levels.view();
+    solution.levels.assign(rows, vector<int>(cols));
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++)
+            solution.levels[i][j] = view.at(i, j);
+    }
+    return solution;
+}
+
+/**
+ * @brief Строит список проверяемых решателей.
+ * @param directory Каталог для временных файлов потокового решателя.
+ */
+vector<Engine> makeEngines(const string& directory) {
+    vector<Engine> engines = {
+        {"dfs", [](const Matrix& h) { return solveSerial<HeightQueue>(h, SolverEngine::DepthFirstSearch, GridLayout::RowMajor); }},
+        {"dfs-tiled", [](const Matrix& h) { return solveSerial<HeightQueue>(h, SolverEngine::DepthFirstSearch, GridLayout::Tiled); }},
+        {"pfplus", [](const Matrix& h) { return solveSerial<HeightQueue>(h, SolverEngine::PriorityFloodPlus, GridLayout::RowMajor); }},
+        {"pfplus-tiled", [](const Matrix& h) { return solveSerial<HeightQueue>(h, SolverEngine::PriorityFloodPlus, GridLayout::Tiled); }},
+        {"pfplus-binaryheap", [](const Matrix& h) { return solveSerial<BinaryHeapQueue>(h, SolverEngine::PriorityFloodPlus, GridLayout::RowMajor); }},
+        {"dfs-basins", [](const Matrix& h) { return solveLabelled(h, SolverEngine::DepthFirstSearch); }},
+        {"pfplus-basins", [](const Matrix& h) { return solveLabelled(h, SolverEngine::PriorityFloodPlus); }},
+        {"parallel-tile2", [](const Matrix& h) { return solveParallel(h, 3, 2); }},
+        {"parallel-tile5", [](const Matrix& h) { return solveParallel(h, 2, 5); }},
+        {"native", [](const Matrix& h) { return solveNative(h, 0); }},
+        {"native-int32", [](const Matrix& h) { return solveNative(h, 4); }},
+        {"native-int64", [](const Matrix& h) { return solveNative(h, 8); }},
+        {"batch", solveInBatch},
+        {"incremental", solveIncremental},
+        {"streaming", [directory](const Matrix& h) { return solveStreaming(h, directory); }},
+    };
+    for (int k = 0; k <= (int)ReconstructionWaterVolumeSolver::detectKernel(); k++) {
+        SimdKernel kernel = (SimdKernel)k;
+        engines.push_back({string("reconstruction-") + ReconstructionWaterVolumeSolver::kernelName(kernel),
+                           [kernel](const Matrix& h) { return solveReconstruction(h, kernel); }});
+    }
+    return engines;
+}
+
+/**
+ * @brief Генератор случайных чисел сетки поверх счетного генератора рельефа.
+ */
+class GridRandom {
+public:
+    explicit GridRandom(uint64_t seed) : seed(seed) {}
+
+    /**
+     * @brief Возвращает число от low до high включительно.
+     */
+    ll range(ll low, ll high) {
+        return low + (ll)(terrainRandom(seed, counter++) % (uint64_t)(high - low + 1));
+    }
+
+private:
+    uint64_t seed; /**< Зерно сетки. */
+    uint64_t counter = 0; /**< Номер следующего числа. */
+};
+
+Matrix randomGrid(GridRandom& random, int rows, int cols, ll low, ll high) {
+    Matrix grid(rows, vector<int>(cols));
+    for (vector<int>& row : grid) {
+        for (int& h : row)
+            h = (int)random.range(low, high);
+    }
+    return grid;
+}
+
+/**
+ * @brief Строит сетку по зерну; вид сетки зависит от остатка номера.
+ * @param seed Зерно сетки.
+ * @param kind Имя вида сетки для отчета.
+ */
+Matrix generateGrid(uint64_t seed, string& kind) {
+    GridRandom random(seed);
+    switch (seed % 7) {
+    case 0:
+        kind = "narrow";
+        return randomGrid(random, random.range(1, 12), random.range(1, 12), -2, 2);
+    case 1:
+        kind = "wide";
+        return randomGrid(random, random.range(1, 12), random.range(1, 12), -1000000000, 1000000000);
+    case 2: {
+        kind = "line";
+        int length = random.range(1, 40);
+        return random.range(0, 1) ? randomGrid(random, 1, length, -5, 5) : randomGrid(random, length, 1, -5, 5);
+    }
+    case 3: {
+        // Огромное плато за стеной: немного ям, иногда пролом в стене
+        kind = "plateau";
+        int rows = random.range(3, 40);
+        int cols = random.range(3, 40);
+        int floor = random.range(-50, 50);
+        Matrix grid(rows, vector<int>(cols, floor));
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                if (i == 0 || i == rows - 1 || j == 0 || j == cols - 1)
+                    grid[i][j] = floor + random.range(1, 3);
+            }
+        }
+        for (int k = random.range(0, 3); k > 0; k--)
+            grid[random.range(0, rows - 1)][random.range(0, cols - 1)] = floor - random.range(1, 5);
+        if (random.range(0, 2) == 0)
+            grid[0][random.range(0, cols - 1)] = floor;
+        return grid;
+    }
+    case 4: {
+        kind = "terrain";
+        TerrainKind kinds[] = {TerrainKind::Uniform, TerrainKind::Plateau, TerrainKind::Bowls, TerrainKind::Spiral,
+                               TerrainKind::Ramp, TerrainKind::Fractal, TerrainKind::Serpentine};
+        TerrainKind terrain = kinds[random.range(0, 6)];
+        kind += string("-") + terrainName(terrain);
+        Matrix grid = generateTerrain(terrain, random.range(1, 24), random.range(1, 24), seed);
+        int offset = random.range(-1000, 0);
+        for (vector<int>& row : grid) {
+            for (int& h : row)
+                h += offset;
+        }
+        return grid;
+    }
+    case 5: {
+        kind = "extreme";
+        const int values[] = {INT_MIN, INT_MIN + 1, -1, 0, 1, INT_MAX - 1, INT_MAX};
+        Matrix grid = randomGrid(random, random.range(1, 8), random.range(1, 8), 0, 6);
+        for (vector<int>& row : grid) {
+            for (int& h : row)
+                h = values[h];
+        }
+        return grid;
+    }
+    default:
+        // От 4096 клеток с широким диапазоном очередь работает радиксной кучей
+        kind = "large";
+        return randomGrid(random, random.range(60, 72), random.range(64, 72), -100000, 100000);
+    }
+}
+
+bool agrees(const Solution& expected, const Solution& actual) {
+    return expected.volume == actual.volume && (actual.levels.empty() || expected.levels == actual.levels);
+}
+
+/**
+ * @brief Уменьшает сетку, пока решатель расходится с эталоном.
+ * Сначала удаляются строки и столбцы, затем высоты заменяются нулем или половиной;
+ * проходы повторяются, пока удается что-нибудь упростить.
+ */
+Matrix shrinkGrid(Matrix grid, const Engine& engine) {
+    auto fails = [&](const Matrix& candidate) { return !agrees(relaxationOracle(candidate), engine.solve(candidate)); };
+    for (bool progress = true; progress;) {
+        progress = false;
+        for (size_t i = 0; grid.size() > 1 && i < grid.size();) {
+            Matrix candidate = grid;
+            candidate.erase(candidate.begin() + i);
+            if (fails(candidate)) {
+                grid = move(candidate);
+                progress = true;
+            } else {
+                i++;
+            }
+        }
+        for (size_t j = 0; grid[0].size() > 1 && j < grid[0].size();) {
+            Matrix candidate = grid;
+            for (vector<int>& row : candidate)
+                row.erase(row.begin() + j);
+            if (fails(candidate)) {
+                grid = move(candidate);
+                progress = true;
+            } else {
+                j++;
+            }
+        }
+        for (size_t i = 0; i < grid.size(); i++) {
+            for (size_t j = 0; j < grid[i].size(); j++) {
+                for (int value : {0, grid[i][j] / 2}) {
+                    if (value == grid[i][j])
+                        continue;
+                    Matrix candidate = grid;
+                    candidate[i][j] = value;
+                    if (fails(candidate)) {
+                        grid = move(candidate);
+                        progress = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+void printGrid(ostream& out, const Matrix& grid) {
+    out << grid.size() << ' ' << grid[0].size() << '\n';
+    for (const vector<int>& row : grid) {
+        for (size_t j = 0; j < row.size(); j++)
+            out << (j ? " " : "") << row[j];
+        out << '\n';
+    }
+}
+
+}
+
+/**
+ * @brief Сравнивает все решатели с эталонным заполнением релаксацией.
+ * @param options Параметры проверки.
+ * @param out Поток для отчета.
+ * @return Количество расхождений.
+ */
+int stressTests(const StressOptions& options, ostream& out) {
+    string directory = (filesystem::temp_directory_path() / "watercuboids-stress").string();
+    filesystem::create_directories(directory);
+    vector<Engine> engines = makeEngines(directory);
+    vector<int> failures(engines.size(), 0);
+
+    for (int g = 0; g < options.grids; g++) {
+        uint64_t seed = options.seed + g;
+        string kind;
+        Matrix grid = generateGrid(seed, kind);
+        Solution expected = relaxationOracle(grid);
+        for (size_t e = 0; e < engines.size(); e++) {
+            Solution actual = engines[e].solve(grid);
+            if (agrees(expected, actual))
+                continue;
+            // Подробно описывается только первое расхождение решателя
+            if (failures[e]++ > 0)
+                continue;
+            out << "Расхождение: " << engines[e].name << ", сетка " << kind << " с зерном " << seed
+                << " (" << grid.size() << "x" << grid[0].size() << "): объем " << actual.volume
+                << ", ожидался " << expected.volume << '\n';
+            Matrix reproducer = options.shrink ? shrinkGrid(grid, engines[e]) : grid;
+            Solution shrunk = engines[e].solve(reproducer);
+            out << "Наименьшая сетка (объем " << shrunk.volume << ", ожидался "
+                << relaxationOracle(reproducer).volume << "):\n";
+            printGrid(out, reproducer);
+        }
+    }
+    filesystem::remove_all(directory);
+
+    int total = 0;
+    for (size_t e = 0; e < engines.size(); e++) {
+        if (failures[e] > 0)
+            out << engines[e].name << ": расхождений " << failures[e] << '\n';
+        total += failures[e];
+    }
+    out << "Сеток: " << options.grids << ", решателей: " << engines.size() << ", расхождений: " << total << endl;
+    return total;
+}
@@ -0,0 +1,31 @@
+#ifndef STRESSTESTS_H
+#define STRESSTESTS_H
+
+#include <cstdint>
+#include <ostream>
+using namespace std;
+
+/**
+ * @brief Параметры дифференциальной проверки решателей.
+ */
+struct StressOptions {
+    int grids = 3000; /**< Количество сгенерированных сеток. */
+    uint64_t seed = 1; /**< Зерно генератора сеток. */
+    bool shrink = true; /**< Уменьшать сетку с расхождением до наименьшей. */
+};
+
+/**
+ * @brief Сравнивает все решатели с эталонным заполнением релаксацией.
+ * Эталон: уровень внутренних клеток начинается с наибольшей высоты и опускается до
+ * max(высота, наименьший уровень соседа), пока что-то меняется. Сетки строятся по зерну:
+ * случайные с узким и широким диапазоном (с отрицательными высотами), 1xN и Nx1, огромные
+ * плато, виды рельефа генератора, крайние значения int и большие сетки для радиксной очереди.
+ * Для каждого решателя первая сетка с расхождением уменьшается (удалением строк и столбцов
+ * и упрощением высот, пока расхождение сохраняется) и выводится в формате watercuboids-cli.
+ * @param options Параметры проверки.
+ * @param out Поток для отчета.
+ * @return Количество расхождений (0 - все решатели совпали с эталоном на всех сетках).
+ */
+int stressTests(const StressOptions& options, ostream& out);
+
+#endif // STRESSTESTS_H
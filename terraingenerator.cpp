@@ -0,0 +1,247 @@
+#include "terraingenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <thread>
+
+/**
+ * @brief Возвращает случайное число клетки счетным генератором.
+ * Счетчик перемешивается финализатором SplitMix64 дважды: сначала сам, затем вместе с зерном,
+ * поэтому соседние счетчики и соседние зерна дают независимые числа.
+ * @param seed Зерно генератора.
+ * @param counter Счетчик.
+ */
+uint64_t terrainRandom(uint64_t seed, uint64_t counter) {
+    auto mix = [](uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+    return mix(seed + mix(counter + 0x9E3779B97F4A7C15ULL));
+}
+
+static const int fractalOctaves = 6; /**< Количество октав фрактального рельефа. */
+static const int fractalMaxHeight = 1000; /**< Наибольшая высота фрактального рельефа. */
+
+/**
+ * @brief Скалярное произведение градиента узла решетки шума Перлина на смещение от узла.
+ * Градиент выбирается из восьми направлений по счетному генератору, поэтому решетку не нужно хранить.
+ * @param gradient Номер направления (младшие три бита случайного числа узла).
+ */
+static double gradientDot(int gradient, double dx, double dy) {
+    switch (gradient) {
+    case 0:
+        return dx + dy;
+    case 1:
+        return -dx + dy;
+    case 2:
+        return dx - dy;
+    case 3:
+        return -dx - dy;
+    case 4:
+        return dx;
+    case 5:
+        return -dx;
+    case 6:
+        return dy;
+    default:
+        return -dy;
+    }
+}
+
+/**
+ * @brief Возвращает номер направления градиента узла решетки.
+ */
+static int latticeGradient(uint64_t seed, int x, int y) {
+    return (int)(terrainRandom(seed, (uint64_t)(uint32_t)y << 32 | (uint32_t)x) & 7);
+}
+
+/**
+ * @brief Заполняет строку фрактального рельефа: сумму октав шума Перлина, каждая вдвое мельче и вдвое ниже.
+ * Крупнейшая октава имеет период в четверть большей стороны сетки. Узлы решетки меняются вдоль
+ * строки редко (период мельчайшей октавы - десятки клеток), поэтому их градиенты берутся
+ * из генератора только при переходе в следующую ячейку решетки.
+ * @param row Буфер строки на cols высот.
+ */
+static void fractalRow(uint64_t seed, int rows, int cols, int i, int* row) {
+    auto fade = [](double t) { return t * t * t * (t * (t * 6 - 15) + 10); };
+    vector<double> sum(cols, 0);
+    double frequency = 4.0 / max(8, max(rows, cols));
+    double amplitude = 1;
+    double norm = 0;
+    for (int octave = 0; octave < fractalOctaves; octave++) {
+        uint64_t octaveSeed = seed + octave;
+        double y = i * frequency;
+        int y0 = (int)floor(y);
+        double fy = y - y0;
+        double v = fade(fy);
+        int x0 = INT_MIN;
+        int g00 = 0, g10 = 0, g01 = 0, g11 = 0;
+        for (int j = 0; j < cols; j++) {
+            double x = j * frequency;
+            int cell = (int)floor(x);
+            if (cell != x0) {
+                x0 = cell;
+                g00 = latticeGradient(octaveSeed, x0, y0);
+                g10 = latticeGradient(octaveSeed, x0 + 1, y0);
+                g01 = latticeGradient(octaveSeed, x0, y0 + 1);
+                g11 = latticeGradient(octaveSeed, x0 + 1, y0 + 1);
+            }
+            double fx = x - x0;
+            double u = fade(fx);
+            double n00 = gradientDot(g00, fx, fy);
+            double n10 = gradientDot(g10, fx - 1, fy);
+            double n01 = gradientDot(g01, fx, fy - 1);
+            double n11 = gradientDot(g11, fx - 1, fy - 1);
+            double top = n00 + u * (n10 - n00);
+            double bottom = n01 + u * (n11 - n01);
+            sum[j] += amplitude * (top + v * (bottom - top));
+        }
+        norm += amplitude;
+        frequency *= 2;
+        amplitude /= 2;
+    }
+    for (int j = 0; j < cols; j++) {
+        int h = (int)lround((sum[j] / norm + 1) * fractalMaxHeight / 2);
+        row[j] = min(max(h, 0), fractalMaxHeight);
+    }
+}
+
+/**
+ * @brief Возвращает высоту клетки рельефа заданного вида.
+ */
+static int terrainHeight(TerrainKind kind, int rows, int cols, uint64_t seed, int i, int j) {
+    // Расстояние до края сетки (номер квадратного кольца)
+    int d = min(min(i, rows - 1 - i), min(j, cols - 1 - j));
+    uint64_t counter = (uint64_t)i * cols + j;
+    switch (kind) {
+    case TerrainKind::Uniform:
+        return (int)(terrainRandom(seed, counter) % 11);
+    case TerrainKind::Plateau:
+        return d == 0 ? 10 : 0;
+    case TerrainKind::Bowls:
+        return d % 4 == 0 ? d / 4 + 1 : (int)(terrainRandom(seed, counter) % 2);
+    case TerrainKind::Spiral:
+        if (d % 2 == 0) {
+            // Стены колец с одним проходом, попеременно сверху слева и снизу справа
+            bool gate = (d / 2) % 2 == 0 ? (i == d && j == d + 1) : (i == rows - 1 - d && j == cols - 2 - d);
+            return gate ? (d == 0 ? 50 : 0) : 100;
+        }
+        return 0;
+    case TerrainKind::Ramp:
+        return i + j;
+    case TerrainKind::Serpentine:
+        if (d == 0)
+            return i == 0 && j == 1 ? 50 : 100;
+        if (i % 2 == 1)
+            return 0;
+        // Стена между коридорами с проходом попеременно у правого и левого края
+        return j == ((i / 2) % 2 == 1 ? cols - 2 : 1) ? 0 : 100;
+    case TerrainKind::Fractal:
+        // Заполняется целыми строками в fractalRow
+        break;
+    }
+    return 0;
+}
+
+/**
+ * @brief Заполняет буфер высот рельефом заданного вида.
+ * Потоки разбирают полосы строк по атомарному счетчику; каждая клетка зависит только от своих
+ * координат и зерна, поэтому порядок полос не влияет на результат.
+ * @param kind Вид рельефа.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param seed Зерно генератора случайных чисел.
+ * @param heights Буфер на rows * cols высот, заполняется построчно.
+ * @param threads Количество потоков (0 - по числу ядер).
+ */
+void generateTerrain(TerrainKind kind, int rows, int cols, uint64_t seed, int* heights, int threads) {
+    const int bandRows = 64;
+    int bands = (rows + bandRows - 1) / bandRows;
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    int workers = min(threads, bands);
+
+    atomic<int> next(0);
+    auto work = [&]() {
+        for (int b = next++; b < bands; b = next++) {
+            for (int i = b * bandRows; i < min(rows, (b + 1) * bandRows); i++) {
+                int* row = heights + (size_t)i * cols;
+                if (kind == TerrainKind::Fractal) {
+                    fractalRow(seed, rows, cols, i, row);
+                    continue;
+                }
+                for (int j = 0; j < cols; j++)
+                    row[j] = terrainHeight(kind, rows, cols, seed, i, j);
+            }
+        }
+    };
+    if (workers <= 1) {
+        work();
+        return;
+    }
+    vector<thread> pool;
+    for (int w = 0; w < workers; w++)
+        pool.emplace_back(work);
+    for (thread& worker : pool)
+        worker.join();
+}
+
+/**
+ * @brief Генерирует рельеф заданного вида.
+ * @param kind Вид рельефа.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param seed Зерно генератора случайных чисел.
+ * @return Матрица высот.
+ */
+vector<vector<int>> generateTerrain(TerrainKind kind, int rows, int cols, uint64_t seed) {
+    vector<int> heights((size_t)rows * cols);
+    generateTerrain(kind, rows, cols, seed, heights.data());
+    vector<vector<int>> matrix(rows);
+    for (int i = 0; i < rows; i++)
+        matrix[i].assign(heights.begin() + (size_t)i * cols, heights.begin() + (size_t)(i + 1) * cols);
+    return matrix;
+}
+
+/**
+ * @brief Возвращает имя вида рельефа (uniform, plateau, bowls, spiral, ramp, fractal, serpentine).
+ */
+const char* terrainName(TerrainKind kind) {
+    switch (kind) {
+    case TerrainKind::Uniform:
+        return "uniform";
+    case TerrainKind::Plateau:
+        return "plateau";
+    case TerrainKind::Bowls:
+        return "bowls";
+    case TerrainKind::Spiral:
+        return "spiral";
+    case TerrainKind::Ramp:
+        return "ramp";
+    case TerrainKind::Fractal:
+        return "fractal";
+    case TerrainKind::Serpentine:
+        return "serpentine";
+    }
+    return "";
+}
+
+/**
+ * @brief Находит вид рельефа по имени.
+ * @param name Имя вида рельефа.
+ * @param kind Найденный вид рельефа.
+ * @return true, если имя известно, иначе false.
+ */
+bool parseTerrainKind(const string& name, TerrainKind& kind) {
+    for (TerrainKind k : {TerrainKind::Uniform, TerrainKind::Plateau, TerrainKind::Bowls, TerrainKind::Spiral, TerrainKind::Ramp,
+                          TerrainKind::Fractal, TerrainKind::Serpentine}) {
+        if (name == terrainName(k)) {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,68 @@
+#ifndef TERRAINGENERATOR_H
+#define TERRAINGENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Вид генерируемого рельефа.
+ */
+enum class TerrainKind {
+    Uniform, /**< Равномерный шум высот от 0 до 10. */
+    Plateau, /**< Одна огромная ровная котловина за стеной по краю. */
+    Bowls, /**< Вложенные квадратные чаши, каждая следующая стена выше. */
+    Spiral, /**< Спиральный лабиринт: вода доходит до центра по одному длинному коридору. */
+    Ramp, /**< Монотонный склон без воды. */
+    Fractal, /**< Фрактальный рельеф (сумма октав шума Перлина) с высотами от 0 до 1000. */
+    Serpentine /**< Змейка: коридор ходит по строкам туда и обратно через всю сетку. */
+};
+
+/**
+ * @brief Возвращает случайное число клетки счетным генератором.
+ * Число зависит только от зерна и счетчика (номера клетки), поэтому клетки можно
+ * заполнять в любом порядке и любым количеством потоков с одинаковым результатом.
+ * @param seed Зерно генератора.
+ * @param counter Счетчик.
+ */
+uint64_t terrainRandom(uint64_t seed, uint64_t counter);
+
+/**
+ * @brief Заполняет буфер высот рельефом заданного вида.
+ * Строки делятся на полосы, которые заполняются в пуле потоков; результат полностью
+ * определяется видом, размерами и зерном и не зависит от количества потоков.
+ * @param kind Вид рельефа.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param seed Зерно генератора случайных чисел.
+ * @param heights Буфер на rows * cols высот, заполняется построчно.
+ * @param threads Количество потоков (0 - по числу ядер).
+ */
+void generateTerrain(TerrainKind kind, int rows, int cols, uint64_t seed, int* heights, int threads = 0);
+
+/**
+ * @brief Генерирует рельеф заданного вида.
+ * Результат полностью определяется видом, размерами и зерном генератора.
+ * @param kind Вид рельефа.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param seed Зерно генератора случайных чисел.
+ * @return Матрица высот.
+ */
+vector<vector<int>> generateTerrain(TerrainKind kind, int rows, int cols, uint64_t seed);
+
+/**
+ * @brief Возвращает имя вида рельефа (uniform, plateau, bowls, spiral, ramp, fractal, serpentine).
+ */
+const char* terrainName(TerrainKind kind);
+
+/**
+ * @brief Находит вид рельефа по имени.
+ * @param name Имя вида рельефа.
+ * @param kind Найденный вид рельефа.
+ * @return true, если имя известно, иначе false.
+ */
+bool parseTerrainKind(const string& name, TerrainKind& kind);
+
+#endif // TERRAINGENERATOR_H
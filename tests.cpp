@@ -0,0 +1,55 @@
+#include "unittests.h"
+#include "stresstests.h"
+#include "memorytests.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * @brief Точка входа тестов: модульные тесты, дифференциальная проверка решателей и предел памяти
+ * потокового решателя. Без параметров выполняется все (проверка памяти - первой, пока куча
+ * процесса пуста); --unit, --stress и --memory оставляют одну часть,
+ * --grids N и --seed N задают количество сеток и зерно проверки, --no-shrink отключает уменьшение сетки.
+ * @param argc Количество аргументов командной строки.
+ * @param argv Массив аргументов командной строки.
+ * @return 0, если все тесты прошли, 1 при неудаче, 2 при ошибке параметров.
+ */
+int main(int argc, char *argv[]) {
+    bool unit = true;
+    bool stress = true;
+    bool memory = true;
+    StressOptions options;
+    for (int k = 1; k < argc; k++) {
+        if (!strcmp(argv[k], "--unit")) {
+            stress = false;
+            memory = false;
+        } else if (!strcmp(argv[k], "--stress")) {
+            unit = false;
+            memory = false;
+        } else if (!strcmp(argv[k], "--memory")) {
+            unit = false;
+            stress = false;
+        } else if (!strcmp(argv[k], "--grids") && k + 1 < argc) {
+            options.grids = atoi(argv[++k]);
+        } else if (!strcmp(argv[k], "--seed") && k + 1 < argc) {
+            options.seed = strtoull(argv[++k], nullptr, 10);
+        } else if (!strcmp(argv[k], "--no-shrink")) {
+            options.shrink = false;
+        } else {
+            cerr << "Использование: " << argv[0] << " [--unit | --stress | --memory] [--grids N] [--seed N] [--no-shrink]" << endl;
+            return 2;
+        }
+    }
+
+    int failures = 0;
+    if (memory)
+        failures += memoryTests(cout);
+    if (unit)
+        failures += unitTests().failures();
+    if (stress)
+        failures += stressTests(options, cout);
+    return failures == 0 ? 0 : 1;
+}
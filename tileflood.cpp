@@ -0,0 +1,187 @@
+#include "tileflood.h"
+
+#include <algorithm>
+#include <climits>
+
+/**
+ * @brief Возвращает количество клеток периметра блока.
+ * @param rows Количество строк в блоке.
+ * @param cols Количество столбцов в блоке.
+ */
+int tilePerimeter(int rows, int cols) {
+    if (rows == 1)
+        return cols;
+    if (cols == 1)
+        return rows;
+    return 2 * cols + 2 * (rows - 2);
+}
+
+/**
+ * @brief Возвращает порядковый номер клетки периметра блока.
+ * @param row Строка клетки внутри блока.
+ * @param col Столбец клетки внутри блока.
+ * @param rows Количество строк в блоке.
+ * @param cols Количество столбцов в блоке.
+ */
+int tilePerimeterIndex(int row, int col, int rows, int cols) {
+    if (row == 0)
+        return col;
+    if (row == rows - 1)
+        return cols + col;
+    if (col == 0)
+        return 2 * cols + (row - 1);
+    return 2 * cols + (rows - 2) + (row - 1);
+}
+
+/**
+ * @brief Заполняет блок.
+ * @param heights Указатель на левую верхнюю клетку блока во входной сетке.
+ * @param levels Указатель на левую верхнюю клетку блока в сетке локальных уровней.
+ * @param labels Указатель на левую верхнюю клетку блока в сетке меток.
+ * @param stride Длина строки всех трех сеток.
+ * @param rows Количество строк в блоке.
+ * @param cols Количество столбцов в блоке.
+ * @param labelBase Метка первой клетки периметра.
+ * @param edges Вектор, в который добавляются ребра между метками внутри блока (без повторов).
+ */
+void TileFlooder::flood(const int* heights, int* levels, int* labels, int stride, int rows, int cols, int labelBase, vector<SpillEdge>& edges) {
+    int paddedCols = cols + 2;
+    const int offsets[4] = {1, -1, paddedCols, -paddedCols};
+    cells.assign((size_t)(rows + 2) * paddedCols, TileCell{0, 0, -2});
+
+    int minHeight = heights[0];
+    int maxHeight = heights[0];
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            int h = heights[(size_t)i * stride + j];
+            cells[(size_t)(i + 1) * paddedCols + j + 1] = TileCell{h, h, -1};
+            minHeight = min(minHeight, h);
+            maxHeight = max(maxHeight, h);
+        }
+    }
+
+    // Клетки периметра - источники со своими метками
+    queue.init(minHeight, maxHeight, rows * cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (i != 0 && i != rows - 1 && j != 0 && j != cols - 1)
+                continue;
+            int u = (i + 1) * paddedCols + j + 1;
+            cells[u].label = labelBase + tilePerimeterIndex(i, j, rows, cols);
+            queue.push(cells[u].height, u);
+            SOLVER_STATS(statistics.queuePushes++);
+        }
+    }
+    SOLVER_STATS(statistics.queuePeak = max(statistics.queuePeak, (ll)queue.size()));
+
+    while (true) {
+        int u, L;
+        if (!pit.empty()) {
+            u = pit.back();
+            pit.pop_back();
+            L = cells[u].level;
+        } else if (!queue.empty()) {
+            pii x = queue.pop();
+            SOLVER_STATS(statistics.queuePops++);
+            u = x.second;
+            L = x.first;
+        } else {
+            break;
+        }
+        for (int d = 0; d < 4; d++) {
+            TileCell& cell = cells[u + offsets[d]];
+            if (cell.label != -1)
+                continue;
+            cell.label = cells[u].label;
+            if (cell.height <= L) {
+                cell.level = L;
+                pit.push_back(u + offsets[d]);
+                SOLVER_STATS(statistics.maxDepth = max(statistics.maxDepth, (ll)pit.size()));
+            } else {
+                queue.push(cell.height, u + offsets[d]);
+                SOLVER_STATS(statistics.queuePushes++, statistics.queuePeak = max(statistics.queuePeak, (ll)queue.size()));
+            }
+        }
+    }
+
+    // Сохраняем результат и собираем ребра между соседними клетками с разными метками
+    scratch.clear();
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            int u = (i + 1) * paddedCols + j + 1;
+            levels[(size_t)i * stride + j] = cells[u].level;
+            labels[(size_t)i * stride + j] = cells[u].label;
+            for (int d = 0; d < 3; d += 2) {
+                const TileCell& other = cells[u + offsets[d]];
+                if (other.label < 0 || other.label == cells[u].label)
+                    continue;
+                int a = min(cells[u].label, other.label);
+                int b = max(cells[u].label, other.label);
+                scratch.push_back(SpillEdge{a, b, max(cells[u].level, other.level)});
+            }
+        }
+    }
+    sort(scratch.begin(), scratch.end(), [](const SpillEdge& x, const SpillEdge& y) {
+        if (x.from != y.from)
+            return x.from < y.from;
+        if (x.to != y.to)
+            return x.to < y.to;
+        return x.level < y.level;
+    });
+    for (size_t k = 0; k < scratch.size(); k++) {
+        if (k == 0 || scratch[k].from != scratch[k - 1].from || scratch[k].to != scratch[k - 1].to)
+            edges.push_back(scratch[k]);
+    }
+}
+
+/**
+ * @brief Вычисляет уровни воды в графе переливов.
+ * Выполняет заполнение с приоритетом по графу меток, начиная с меток, выходящих на край сетки.
+ * @param labelCount Количество меток.
+ * @param edges Ребра между метками.
+ * @param shore Пары (уровень, метка) для меток, выходящих на край сетки.
+ * @return Уровень воды для каждой метки.
+ */
+vector<int> resolveSpillGraph(int labelCount, const vector<SpillEdge>& edges, const vector<pii>& shore) {
+    // Списки смежности в сжатом виде
+    vector<int> start(labelCount + 1, 0);
+    for (const SpillEdge& e : edges) {
+        start[e.from + 1]++;
+        start[e.to + 1]++;
+    }
+    for (int i = 0; i < labelCount; i++)
+        start[i + 1] += start[i];
+    vector<pii> adjacent(start[labelCount]);
+    vector<int> fill(start.begin(), start.end() - 1);
+    for (const SpillEdge& e : edges) {
+        adjacent[fill[e.from]++] = {e.to, e.level};
+        adjacent[fill[e.to]++] = {e.from, e.level};
+    }
+
+    vector<int> level(labelCount, INT_MAX);
+    vector<bool> done(labelCount, false);
+    priority_queue<pii, vector<pii>, greater<pii>> pq;
+    for (const pii& s : shore) {
+        if (s.first < level[s.second]) {
+            level[s.second] = s.first;
+            pq.push(s);
+        }
+    }
+    while (!pq.empty()) {
+        pii x = pq.top();
+        pq.pop();
+        int u = x.second;
+        if (done[u])
+            continue;
+        done[u] = true;
+        for (int k = start[u]; k < start[u + 1]; k++) {
+            int v = adjacent[k].first;
+            int candidate = max(level[u], adjacent[k].second);
+            if (!done[v] && candidate < level[v]) {
+                level[v] = candidate;
+                pq.push({candidate, v});
+            }
+        }
+    }
+    return level;
+}
@@ -0,0 +1,91 @@
+#ifndef TILEFLOOD_H
+#define TILEFLOOD_H
+
+#include "heightqueue.h"
+#include "solverstats.h"
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Ребро графа переливов: метки двух областей и уровень, на котором вода переходит между ними.
+ */
+struct SpillEdge {
+    int from; /**< Меньшая из двух меток. */
+    int to; /**< Большая из двух меток. */
+    int level; /**< Уровень перелива. */
+};
+
+/**
+ * @brief Возвращает количество клеток периметра блока.
+ * @param rows Количество строк в блоке.
+ * @param cols Количество столбцов в блоке.
+ */
+int tilePerimeter(int rows, int cols);
+
+/**
+ * @brief Возвращает порядковый номер клетки периметра блока.
+ * Номера идут по верхней строке, нижней строке, левому и правому столбцу; метка клетки периметра
+ * равна базовой метке блока плюс этот номер, поэтому соседние блоки вычисляют ее независимо.
+ * @param row Строка клетки внутри блока.
+ * @param col Столбец клетки внутри блока.
+ * @param rows Количество строк в блоке.
+ * @param cols Количество столбцов в блоке.
+ */
+int tilePerimeterIndex(int row, int col, int rows, int cols);
+
+/**
+ * @brief Класс TileFlooder заполняет один блок сетки независимо от остальных.
+ * Каждая клетка периметра блока становится источником со своей меткой, и от них выполняется
+ * Priority-Flood+ внутри блока. Для каждой клетки получаются локальный уровень (уровень воды,
+ * если бы периметр блока был берегом) и метка клетки периметра, через которую она стекает.
+ * Итоговый уровень клетки равен максимуму локального уровня и уровня ее метки в графе переливов.
+ * Буферы переиспользуются между блоками, поэтому объект заводится один на рабочий поток.
+ */
+class TileFlooder {
+public:
+    /**
+     * @brief Заполняет блок.
+     * @param heights Указатель на левую верхнюю клетку блока во входной сетке.
+     * @param levels Указатель на левую верхнюю клетку блока в сетке локальных уровней.
+     * @param labels Указатель на левую верхнюю клетку блока в сетке меток.
+     * @param stride Длина строки всех трех сеток.
+     * @param rows Количество строк в блоке.
+     * @param cols Количество столбцов в блоке.
+     * @param labelBase Метка первой клетки периметра.
+     * @param edges Вектор, в который добавляются ребра между метками внутри блока (без повторов).
+     */
+    void flood(const int* heights, int* levels, int* labels, int stride, int rows, int cols, int labelBase, vector<SpillEdge>& edges);
+
+    /**
+     * @brief Возвращает счетчики очереди и стека по всем заполненным блокам.
+     */
+    const SolverStats& stats() const { return statistics; }
+
+private:
+    /**
+     * @brief Клетка блока с рамкой.
+     */
+    struct TileCell {
+        int height; /**< Высота столбца. */
+        int level; /**< Локальный уровень воды. */
+        int label; /**< Метка клетки периметра (-1 - еще не достигнута, -2 - рамка). */
+    };
+
+    vector<TileCell> cells; /**< Блок с рамкой шириной в одну клетку. */
+    HeightQueue queue; /**< Очередь клеток выше текущего уровня перелива. */
+    vector<int> pit; /**< Стек клеток, затопленных до текущего уровня перелива. */
+    vector<SpillEdge> scratch; /**< Ребра блока до удаления повторов. */
+    SolverStats statistics; /**< Счетчики очереди и стека. */
+};
+
+/**
+ * @brief Вычисляет уровни воды в графе переливов.
+ * Уровень метки - минимальный по всем путям до края сетки максимум уровней ребер пути.
+ * @param labelCount Количество меток.
+ * @param edges Ребра между метками.
+ * @param shore Пары (уровень, метка) для меток, выходящих на край сетки.
+ * @return Уровень воды для каждой метки.
+ */
+vector<int> resolveSpillGraph(int labelCount, const vector<SpillEdge>& edges, const vector<pii>& shore);
+
+#endif // TILEFLOOD_H
@@ -0,0 +1,200 @@
+#include "typedwatervolumesolver.h"
+
+#include <algorithm>
+#include <limits>
+
+/**
+ * @brief Загружает сетку, сохраняя выделенную память.
+ * Ширина высоты выбирается один раз, а не на каждую клетку.
+ * @param view Матрица высот; ширина элемента не больше sizeof(Height).
+ * @return false, если высоты шире Height или сетка пуста.
+ */
+template <class Height, class Accumulator>
+bool TypedWaterVolumeSolver<Height, Accumulator>::reset(const GridView& view) {
+    if (view.rows <= 0 || view.cols <= 0 || (size_t)view.elementWidth > sizeof(Height))
+        return false;
+    switch (view.elementWidth) {
+    case 1:
+        load<int8_t>(view);
+        break;
+    case 2:
+        load<int16_t>(view);
+        break;
+    case 4:
+        load<int32_t>(view);
+        break;
+    default:
+        load<int64_t>(view);
+        break;
+    }
+    return true;
+}
+
+/**
+ * @brief Копирует высоты из представления, помечает рамку и кладет граничные клетки в очередь.
+ * @param view Матрица высот.
+ */
+template <class Height, class Accumulator>
+template <class Source>
+void TypedWaterVolumeSolver<Height, Accumulator>::load(const GridView& view) {
+    rowsMatrix = view.rows;
+    colsMatrix = view.cols;
+    stride = colsMatrix + 2;
+    volume = 0;
+    overflow = false;
+    pit.clear();
+
+    size_t cells = (size_t)(rowsMatrix + 2) * stride;
+    surface.resize(cells);
+    visited.assign(cells, 1);
+    Height minHeight = (Height)view.row<Source>(0)[0];
+    Height maxHeight = minHeight;
+    for (int i = 0; i < rowsMatrix; i++) {
+        const Source* src = view.row<Source>(i);
+        Height* dst = &surface[index(i, 0)];
+        for (int j = 0; j < colsMatrix; j++) {
+            Height h = (Height)src[j];
+            dst[j] = h;
+            minHeight = min(minHeight, h);
+            maxHeight = max(maxHeight, h);
+        }
+        // Внутренние клетки не посещены; граничные помечаются сразу, так как уже лежат в очереди
+        if (i > 0 && i < rowsMatrix - 1 && colsMatrix > 2)
+            fill_n(&visited[index(i, 1)], colsMatrix - 2, 0);
+    }
+
+    pq.init(minHeight, maxHeight, rowsMatrix * colsMatrix);
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++) {
+            if (i == 0 || i == rowsMatrix - 1 || j == 0 || j == colsMatrix - 1) {
+                int u = index(i, j);
+                pq.push(surface[u], u);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Решает задачу итеративным алгоритмом Priority-Flood+.
+ * @return Объем воды (при переполнении - наибольший помещающийся в Accumulator).
+ */
+template <class Height, class Accumulator>
+Accumulator TypedWaterVolumeSolver<Height, Accumulator>::solve() {
+    while (true) {
+        if (!pit.empty()) {
+            int u = pit.back();
+            pit.pop_back();
+            spill(u, surface[u]);
+        } else if (!pq.empty()) {
+            auto x = pq.pop();
+            spill(x.second, (Height)x.first);
+        } else {
+            break;
+        }
+    }
+    return volume;
+}
+
+/**
+ * @brief Помечает соседей клетки и распределяет их между стеком и очередью.
+ * @param u Индекс клетки с окончательным уровнем.
+ * @param L Уровень воды в клетке u.
+ */
+template <class Height, class Accumulator>
+void TypedWaterVolumeSolver<Height, Accumulator>::spill(int u, Height L) {
+    const int offsets[4] = {-stride, 1, stride, -1};
+    for (int d : offsets) {
+        int v = u + d;
+        if (visited[v])
+            continue;
+        visited[v] = 1;
+        Height h = surface[v];
+        if (h <= L) {
+            addDepth(L, h);
+            surface[v] = L;
+            pit.push_back(v);
+        } else {
+            pq.push(h, v);
+        }
+    }
+}
+
+/**
+ * @brief Добавляет к объему глубину воды над клеткой.
+ * Разность считается в беззнаковой арифметике, поэтому точна и для 64-битных высот любого знака.
+ * Для высот до 32 бит и ll переполнение невозможно (меньше 2^32 на клетку и меньше 2^31 клеток),
+ * и проверка не выполняется.
+ * @param L Уровень воды.
+ * @param h Высота клетки, не больше L.
+ */
+template <class Height, class Accumulator>
+void TypedWaterVolumeSolver<Height, Accumulator>::addDepth(Height L, Height h) {
+    uint64_t depth = (uint64_t)(int64_t)L - (uint64_t)(int64_t)h;
+    if (sizeof(Height) < sizeof(Accumulator)) {
+        volume += (Accumulator)depth;
+        return;
+    }
+    const Accumulator limit = numeric_limits<Accumulator>::max();
+    if (overflow || depth > (uint64_t)(limit - volume)) {
+        overflow = true;
+        volume = limit;
+        return;
+    }
+    volume += (Accumulator)depth;
+}
+
+template <class Height, class Accumulator>
+vector<vector<Height>> TypedWaterVolumeSolver<Height, Accumulator>::getWorkingMatrix() const {
+    vector<vector<Height>> matrixOutput(rowsMatrix);
+    for (int i = 0; i < rowsMatrix; i++)
+        matrixOutput[i].assign(surface.begin() + index(i, 0), surface.begin() + index(i, 0) + colsMatrix);
+    return matrixOutput;
+}
+
+template class TypedWaterVolumeSolver<int8_t>;
+template class TypedWaterVolumeSolver<int16_t>;
+template class TypedWaterVolumeSolver<int32_t>;
+template class TypedWaterVolumeSolver<int64_t>;
+
+/**
+ * @brief Решает матрицу решателем с высотами типа Height.
+ * @param view Матрица высот.
+ * @param volume Объем воды.
+ * @param workingMatrix Рабочая матрица (nullptr - не нужна).
+ * @return false, если объем не помещается в ll или матрица пуста.
+ */
+template <class Height>
+static bool solveAs(const GridView& view, ll& volume, vector<vector<ll>>* workingMatrix) {
+    TypedWaterVolumeSolver<Height> solver;
+    if (!solver.reset(view))
+        return false;
+    volume = solver.solve();
+    if (workingMatrix) {
+        workingMatrix->assign(solver.rows(), vector<ll>(solver.cols()));
+        for (int i = 0; i < solver.rows(); i++) {
+            for (int j = 0; j < solver.cols(); j++)
+                (*workingMatrix)[i][j] = solver.level(i, j);
+        }
+    }
+    return !solver.overflowed();
+}
+
+/**
+ * @brief Решает матрицу решателем, выбранным по ширине высот (ширина берется из заголовка файла сетки).
+ * @param view Матрица высот шириной 1, 2, 4 или 8 байт.
+ * @param volume Объем воды.
+ * @param workingMatrix Рабочая матрица (nullptr - не нужна).
+ * @return false, если объем не помещается в ll или матрица пуста.
+ */
+bool solveNativeWidth(const GridView& view, ll& volume, vector<vector<ll>>* workingMatrix) {
+    switch (view.elementWidth) {
+    case 1:
+        return solveAs<int8_t>(view, volume, workingMatrix);
+    case 2:
+        return solveAs<int16_t>(view, volume, workingMatrix);
+    case 8:
+        return solveAs<int64_t>(view, volume, workingMatrix);
+    default:
+        return solveAs<int32_t>(view, volume, workingMatrix);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef TYPEDWATERVOLUMESOLVER_H
+#define TYPEDWATERVOLUMESOLVER_H
+
+#include "heightqueue.h"
+#include "gridview.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+typedef long long ll;
+
+/**
+ * @brief Класс TypedWaterVolumeSolver решает задачу о объеме воды для высот заданного типа.
+ * Высоты хранятся в своей ширине (int8 - байт на клетку вместо 12 байт Cell), поэтому сетки
+ * с узким диапазоном требуют в разы меньше памяти и пропускной способности. Алгоритм -
+ * Priority-Flood+ на сетке с рамкой; уровни воды записываются на место высот.
+ * Объем накапливается с проверкой переполнения: если он не помещается в Accumulator,
+ * overflowed() возвращает true, а уровни воды остаются верными.
+ * Явно инстанцирован для int8_t, int16_t, int32_t и int64_t с накопителем ll.
+ * @tparam Height Тип высоты.
+ * @tparam Accumulator Знаковый целый тип для объема.
+ */
+template <class Height, class Accumulator = ll>
+class TypedWaterVolumeSolver {
+public:
+    /**
+     * @brief Очередь с приоритетом: корзины для высот до 32 бит, двоичная куча для 64-битных.
+     */
+    typedef typename conditional<sizeof(Height) <= sizeof(int), HeightQueue, BasicBinaryHeapQueue<Height>>::type Queue;
+
+    /**
+     * @brief Загружает сетку, сохраняя выделенную память.
+     * @param view Матрица высот; ширина элемента не больше sizeof(Height).
+     * @return false, если высоты шире Height или сетка пуста.
+     */
+    bool reset(const GridView& view);
+
+    /**
+     * @brief Решает задачу о объеме воды.
+     * @return Объем воды (при переполнении - наибольший помещающийся в Accumulator).
+     */
+    Accumulator solve();
+
+    /**
+     * @brief Проверяет, переполнился ли объем в последнем solve().
+     */
+    bool overflowed() const { return overflow; }
+
+    int rows() const { return rowsMatrix; }
+    int cols() const { return colsMatrix; }
+
+    /**
+     * @brief Возвращает уровень воды клетки (до solve() - высоту).
+     * @param row Строка клетки.
+     * @param col Столбец клетки.
+     */
+    Height level(int row, int col) const { return surface[index(row, col)]; }
+
+    vector<vector<Height>> getWorkingMatrix() const;
+
+private:
+    int rowsMatrix = 0; /**< Количество строк в матрице. */
+    int colsMatrix = 0; /**< Количество столбцов в матрице. */
+    int stride = 0; /**< Длина строки с рамкой. */
+    vector<Height> surface; /**< Высоты с рамкой; у затопленных клеток заменяются уровнем воды. */
+    vector<uint8_t> visited; /**< Флаги посещения с рамкой (рамка помечена). */
+    vector<int> pit; /**< Стек клеток, затопленных до текущего уровня перелива. */
+    Queue pq; /**< Очередь с приоритетом (высота, индекс клетки). */
+    Accumulator volume = 0; /**< Накопленный объем. */
+    bool overflow = false; /**< Объем не поместился в Accumulator. */
+
+    int index(int row, int col) const { return (row + 1) * stride + col + 1; }
+
+    /**
+     * @brief Копирует высоты из представления шириной Source.
+     * @param view Матрица высот.
+     */
+    template <class Source>
+    void load(const GridView& view);
+
+    /**
+     * @brief Помечает соседей клетки и распределяет их между стеком и очередью.
+     * @param u Индекс клетки с окончательным уровнем.
+     * @param L Уровень воды в клетке u.
+     */
+    void spill(int u, Height L);
+
+    /**
+     * @brief Добавляет к объему глубину воды над клеткой.
+     * @param L Уровень воды.
+     * @param h Высота клетки, не больше L.
+     */
+    void addDepth(Height L, Height h);
+};
+
+/**
+ * @brief Решает матрицу решателем, выбранным по ширине высот (ширина берется из заголовка файла сетки).
+ * @param view Матрица высот шириной 1, 2, 4 или 8 байт.
+ * @param volume Объем воды.
+ * @param workingMatrix Рабочая матрица (nullptr - не нужна).
+ * @return false, если объем не помещается в ll или матрица пуста.
+ */
+bool solveNativeWidth(const GridView& view, ll& volume, vector<vector<ll>>* workingMatrix = nullptr);
+
+#endif // TYPEDWATERVOLUMESOLVER_H
@@ -1,9 +1,30 @@
 #include "unittests.h"
 #include "watervolumesolver.h"
+#include "parallelwatervolumesolver.h"
+#include "incrementalwatervolumesolver.h"
+#include "fixedwatervolumesolver.h"
+#include "gridbatch.h"
+#include "heightgrid.h"
+#include "typedwatervolumesolver.h"
+#include "reconstructionwatervolumesolver.h"
+#include "terraingenerator.h"
+#include "solvecache.h"
+#include "filebatch.h"
+#include "gridfile.h"
+#include "packedgrid.h"
+#include "gridio.h"
 
 #include "vector"
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <climits>
 #include <iostream>
+#include <mutex>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
 
 using namespace std;
 /**
@@ -42,6 +63,7 @@ unitTests::unitTests()
         cout << "Test 1 passed!" << std::endl;
     } else {
         cout << "Test 1 failed!" << std::endl;
+        failedTests++;
     }
 
     vector<vector<int>> matrix2 = {
@@ -59,6 +81,566 @@ unitTests::unitTests()
         cout << "Test 2 passed!" << std::endl;
     } else {
         cout << "Test 2 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Блочное размещение сетки должно давать тот же результат и ту же рабочую матрицу
+    WaterVolumeSolver solver3(3, 6, matrix2, GridLayout::Tiled);
+    WaterVolumeSolver solver3RowMajor(3, 6, matrix2);
+    ll result3 = solver3.solve();
+    solver3RowMajor.solve();
+    if (result3 == 5 && solver3.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()) {
+        cout << "Test 3 passed!" << std::endl;
+    } else {
+        cout << "Test 3 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Итеративный Priority-Flood+ должен совпадать с поиском в глубину
+    WaterVolumeSolver solver4(3, 6, matrix2);
+    solver4.setEngine(SolverEngine::PriorityFloodPlus);
+    ll result4 = solver4.solve();
+    if (result4 == 5 && solver4.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()) {
+        cout << "Test 4 passed!" << std::endl;
+    } else {
+        cout << "Test 4 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Очередь на двоичной куче должна давать тот же результат, что и корзинная
+    BasicWaterVolumeSolver<BinaryHeapQueue> solver5(3, 6, matrix2);
+    ll result5 = solver5.solve();
+    if (result5 == 5 && solver5.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()) {
+        cout << "Test 5 passed!" << std::endl;
+    } else {
+        cout << "Test 5 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Многопоточный решатель с блоками 2x2 должен совпадать с последовательным бит в бит
+    ParallelWaterVolumeSolver solver6(3, 6, matrix2, 2, 2);
+    ll result6 = solver6.solve();
+    if (result6 == 5 && solver6.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()) {
+        cout << "Test 6 passed!" << std::endl;
+    } else {
+        cout << "Test 6 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Обновление после правки клеток должно совпадать с полным решением измененной матрицы
+    vector<int> heights7;
+    for (const vector<int>& row : matrix2)
+        heights7.insert(heights7.end(), row.begin(), row.end());
+    IncrementalWaterVolumeSolver solver7{GridView(3, 6, heights7)};
+    vector<vector<int>> matrix7 = matrix2;
+    matrix7[1][1] = 5;
+    matrix7[1][4] = 0;
+    WaterVolumeSolver solver7Full(3, 6, matrix7);
+    ll result7Full = solver7Full.solve();
+    ll result7 = solver7.update({{1, 1, 5}, {1, 4, 0}});
+    if (result7 == result7Full && solver7.getWorkingMatrix() == solver7Full.getWorkingMatrix()
+        && solver7.update({{1, 1, 1}, {1, 4, 1}}) == 5 && solver7.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()) {
+        cout << "Test 7 passed!" << std::endl;
+    } else {
+        cout << "Test 7 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Переиспользуемый решатель, решатель фиксированного размера и пакет должны совпадать с обычным решением
+    WaterVolumeSolver solver8;
+    solver8.reset(3, 3, matrix1);
+    ll result8First = solver8.solve();
+    solver8.reset(3, 6, matrix2);
+    ll result8 = solver8.solve();
+    FixedWaterVolumeSolver<3, 6> solver8Fixed;
+    ll result8Fixed = solver8Fixed.solve(heights7.data());
+    GridBatch batch8;
+    batch8.add(3, 6, heights7.data());
+    batch8.add(3, 6, heights7.data());
+    if (result8First == 2 && result8 == 5 && solver8.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()
+        && result8Fixed == 5 && solver8Fixed.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix()
+        && solveBatch(batch8) == vector<ll>{5, 5}) {
+        cout << "Test 8 passed!" << std::endl;
+    } else {
+        cout << "Test 8 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Многопоточный решатель читает разделяемую матрицу на месте и отдает уровни без копирования
+    SharedGrid heights9 = makeSharedGrid(3, 6, vector<int>(heights7));
+    ParallelWaterVolumeSolver solver9(heights9->view(), 2, 2);
+    ll result9 = solver9.solve();
+    SharedGrid levels9 = makeSharedGrid(3, 6, solver9.takeLevels());
+    vector<int> expected9;
+    for (const vector<int>& row : solver3RowMajor.getWorkingMatrix())
+        expected9.insert(expected9.end(), row.begin(), row.end());
+    if (result9 == 5 && levels9->values() == expected9) {
+        cout << "Test 9 passed!" << std::endl;
+    } else {
+        cout << "Test 9 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Решатель с состоянием отмены считает все клетки дважды, а отмененный возвращает -1
+    SolveControl control10;
+    ParallelWaterVolumeSolver solver10(heights9->view(), 2, 2);
+    solver10.setControl(&control10);
+    ll result10 = solver10.solve();
+    SolveControl cancelled10;
+    cancelled10.cancel();
+    ParallelWaterVolumeSolver solver10Cancelled(heights9->view(), 2, 2);
+    solver10Cancelled.setControl(&cancelled10);
+    if (result10 == 5 && control10.done == 36 && control10.total == 36
+        && solver10Cancelled.solve() == -1 && cancelled10.done == 0) {
+        cout << "Test 10 passed!" << std::endl;
+    } else {
+        cout << "Test 10 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Готовые блоки многопоточного решателя вместе дают всю рабочую матрицу
+    mutex regionsMutex11;
+    vector<int> levels11(heights7.size(), -1);
+    ParallelWaterVolumeSolver solver11(heights9->view(), 2, 2);
+    solver11.setRegionCallback([&](GridRegion&& region) {
+        lock_guard<mutex> lock(regionsMutex11);
+        for (int i = 0; i < region.rows; i++) {
+            for (int j = 0; j < region.cols; j++)
+                levels11[(size_t)(region.row + i) * 6 + region.col + j] = region.values[(size_t)i * region.cols + j];
+        }
+    });
+    ll result11 = solver11.solve();
+    if (result11 == 5 && levels11 == expected9) {
+        cout << "Test 11 passed!" << std::endl;
+    } else {
+        cout << "Test 11 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Решатель по ширине высот: байтовые высоты дают тот же ответ, 64-битный объем сообщает о переполнении
+    vector<int8_t> heights12(heights7.begin(), heights7.end());
+    GridView view12;
+    view12.rows = 3;
+    view12.cols = 6;
+    view12.elementWidth = 1;
+    view12.rowStride = 6;
+    view12.data = heights12.data();
+    ll result12 = 0;
+    bool fits12 = solveNativeWidth(view12, result12);
+    vector<int64_t> walls12(9, INT64_MAX);
+    walls12[4] = INT64_MIN;
+    GridView wide12 = view12;
+    wide12.rows = 3;
+    wide12.cols = 3;
+    wide12.elementWidth = 8;
+    wide12.rowStride = 3;
+    wide12.data = walls12.data();
+    TypedWaterVolumeSolver<int64_t> solver12;
+    solver12.reset(wide12);
+    solver12.solve();
+    if (fits12 && result12 == 5 && solver12.overflowed() && solver12.level(1, 1) == INT64_MAX) {
+        cout << "Test 12 passed!" << std::endl;
+    } else {
+        cout << "Test 12 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Морфологическая реконструкция совпадает с очередью при любом наборе инструкций
+    bool passed13 = true;
+    for (SimdKernel kernel : {SimdKernel::Scalar, SimdKernel::Sse41, SimdKernel::Avx2}) {
+        ReconstructionWaterVolumeSolver solver13(3, 6, matrix2);
+        solver13.setKernel(kernel);
+        passed13 = passed13 && solver13.solve() == 5 && solver13.getWorkingMatrix() == solver3RowMajor.getWorkingMatrix();
+    }
+    if (passed13) {
+        cout << "Test 13 passed!" << std::endl;
+    } else {
+        cout << "Test 13 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Счетчики: каждая клетка проходит через очередь или стек один раз, затопленные клетки совпадают с уровнями
+    WaterVolumeSolver solver14(3, 6, matrix2);
+    solver14.setEngine(SolverEngine::PriorityFloodPlus);
+    solver14.solve();
+    vector<vector<int>> levels14 = solver14.getWorkingMatrix();
+    ll flooded14 = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 6; j++)
+            flooded14 += levels14[i][j] > matrix2[i][j];
+    }
+    ParallelWaterVolumeSolver parallel14(3, 6, matrix2, 2, 2);
+    parallel14.solve();
+    const SolverStats& stats14 = solver14.stats();
+    bool passed14 = statsToJson(stats14, "pfplus").find("\"engine\":\"pfplus\"") != string::npos;
+    if (SolverStats::enabled()) {
+        passed14 = passed14 && stats14.queuePushes == stats14.queuePops && stats14.queuePeak > 0
+                && stats14.cellsFlooded == flooded14 && parallel14.stats().cellsFlooded == flooded14;
+    } else {
+        passed14 = passed14 && stats14.queuePushes == 0 && stats14.cellsFlooded == 0 && parallel14.stats().cellsFlooded == 0;
+    }
+    if (passed14) {
+        cout << "Test 14 passed!" << std::endl;
+    } else {
+        cout << "Test 14 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Рельеф не зависит от количества потоков; в змейке вода стоит на уровне выхода во всем коридоре
+    vector<int> fractal15a(200 * 50), fractal15b(200 * 50);
+    generateTerrain(TerrainKind::Fractal, 200, 50, 15, fractal15a.data(), 1);
+    generateTerrain(TerrainKind::Fractal, 200, 50, 15, fractal15b.data(), 3);
+    bool passed15 = fractal15a == fractal15b && *min_element(fractal15a.begin(), fractal15a.end()) >= 0
+            && *max_element(fractal15a.begin(), fractal15a.end()) <= 1000;
+    vector<vector<int>> serpentine15 = generateTerrain(TerrainKind::Serpentine, 9, 8, 15);
+    ll corridor15 = 0;
+    for (const vector<int>& row : serpentine15)
+        corridor15 += count(row.begin(), row.end(), 0);
+    WaterVolumeSolver solver15(9, 8, serpentine15);
+    passed15 = passed15 && corridor15 > 0 && solver15.solve() == 50 * corridor15;
+    if (passed15) {
+        cout << "Test 15 passed!" << std::endl;
+    } else {
+        cout << "Test 15 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Разметка озер: два озера, соединенные только по суше, различаются; таблица сходится с объемом
+    vector<vector<int>> matrix16 = {{3, 3, 3, 3, 3}, {3, 1, 3, 1, 3}, {3, 3, 3, 3, 3}};
+    WaterVolumeSolver solver16(3, 5, matrix16);
+    solver16.setEngine(SolverEngine::PriorityFloodPlus);
+    solver16.setBasinLabelling(true);
+    solver16.solve();
+    vector<vector<int>> labels16 = solver16.getBasinMatrix();
+    bool passed16 = solver16.basins().size() == 2 && labels16[1][1] >= 0 && labels16[1][3] >= 0
+            && labels16[1][1] != labels16[1][3] && labels16[1][2] == -1;
+    for (const Basin& basin : solver16.basins())
+        passed16 = passed16 && basin.level == 3 && basin.volume == 2 && basin.area == 1 && matrix16[basin.spillRow][basin.spillCol] == 3;
+    vector<vector<int>> fractal16 = generateTerrain(TerrainKind::Fractal, 40, 40, 16);
+    for (SolverEngine engine : {SolverEngine::DepthFirstSearch, SolverEngine::PriorityFloodPlus}) {
+        WaterVolumeSolver terrain16(40, 40, fractal16, GridLayout::Tiled);
+        terrain16.setEngine(engine);
+        terrain16.setBasinLabelling(true);
+        ll volume16 = terrain16.solve();
+        vector<vector<int>> levels16 = terrain16.getWorkingMatrix();
+        vector<vector<int>> basins16 = terrain16.getBasinMatrix();
+        ll total16 = 0;
+        ll area16 = 0;
+        for (const Basin& basin : terrain16.basins()) {
+            total16 += basin.volume;
+            area16 += basin.area;
+        }
+        for (int i = 0; i < 40; i++) {
+            for (int j = 0; j < 40; j++) {
+                bool wet = levels16[i][j] > fractal16[i][j];
+                passed16 = passed16 && wet == (basins16[i][j] >= 0);
+                area16 -= wet;
+            }
+        }
+        passed16 = passed16 && total16 == volume16 && area16 == 0;
+    }
+    if (passed16) {
+        cout << "Test 16 passed!" << std::endl;
+    } else {
+        cout << "Test 16 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Кэш решений: уровни восстанавливаются из глубин, ключ не зависит от ширины высот,
+    // старые записи вытесняются, дисковый уровень виден новому кэшу
+    vector<vector<int>> terrain17 = generateTerrain(TerrainKind::Bowls, 30, 40, 17);
+    vector<int> heights17;
+    for (const vector<int>& row : terrain17)
+        heights17.insert(heights17.end(), row.begin(), row.end());
+    GridView view17(30, 40, heights17);
+    vector<int8_t> narrow17 = {3, 3, 3, 3, 1, 3, 3, 3, 3};
+    vector<int> wide17(narrow17.begin(), narrow17.end());
+    GridView narrowView17;
+    narrowView17.rows = 3;
+    narrowView17.cols = 3;
+    narrowView17.elementWidth = 1;
+    narrowView17.rowStride = 3;
+    narrowView17.data = narrow17.data();
+    WaterVolumeSolver solver17(view17);
+    ll volume17 = solver17.solve();
+    vector<int> levels17;
+    for (const vector<int>& row : solver17.getWorkingMatrix())
+        levels17.insert(levels17.end(), row.begin(), row.end());
+    string directory17 = (filesystem::temp_directory_path() / "watercuboids-unittests-cache").string();
+    filesystem::remove_all(directory17);
+
+    SolveCache cache17(1 << 20);
+    GridKey key17 = gridKey(view17);
+    ll cachedVolume17 = -1;
+    vector<int> cachedLevels17;
+    bool passed17 = cache17.setDirectory(directory17) && !cache17.lookup(key17, view17, cachedVolume17)
+            && gridKey(narrowView17) == gridKey(GridView(3, 3, wide17)) && !(gridKey(narrowView17) == key17);
+    cache17.store(key17, view17, volume17, levels17.data());
+    passed17 = passed17 && cache17.lookup(key17, view17, cachedVolume17, &cachedLevels17)
+            && cachedVolume17 == volume17 && cachedLevels17 == levels17;
+    cache17.store(gridKey(narrowView17), narrowView17, 2);
+    size_t usage17 = cache17.memoryUsage();
+    cache17.setMemoryLimit(usage17 - 1);
+    passed17 = passed17 && cache17.memoryUsage() < usage17
+            && cache17.lookup(gridKey(narrowView17), GridView(3, 3, wide17), cachedVolume17) && cachedVolume17 == 2;
+
+    SolveCache restarted17;
+    passed17 = passed17 && restarted17.setDirectory(directory17) && restarted17.lookup(key17, view17, cachedVolume17, &cachedLevels17)
+            && cachedVolume17 == volume17 && cachedLevels17 == levels17 && restarted17.hits() == 1;
+
+    // Поврежденный размер глубин в заголовке дает промах, а не попытку выделить память под него
+    for (const filesystem::directory_entry& file17 : filesystem::directory_iterator(directory17)) {
+        fstream corrupt17(file17.path(), ios::binary | ios::in | ios::out);
+        uint64_t depthBytes17 = 0x7fffffffffffffffULL;
+        corrupt17.seekp(56);
+        corrupt17.write(reinterpret_cast<const char*>(&depthBytes17), sizeof(depthBytes17));
+    }
+    SolveCache corrupted17;
+    passed17 = passed17 && corrupted17.setDirectory(directory17) && !corrupted17.lookup(key17, view17, cachedVolume17)
+            && corrupted17.misses() == 1;
+
+    // Сверх предела дискового уровня удаляется файл, дольше всех не использованный
+    filesystem::remove_all(directory17);
+    SolveCache limited17;
+    passed17 = passed17 && limited17.setDirectory(directory17);
+    limited17.store(key17, view17, volume17, levels17.data());
+    uintmax_t fileBytes17 = limited17.diskUsage();
+    for (const filesystem::directory_entry& file17 : filesystem::directory_iterator(directory17))
+        filesystem::last_write_time(file17.path(), filesystem::file_time_type::clock::now() - chrono::hours(1));
+    limited17.setDiskLimit(fileBytes17);
+    limited17.store(gridKey(narrowView17), narrowView17, 2);
+    SolveCache reopened17;
+    passed17 = passed17 && fileBytes17 > 0 && limited17.diskUsage() < fileBytes17 && reopened17.setDirectory(directory17)
+            && !reopened17.lookup(key17, view17, cachedVolume17) && reopened17.lookup(gridKey(narrowView17), narrowView17, cachedVolume17);
+    SolveCache emptied17;
+    emptied17.setDiskLimit(0);
+    passed17 = passed17 && emptied17.setDirectory(directory17) && emptied17.diskUsage() == 0 && filesystem::is_empty(directory17);
+
+    // В пакете три одинаковые большие сетки: решается только первая
+    vector<int> batchHeights17;
+    for (const vector<int>& row : generateTerrain(TerrainKind::Uniform, 70, 70, 17))
+        batchHeights17.insert(batchHeights17.end(), row.begin(), row.end());
+    GridBatch batch17;
+    for (int copy = 0; copy < 3; copy++)
+        batch17.add(70, 70, batchHeights17.data());
+    SolveCache batchCache17;
+    vector<ll> batchVolumes17 = solveBatch(batch17, 1, &batchCache17);
+    passed17 = passed17 && batchVolumes17 == vector<ll>(3, batchVolumes17[0]) && batchCache17.hits() == 2 && batchCache17.misses() == 1;
+    filesystem::remove_all(directory17);
+    if (passed17) {
+        cout << "Test 17 passed!" << std::endl;
+    } else {
+        cout << "Test 17 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Пакет файлов: сетки разного размера, текст, 64-битные высоты и испорченный файл
+    string directory18 = (filesystem::temp_directory_path() / "watercuboids-unittests-batch").string();
+    filesystem::remove_all(directory18);
+    filesystem::create_directories(directory18);
+    map<string, ll> expected18;
+    for (int k = 0; k < 4; k++) {
+        int size = 20 + 30 * k;
+        vector<int> heights;
+        for (const vector<int>& row : generateTerrain(TerrainKind::Bowls, size, size, 18 + k))
+            heights.insert(heights.end(), row.begin(), row.end());
+        GridView view(size, size, heights);
+        string name = directory18 + "/grid" + to_string(k) + ".wcg";
+        writeGridFile(name, view);
+        WaterVolumeSolver solver(view);
+        expected18[name] = solver.solve();
+    }
+    ofstream text18(directory18 + "/text.txt");
+    text18 << "3 3\n5 5 5\n5 1 5\n5 5 5\n";
+    text18.close();
+    expected18[directory18 + "/text.txt"] = 4;
+    vector<ll> wide18 = {(ll)1 << 40, (ll)1 << 40, (ll)1 << 40, (ll)1 << 40, 0, (ll)1 << 40, (ll)1 << 40, (ll)1 << 40, (ll)1 << 40};
+    GridView wideView18;
+    wideView18.rows = 3;
+    wideView18.cols = 3;
+    wideView18.elementWidth = 8;
+    wideView18.rowStride = 3;
+    wideView18.data = wide18.data();
+    writeGridFile(directory18 + "/wide.wcg", wideView18);
+    expected18[directory18 + "/wide.wcg"] = (ll)1 << 40;
+    ofstream broken18(directory18 + "/broken.txt");
+    broken18 << "не матрица\n";
+    broken18.close();
+    // Матрица без клеток не записывается: такой файл не открылся бы
+    vector<int> empty18;
+    bool emptyRejected18 = !writeGridFile(directory18 + "/empty.wcg", GridView(0, 3, empty18))
+            && !filesystem::exists(directory18 + "/empty.wcg");
+
+    vector<string> files18;
+    FileBatchSolver batchSolver18(2, 1);
+    batchSolver18.setParallelCells(50 * 50);
+    vector<FileResult> results18;
+    size_t failures18 = 0;
+    if (FileBatchSolver::listDirectory(directory18, files18))
+        failures18 = batchSolver18.solve(files18, [&results18](const FileResult& result) { results18.push_back(result); });
+    bool passed18 = emptyRejected18 && files18.size() == 7 && results18.size() == 7 && failures18 == 1;
+    for (const FileResult& result : results18) {
+        if (result.fileName == directory18 + "/broken.txt")
+            passed18 = passed18 && !result.error.empty() && result.volume == -1;
+        else
+            passed18 = passed18 && result.error.empty() && expected18.count(result.fileName) && result.volume == expected18[result.fileName];
+    }
+    filesystem::remove_all(directory18);
+    if (passed18) {
+        cout << "Test 18 passed!" << std::endl;
+    } else {
+        cout << "Test 18 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Сжатый файл сетки: плато и рельеф сжимаются, распаковка по блокам совпадает с исходными высотами
+    string directory19 = (filesystem::temp_directory_path() / "watercuboids-unittests-packed").string();
+    filesystem::remove_all(directory19);
+    filesystem::create_directories(directory19);
+    vector<int> heights19((size_t)200 * 150);
+    generateTerrain(TerrainKind::Fractal, 200, 150, 19, heights19.data());
+    heights19[0] = INT_MIN;
+    heights19[1] = INT_MAX;
+    GridView view19(200, 150, heights19);
+    vector<int> plateau19((size_t)200 * 150, 42);
+    vector<ll> wide19 = {-((ll)1 << 62), (ll)1 << 62, 3, LLONG_MAX, LLONG_MIN, 0};
+    GridView wideView19;
+    wideView19.rows = 2;
+    wideView19.cols = 3;
+    wideView19.elementWidth = 8;
+    wideView19.rowStride = 3;
+    wideView19.data = wide19.data();
+    string name19 = directory19 + "/terrain.wcp";
+    bool passed19 = writePackedGridFile(name19, view19, 7, 3) && writePackedGridFile(directory19 + "/plateau.wcp", GridView(200, 150, plateau19))
+            && writePackedGridFile(directory19 + "/wide.wcp", wideView19);
+    PackedGrid packed19;
+    vector<int> decoded19(heights19.size());
+    passed19 = passed19 && packed19.open(name19) && packed19.chunkCount() == 29 && packed19.decode(decoded19.data(), 3) && decoded19 == heights19;
+    vector<int> chunk19((size_t)packed19.chunkRows() * 150);
+    for (int chunk = packed19.chunkCount() - 1; chunk >= 0; chunk--) {
+        size_t first19 = (size_t)chunk * packed19.chunkRows() * 150;
+        size_t count19 = min(chunk19.size(), heights19.size() - first19);
+        passed19 = passed19 && packed19.decodeChunk(chunk, chunk19.data())
+                && equal(chunk19.begin(), chunk19.begin() + count19, heights19.begin() + first19);
+    }
+    passed19 = passed19 && filesystem::file_size(directory19 + "/plateau.wcp") < 1024;
+    // Решатель загружает сжатый файл блоками в рабочую сетку без буфера всей матрицы
+    WaterVolumeSolver fromView19(view19);
+    WaterVolumeSolver fromPacked19;
+    passed19 = passed19 && fromPacked19.reset(packed19) && fromPacked19.solve() == fromView19.solve()
+            && fromPacked19.getWorkingMatrix() == fromView19.getWorkingMatrix();
+    int rows19, cols19;
+    vector<vector<int>> matrix19;
+    passed19 = passed19 && readGridFile(name19, rows19, cols19, matrix19) && rows19 == 200 && cols19 == 150 && matrix19[199][149] == heights19.back();
+    vector<int> narrow19;
+    vector<int64_t> decodedWide19;
+    GridView decodedView19;
+    passed19 = passed19 && packed19.open(directory19 + "/wide.wcp") && !packed19.fitsInt() && !packed19.decode(narrow19.data())
+            && packed19.decode(narrow19, decodedWide19, decodedView19) && decodedView19.elementWidth == 8
+            && vector<ll>(decodedWide19.begin(), decodedWide19.end()) == wide19;
+
+    // Размеры в заголовке, которых блоки не могут заполнить, отвергаются до выделения буфера высот
+    fstream huge19(directory19 + "/plateau.wcp", ios::binary | ios::in | ios::out);
+    uint64_t hugeRows19 = (uint64_t)1 << 30;
+    uint32_t hugeChunkRows19 = (uint32_t)1 << 30;
+    huge19.seekp(16);
+    huge19.write(reinterpret_cast<const char*>(&hugeRows19), sizeof(hugeRows19));
+    huge19.seekp(32);
+    huge19.write(reinterpret_cast<const char*>(&hugeChunkRows19), sizeof(hugeChunkRows19));
+    huge19.close();
+    passed19 = passed19 && !packed19.open(directory19 + "/plateau.wcp");
+
+    // Обрезанный файл не открывается
+    filesystem::resize_file(name19, filesystem::file_size(name19) - 1);
+    passed19 = passed19 && !packed19.open(name19) && !readGridFile(name19, rows19, cols19, matrix19);
+    filesystem::remove_all(directory19);
+    if (passed19) {
+        cout << "Test 19 passed!" << std::endl;
+    } else {
+        cout << "Test 19 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Дерево заполнения: две ямы сливаются на седловине 4 и переливаются на 6, отдельная яма рядом
+    vector<int> heights20 = {
+        9, 9, 9, 9, 9,
+        9, 1, 4, 2, 6,
+        9, 9, 9, 9, 9,
+        9, 3, 9, 9, 9,
+        9, 9, 9, 9, 9,
+    };
+    GridView view20(5, 5, heights20);
+    WaterVolumeSolver solver20(view20);
+    solver20.setFillTree(true);
+    bool passed20 = solver20.solve() == 17;
+    const FillTree& tree20 = solver20.fillTree();
+    int lake20 = tree20.nodeAt(1, 2), pit20 = tree20.nodeAt(1, 3);
+    ll lakeVolume20 = 0;
+    for (int lake : tree20.lakes())
+        lakeVolume20 += tree20.nodes()[lake].capacity;
+    passed20 = passed20 && tree20.nodes().size() == 4 && tree20.lakes().size() == 2 && lakeVolume20 == 17
+            && tree20.nodeAt(0, 0) == -1 && tree20.nodeAt(1, 4) == -1 && lake20 >= 0 && pit20 >= 0
+            && tree20.nodes()[lake20].parent == -1 && tree20.nodes()[lake20].bottom == 4 && tree20.nodes()[lake20].top == 6
+            && tree20.nodes()[lake20].capacity == 11 && tree20.nodes()[pit20].parent == lake20 && tree20.nodes()[pit20].capacity == 2;
+    if (passed20) {
+        FillResult shallow20 = tree20.pour(pit20, 1), saddle20 = tree20.pour(pit20, 4), spill20 = tree20.pour(pit20, 14);
+        passed20 = tree20.volumeAt(lake20, 5) == 8 && tree20.volumeAt(lake20, 100) == 11 && tree20.levelFor(lake20, 8) == 5.0
+                && shallow20.node == pit20 && shallow20.level == 3.0 && shallow20.overflow == 0
+                && saddle20.node == lake20 && saddle20.level == 4.0 && saddle20.overflow == 0
+                && spill20.node == lake20 && spill20.level == 6.0 && spill20.overflow == 3;
+    }
+
+    // То же дерево по уровням параллельного решателя
+    ParallelWaterVolumeSolver parallel20(view20, 2);
+    parallel20.solve();
+    FillTree rebuilt20;
+    rebuilt20.build(view20, parallel20.takeLevels());
+    passed20 = passed20 && rebuilt20.nodes().size() == 4 && rebuilt20.nodes()[rebuilt20.nodeAt(1, 2)].capacity == 11
+            && rebuilt20.nodes()[rebuilt20.nodeAt(3, 1)].capacity == 6;
+    if (passed20) {
+        cout << "Test 20 passed!" << std::endl;
+    } else {
+        cout << "Test 20 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Пустая сетка: конструктор и reset() после непустой сетки дают нулевой объем
+    vector<vector<int>> empty21;
+    WaterVolumeSolver emptySolver21(0, 5, empty21);
+    bool passed21 = emptySolver21.solve() == 0 && emptySolver21.getWorkingMatrix().empty();
+    WaterVolumeSolver solver21(view20);
+    solver21.setEngine(SolverEngine::PriorityFloodPlus);
+    passed21 = passed21 && solver21.solve() == 17;
+    vector<int> noHeights21;
+    solver21.reset(GridView(3, 0, noHeights21));
+    passed21 = passed21 && solver21.solve() == 0 && solver21.getWorkingMatrix().empty();
+    if (passed21) {
+        cout << "Test 21 passed!" << std::endl;
+    } else {
+        cout << "Test 21 failed!" << std::endl;
+        failedTests++;
+    }
+
+    // Повышение сухих клеток на большой сетке заливает только поддерево стока и совпадает с полным решением
+    int side22 = 200;
+    vector<int> heights22((size_t)side22 * side22);
+    generateTerrain(TerrainKind::Uniform, side22, side22, 22, heights22.data());
+    IncrementalWaterVolumeSolver solver22{GridView(side22, side22, heights22)};
+    bool passed22 = true;
+    for (int k = 0; k < 40 && passed22; k++) {
+        int cell = (int)(terrainRandom(22, k) % heights22.size());
+        heights22[cell] = k % 4 == 3 ? 0 : 10;
+        vector<CellChange> changes22;
+        ll result22 = solver22.update({{cell / side22, cell % side22, heights22[cell]}}, &changes22);
+        WaterVolumeSolver full22(GridView(side22, side22, heights22));
+        passed22 = result22 == full22.solve() && solver22.getWorkingMatrix() == full22.getWorkingMatrix()
+                && changes22.size() < heights22.size() / IncrementalWaterVolumeSolver::fullSolveFraction;
+    }
+    if (passed22) {
+        cout << "Test 22 passed!" << std::endl;
+    } else {
+        cout << "Test 22 failed!" << std::endl;
+        failedTests++;
     }
 
 }
@@ -6,6 +6,14 @@ class unitTests
 {
 public:
     unitTests();
+
+    /**
+     * @brief Возвращает количество непройденных тестов.
+     */
+    int failures() const { return failedTests; }
+
+private:
+    int failedTests = 0; /**< Количество непройденных тестов. */
 };
 
 #endif // UNITTESTS_H
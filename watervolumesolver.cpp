@@ -1,81 +1,432 @@
 #include "watervolumesolver.h"
 
 /**
- * @brief Конструктор класса WaterVolumeSolver.
+ * @brief Конструктор пустого решателя, сетка задается через reset().
+ * @param layout Способ размещения рабочей сетки в памяти.
+ */
+template <class Queue>
+BasicWaterVolumeSolver<Queue>::BasicWaterVolumeSolver(GridLayout layout)
+    : rowsMatrix(0), colsMatrix(0), sumWater(0), engine(SolverEngine::DepthFirstSearch), grid(0, 0, layout) {
+}
+
+/**
+ * @brief Конструктор класса BasicWaterVolumeSolver.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param matrix Матрица с высотами столбцов.
+ * @param layout Способ размещения рабочей сетки в памяти.
+ */
+template <class Queue>
+BasicWaterVolumeSolver<Queue>::BasicWaterVolumeSolver(int rows, int cols, vector<vector<int>>& matrix, GridLayout layout)
+    : BasicWaterVolumeSolver(layout) {
+    reset(rows, cols, matrix);
+}
+
+/**
+ * @brief Конструктор класса BasicWaterVolumeSolver из непрерывного буфера высот.
+ * @param view Матрица с высотами столбцов.
+ * @param layout Способ размещения рабочей сетки в памяти.
+ */
+template <class Queue>
+BasicWaterVolumeSolver<Queue>::BasicWaterVolumeSolver(const GridView& view, GridLayout layout)
+    : BasicWaterVolumeSolver(layout) {
+    reset(view);
+}
+
+/**
+ * @brief Загружает новую сетку, сохраняя выделенную память и выбранный алгоритм.
  * @param rows Количество строк в матрице.
  * @param cols Количество столбцов в матрице.
  * @param matrix Матрица с высотами столбцов.
  */
-WaterVolumeSolver::WaterVolumeSolver(int rows, int cols, vector<vector<int>>& matrix)
-    : rowsMatrix(rows), colsMatrix(cols), matrixInput(matrix), matrixOutput(matrix), matrixVisited(rows, vector<bool>(cols, false)) {
+template <class Queue>
+void BasicWaterVolumeSolver<Queue>::reset(int rows, int cols, vector<vector<int>>& matrix) {
+    load(rows, cols, [&](int i, int j) { return matrix[i][j]; });
+}
+
+/**
+ * @brief Загружает новую сетку из непрерывного буфера высот, сохраняя выделенную память.
+ * Ширина высоты выбирается один раз, а не на каждую клетку.
+ * @param view Матрица с высотами столбцов.
+ */
+template <class Queue>
+void BasicWaterVolumeSolver<Queue>::reset(const GridView& view) {
+    switch (view.elementWidth) {
+    case 1:
+        load(view.rows, view.cols, [&](int i, int j) { return (int)view.row<int8_t>(i)[j]; });
+        break;
+    case 2:
+        load(view.rows, view.cols, [&](int i, int j) { return (int)view.row<int16_t>(i)[j]; });
+        break;
+    default:
+        load(view.rows, view.cols, [&](int i, int j) { return (int)view.row<int32_t>(i)[j]; });
+        break;
+    }
+}
+
+/**
+ * @brief Загружает новую сетку из сжатого файла сетки блок за блоком.
+ * Блок распаковывается, когда load() доходит до его первой строки; строки читаются по порядку,
+ * поэтому каждый блок распаковывается один раз.
+ * @param packed Открытый сжатый файл сетки.
+ * @return false, если высоты не помещаются в int или блок поврежден (сетка тогда пустая).
+ */
+template <class Queue>
+bool BasicWaterVolumeSolver<Queue>::reset(const PackedGrid& packed) {
+    bool ok = packed.isOpen() && packed.fitsInt();
+    if (ok) {
+        int cols = packed.cols();
+        int chunkRows = packed.chunkRows();
+        vector<int> chunk((size_t)min(chunkRows, packed.rows()) * cols);
+        int firstRow = 0;
+        int endRow = 0;
+        load(packed.rows(), cols, [&](int i, int j) {
+            if (i < firstRow || i >= endRow) {
+                firstRow = i / chunkRows * chunkRows;
+                endRow = firstRow + chunkRows;
+                ok = ok && packed.decodeChunk(i / chunkRows, chunk.data());
+            }
+            return chunk[(size_t)(i - firstRow) * cols + j];
+        });
+    }
+    if (!ok)
+        load(0, 0, [](int, int) { return 0; });
+    return ok;
+}
+
+/**
+ * @brief Заполняет рабочую сетку и кладет граничные клетки в очередь.
+ * Заодно находит диапазон высот, по которому очередь выбирает режим.
+ * Сетка без строк или столбцов загружается пустой, и solve() возвращает 0.
+ * @param rows Количество строк в матрице.
+ * @param cols Количество столбцов в матрице.
+ * @param height Функция, возвращающая высоту клетки (строка, столбец).
+ */
+template <class Queue>
+template <class Source>
+void BasicWaterVolumeSolver<Queue>::load(int rows, int cols, Source height) {
+    SOLVER_STATS(StatsClock clock);
+    if (rows <= 0 || cols <= 0) {
+        rows = 0;
+        cols = 0;
+    }
+    SOLVER_STATS(statistics = SolverStats(), statistics.rows = rows, statistics.cols = cols);
+    basinTable.clear();
+    rowsMatrix = rows;
+    colsMatrix = cols;
+    sumWater = 0;
+    pit.clear();
+    grid.reset(rows, cols);
+
+    int minHeight = rows > 0 ? height(0, 0) : 0;
+    int maxHeight = minHeight;
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++) {
+            int h = height(i, j);
+            grid[grid.index(i, j)] = Cell{h, h, false, 0};
+            if (h < minHeight)
+                minHeight = h;
+            if (h > maxHeight)
+                maxHeight = h;
+        }
+    }
+
+    pq.init(minHeight, maxHeight, rowsMatrix * colsMatrix);
     for (int i = 0; i < rowsMatrix; i++) {
         for (int j = 0; j < colsMatrix; j++) {
-            if (i == 0 || i == rowsMatrix - 1 || j == 0 || j == colsMatrix - 1)
-                pq.push({matrixInput[i][j], {i, j}});
+            if (i == 0 || i == rowsMatrix - 1 || j == 0 || j == colsMatrix - 1) {
+                int u = grid.index(i, j);
+                push(grid[u].height, u);
+            }
         }
     }
+    SOLVER_STATS(statistics.setupSeconds = clock.seconds());
+}
+
+/**
+ * @brief Выбирает алгоритм заполнения.
+ * @param engine Алгоритм, который будет использован в solve().
+ */
+template <class Queue>
+void BasicWaterVolumeSolver<Queue>::setEngine(SolverEngine engine) {
+    this->engine = engine;
+}
+
+/**
+ * @brief Включает разметку озер при решении.
+ * @param enabled true - размечать озера в solve().
+ */
+template <class Queue>
+void BasicWaterVolumeSolver<Queue>::setBasinLabelling(bool enabled) {
+    labelling = enabled;
+}
+
+/**
+ * @brief Включает построение дерева заполнения при решении.
+ * @param enabled true - строить дерево в solve().
+ */
+template <class Queue>
+void BasicWaterVolumeSolver<Queue>::setFillTree(bool enabled) {
+    filling = enabled;
 }
 
 /**
  * @brief Решает задачу о объеме воды.
  * @return Объем воды, который можно собрать.
  */
-ll WaterVolumeSolver::solve() {
+template <class Queue>
+ll BasicWaterVolumeSolver<Queue>::solve() {
+    SOLVER_STATS(StatsClock clock);
+    basinTable.clear();
+    tree.clear();
+    if (engine == SolverEngine::PriorityFloodPlus) {
+        ll ans = labelling ? solvePriorityFloodPlus<true>() : solvePriorityFloodPlus<false>();
+        if (filling)
+            buildFillTree();
+        SOLVER_STATS(statistics.floodSeconds = clock.seconds());
+        return ans;
+    }
+
     ll ans = 0;
     while (!pq.empty()) {
-        auto x = pq.top();
-        pq.pop();
+        pii x = pop();
         sumWater = 0;
-        int i, j, val;
-        val = x.first;
-        i = x.second.first;
-        j = x.second.second;
-        if (!matrixVisited[i][j]) {
-            DepthFirstSearch(i, j, val);
+        if (!grid[x.second].visited) {
+            if (labelling)
+                DepthFirstSearch<true>(x.second, x.first);
+            else
+                DepthFirstSearch<false>(x.second, x.first);
         }
         ans += sumWater;
     }
+    if (filling)
+        buildFillTree();
+    SOLVER_STATS(statistics.floodSeconds = clock.seconds());
     return ans;
 }
 
 /**
- * @brief Проверяет, является ли клетка с координатами (x, y) допустимой для посещения.
- * @param x Координата x клетки.
- * @param y Координата y клетки.
+ * @brief Проверяет, является ли клетка допустимой для посещения.
+ * @param v Линейный индекс клетки.
  * @param L Высота текущей клетки.
  * @return true, если клетка допустима, иначе false.
  */
-bool WaterVolumeSolver::valid(int x, int y, int L) {
-    if (x >= 0 && x < rowsMatrix && y >= 0 && y < colsMatrix && !matrixVisited[x][y] && matrixInput[x][y] <= L)
-        return true;
-    else
-        return false;
+template <class Queue>
+bool BasicWaterVolumeSolver<Queue>::valid(int v, int L) {
+    const Cell& cell = grid[v];
+    return !cell.visited && cell.height <= L;
 }
 
 
 /**
  * @brief Выполняет поиск в глубину для сбора воды.
- * @param ux Координата x текущей клетки.
- * @param uy Координата y текущей клетки.
+ * @param u Линейный индекс текущей клетки.
  * @param L Высота текущей клетки.
  */
-void WaterVolumeSolver::DepthFirstSearch(int ux, int uy, int L) {
-    matrixVisited[ux][uy] = true;
+template <class Queue>
+template <bool Labelled>
+void BasicWaterVolumeSolver<Queue>::DepthFirstSearch(int u, int L) {
+    grid[u].visited = true;
+    SOLVER_STATS(depth++, statistics.maxDepth = max(statistics.maxDepth, depth));
+
+    for (int i = 0; i < CellGrid::directions; i++) {
+        int v = grid.neighbour(u, i);
+        Cell& cell = grid[v];
+        if (Labelled && !cell.visited && cell.height < L) {
+            // Озеро заливается целиком, затем поиск продолжается из сухих клеток на его берегу
+            size_t shore = pit.size();
+            floodBasin<false>(u, v, L);
+            while (pit.size() > shore) {
+                int w = pit.back();
+                pit.pop_back();
+                DepthFirstSearch<Labelled>(w, L);
+            }
+        } else if (valid(v, L)) {
+            sumWater += (ll)L - cell.height;
+            SOLVER_STATS(statistics.cellsFlooded += L > cell.height);
+            cell.level = L;
+            DepthFirstSearch<Labelled>(v, L);
+        } else if (!cell.visited) {
+            push(cell.height, v);
+        }
+    }
+    SOLVER_STATS(depth--);
+}
+
+/**
+ * @brief Решает задачу итеративным алгоритмом Priority-Flood+.
+ * Клетки не выше текущего уровня перелива получают окончательный уровень сразу и
+ * обрабатываются через стек; в очередь с приоритетом попадают только клетки выше него.
+ * Клетка помечается посещенной при добавлении, поэтому память ограничена размером сетки.
+ * Разметка озер - параметр шаблона, чтобы цикл без разметки не проверял ее на каждой клетке.
+ * @return Объем воды, который можно собрать.
+ */
+template <class Queue>
+template <bool Labelled>
+ll BasicWaterVolumeSolver<Queue>::solvePriorityFloodPlus() {
+    // Граничные клетки уже лежат в очереди, помечаем их, чтобы они не попали туда повторно
+    for (int i = 0; i < rowsMatrix; i++) {
+        grid[grid.index(i, 0)].visited = true;
+        grid[grid.index(i, colsMatrix - 1)].visited = true;
+    }
+    for (int j = 0; j < colsMatrix; j++) {
+        grid[grid.index(0, j)].visited = true;
+        grid[grid.index(rowsMatrix - 1, j)].visited = true;
+    }
 
-    for (int i = 0; i < 4; i++) {
-        int vx = ux + fx[i];
-        int vy = uy + fy[i];
-        if (valid(vx, vy, L)) {
-            sumWater += (ll)(L - matrixInput[vx][vy]);
-            matrixOutput[vx][vy] = L;
-            DepthFirstSearch(vx, vy, L);
-        } else if (vx >= 0 && vx < rowsMatrix && vy >= 0 && vy < colsMatrix && matrixInput[vx][vy] > L && !matrixVisited[vx][vy]) {
-            pq.push({matrixInput[vx][vy], {vx, vy}});
+    sumWater = 0;
+    while (true) {
+        if (!pit.empty()) {
+            int u = pit.back();
+            pit.pop_back();
+            spill<Labelled>(u, grid[u].level);
+        } else if (!pq.empty()) {
+            // Клетка из очереди всегда сухая: ее уровень равен высоте
+            pii x = pop();
+            spill<Labelled>(x.second, x.first);
+        } else {
+            break;
+        }
+    }
+    return sumWater;
+}
 
+/**
+ * @brief Помечает соседей клетки и распределяет их между стеком и очередью.
+ * @param u Линейный индекс клетки с окончательным уровнем.
+ * @param L Уровень воды в клетке u.
+ */
+template <class Queue>
+template <bool Labelled>
+void BasicWaterVolumeSolver<Queue>::spill(int u, int L) {
+    for (int i = 0; i < CellGrid::directions; i++) {
+        int v = grid.neighbour(u, i);
+        Cell& cell = grid[v];
+        if (cell.visited)
+            continue;
+        // С разметкой в стек попадают только сухие клетки: озеро заливается целиком сразу
+        if (Labelled && cell.height < L) {
+            floodBasin<true>(u, v, L);
+            continue;
+        }
+        cell.visited = true;
+        if (cell.height <= L) {
+            sumWater += (ll)L - cell.height;
+            SOLVER_STATS(statistics.cellsFlooded += L > cell.height);
+            cell.level = L;
+            pit.push_back(v);
+            SOLVER_STATS(statistics.maxDepth = max(statistics.maxDepth, (ll)pit.size()));
+        } else {
+            push(cell.height, v);
         }
     }
 }
 
-vector<vector<int>> WaterVolumeSolver::getWorkingMatrix() const {
+/**
+ * @brief Заливает озеро, в которое вода перелилась из сухой клетки, и заводит его в таблице.
+ * Озеро - связная область клеток ниже уровня воды; она заливается отдельным стеком до конца,
+ * поэтому все ее клетки получают один номер и объединять озера не нужно. Сухие клетки на
+ * уровне воды уходят в стек pit, клетки выше него - в очередь.
+ * @param u Линейный индекс сухой клетки, из которой перелилась вода (перелив озера).
+ * @param v Линейный индекс первой затопленной клетки (ниже уровня воды, не посещена).
+ * @param L Уровень воды.
+ * @tparam MarkQueued Помечать клетки при добавлении в очередь (Priority-Flood+); поиск в глубину
+ * помечает клетку, только когда входит в нее.
+ */
+template <class Queue>
+template <bool MarkQueued>
+void BasicWaterVolumeSolver<Queue>::floodBasin(int u, int v, int L) {
+    int basin = (int)basinTable.size();
+    int row, col;
+    grid.position(u, row, col);
+    basinTable.push_back(Basin{L, 0, 0, row, col});
+    ll volume = 0;
+    ll area = 0;
+    grid[v].basin = basin;
+    grid[v].visited = true;
+    grid[v].level = L;
+    lake.push_back(v);
+    while (!lake.empty()) {
+        int w = lake.back();
+        lake.pop_back();
+        volume += (ll)L - grid[w].height;
+        area++;
+        for (int i = 0; i < CellGrid::directions; i++) {
+            int x = grid.neighbour(w, i);
+            Cell& cell = grid[x];
+            if (cell.visited)
+                continue;
+            if (cell.height > L) {
+                if (MarkQueued)
+                    cell.visited = true;
+                push(cell.height, x);
+                continue;
+            }
+            // Номер и флаг пишутся подряд, чтобы компилятор объединил их в одну запись слова;
+            // у сухих клеток на уровне воды номер не читается
+            cell.basin = basin;
+            cell.visited = true;
+            cell.level = L;
+            if (cell.height < L)
+                lake.push_back(x);
+            else
+                pit.push_back(x);
+        }
+    }
+    basinTable[basin].volume = volume;
+    basinTable[basin].area = area;
+    sumWater += volume;
+    SOLVER_STATS(statistics.cellsFlooded += area);
+}
+
+/**
+ * @brief Собирает затопленные клетки и строит дерево заполнения.
+ */
+template <class Queue>
+void BasicWaterVolumeSolver<Queue>::buildFillTree() {
+    floodedCells.clear();
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++) {
+            const Cell& cell = grid[grid.index(i, j)];
+            if (cell.level > cell.height)
+                floodedCells.push_back(FloodedCell{cell.height, cell.level, i, j});
+        }
+    }
+    tree.build(colsMatrix, floodedCells);
+}
+
+/**
+ * @brief Возвращает матрицу номеров озер (индексы в basins(), -1 - над клеткой нет воды).
+ * Без разметки в последнем solve() все клетки равны -1.
+ */
+template <class Queue>
+vector<vector<int>> BasicWaterVolumeSolver<Queue>::getBasinMatrix() const {
+    vector<vector<int>> matrixOutput(rowsMatrix, vector<int>(colsMatrix, -1));
+    if (basinTable.empty())
+        return matrixOutput;
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++) {
+            int u = grid.index(i, j);
+            if (grid[u].level > grid[u].height)
+                matrixOutput[i][j] = grid[u].basin;
+        }
+    }
     return matrixOutput;
 }
+
+template <class Queue>
+vector<vector<int>> BasicWaterVolumeSolver<Queue>::getWorkingMatrix() const {
+    SOLVER_STATS(StatsClock clock);
+    vector<vector<int>> matrixOutput(rowsMatrix, vector<int>(colsMatrix));
+    for (int i = 0; i < rowsMatrix; i++) {
+        for (int j = 0; j < colsMatrix; j++)
+            matrixOutput[i][j] = grid[grid.index(i, j)].level;
+    }
+    SOLVER_STATS(statistics.outputSeconds = clock.seconds());
+    return matrixOutput;
+}
+
+template class BasicWaterVolumeSolver<HeightQueue>;
+template class BasicWaterVolumeSolver<BinaryHeapQueue>;
+template class BasicWaterVolumeSolver<CountingQueue<HeightQueue>>;
+template class BasicWaterVolumeSolver<CountingQueue<BinaryHeapQueue>>;
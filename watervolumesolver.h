@@ -1,26 +1,130 @@
 #ifndef WATERVOLUMESOLVER_H
 #define WATERVOLUMESOLVER_H
 
+#include "cellgrid.h"
+#include "heightqueue.h"
+#include "gridview.h"
+#include "packedgrid.h"
+#include "solverstats.h"
+#include "filltree.h"
 #include <vector>
 #include <queue>
 using namespace std;
 
 typedef long long ll;
-typedef pair<int, int> pii;
 
 /**
- * @brief Класс WaterVolumeSolver решает задачу о объеме воды.
+ * @brief Алгоритм заполнения, которым решается задача.
  */
-class WaterVolumeSolver {
+enum class SolverEngine {
+    DepthFirstSearch, /**< Рекурсивный поиск в глубину от каждой клетки очереди. */
+    PriorityFloodPlus /**< Итеративный Priority-Flood+: клетки ниже уровня перелива идут через стек, выше - через очередь с приоритетом. */
+};
+
+/**
+ * @brief Озеро: связная по сторонам область клеток, над которыми стоит вода.
+ */
+struct Basin {
+    int level; /**< Уровень воды. */
+    ll volume; /**< Объем воды. */
+    ll area; /**< Количество затопленных клеток. */
+    int spillRow; /**< Строка клетки перелива: через нее вода уходит из озера. */
+    int spillCol; /**< Столбец клетки перелива. */
+};
+
+/**
+ * @brief Класс BasicWaterVolumeSolver решает задачу о объеме воды.
+ * Один объект можно переиспользовать для многих сеток через reset(): рабочая сетка, очередь
+ * и стек сохраняют выделенную память, поэтому на маленьких сетках решение не выделяет память.
+ * @tparam Queue Очередь с приоритетом по высоте (HeightQueue или BinaryHeapQueue).
+ */
+template <class Queue>
+class BasicWaterVolumeSolver {
 public:
     vector<vector<int>> getWorkingMatrix() const;
+
+    /**
+     * @brief Конструктор пустого решателя, сетка задается через reset().
+     * @param layout Способ размещения рабочей сетки в памяти.
+     */
+    explicit BasicWaterVolumeSolver(GridLayout layout = GridLayout::RowMajor);
+
+    /**
+     * @brief Конструктор класса BasicWaterVolumeSolver.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param matrix Матрица с высотами столбцов.
+     * @param layout Способ размещения рабочей сетки в памяти.
+     */
+    BasicWaterVolumeSolver(int rows, int cols, vector<vector<int>>& matrix, GridLayout layout = GridLayout::RowMajor);
+
+    /**
+     * @brief Конструктор класса BasicWaterVolumeSolver из непрерывного буфера высот.
+     * Высоты читаются прямо из буфера (например, из отображенного файла) без промежуточной матрицы.
+     * @param view Матрица с высотами столбцов.
+     * @param layout Способ размещения рабочей сетки в памяти.
+     */
+    explicit BasicWaterVolumeSolver(const GridView& view, GridLayout layout = GridLayout::RowMajor);
+
     /**
-     * @brief Конструктор класса WaterVolumeSolver.
+     * @brief Загружает новую сетку, сохраняя выделенную память и выбранный алгоритм.
      * @param rows Количество строк в матрице.
      * @param cols Количество столбцов в матрице.
      * @param matrix Матрица с высотами столбцов.
      */
-    WaterVolumeSolver(int rows, int cols, vector<vector<int>>& matrix);
+    void reset(int rows, int cols, vector<vector<int>>& matrix);
+
+    /**
+     * @brief Загружает новую сетку из непрерывного буфера высот, сохраняя выделенную память.
+     * @param view Матрица с высотами столбцов.
+     */
+    void reset(const GridView& view);
+
+    /**
+     * @brief Загружает новую сетку из сжатого файла сетки блок за блоком.
+     * Кроме рабочей сетки в памяти держится только один распакованный блок, а не вся матрица.
+     * @param packed Открытый сжатый файл сетки.
+     * @return false, если высоты не помещаются в int или блок поврежден (сетка тогда пустая).
+     */
+    bool reset(const PackedGrid& packed);
+
+    /**
+     * @brief Выбирает алгоритм заполнения.
+     * @param engine Алгоритм, который будет использован в solve().
+     */
+    void setEngine(SolverEngine engine);
+
+    /**
+     * @brief Включает разметку озер при решении.
+     * Номера озер раздаются во время заполнения: когда вода переливается из сухой клетки в клетку
+     * ниже уровня, озеро заливается целиком отдельным стеком и все его клетки получают один новый
+     * номер, поэтому объединять номера не нужно. Второго прохода по сетке нет.
+     * @param enabled true - размечать озера в solve().
+     */
+    void setBasinLabelling(bool enabled);
+
+    /**
+     * @brief Возвращает озера последнего solve() с разметкой в порядке затопления.
+     */
+    const vector<Basin>& basins() const { return basinTable; }
+
+    /**
+     * @brief Возвращает матрицу номеров озер (индексы в basins(), -1 - над клеткой нет воды).
+     */
+    vector<vector<int>> getBasinMatrix() const;
+
+    /**
+     * @brief Включает построение дерева заполнения при решении.
+     * После заполнения затопленные клетки собираются одним проходом по строкам рабочей сетки
+     * (так они сразу упорядочены), и дерево строится только по ним.
+     * @param enabled true - строить дерево в solve().
+     */
+    void setFillTree(bool enabled);
+
+    /**
+     * @brief Возвращает дерево заполнения последнего solve() с построением дерева.
+     */
+    const FillTree& fillTree() const { return tree; }
 
     /**
      * @brief Решает задачу о объеме воды.
@@ -28,34 +132,112 @@ public:
      */
     ll solve();
 
+    /**
+     * @brief Возвращает очередь с приоритетом (например, чтобы узнать выбранный режим).
+     */
+    const Queue& queue() const { return pq; }
+
+    /**
+     * @brief Возвращает счетчики последних reset(), solve() и getWorkingMatrix() (нули без WATERCUBOIDS_STATS).
+     */
+    const SolverStats& stats() const { return statistics; }
+
 private:
     int rowsMatrix; /**< Количество строк в матрице. */
     int colsMatrix; /**< Количество столбцов в матрице. */
     ll sumWater; /**< Суммарный объем воды. */
-    vector<vector<int>> matrixInput; /**< Матрица с высотами столбцов. */
-    vector<vector<int>> matrixOutput;
-    vector<vector<bool>> matrixVisited; /**< Матрица для отслеживания посещенных клеток. */
-    priority_queue<pair<int, pii>, vector<pair<int, pii>>, greater<pair<int, pii>>> pq; /**< Очередь с приоритетом для обхода клеток. */
+    SolverEngine engine; /**< Выбранный алгоритм заполнения. */
+    CellGrid grid; /**< Рабочая сетка: высоты, уровни воды и флаги посещения. */
+    Queue pq; /**< Очередь с приоритетом (высота, индекс клетки) для обхода клеток. */
+    vector<int> pit; /**< Стек клеток, затопленных до текущего уровня перелива (для PriorityFloodPlus и берегов озер при разметке). */
+    mutable SolverStats statistics; /**< Счетчики горячего пути и время этапов. */
+    bool labelling = false; /**< Размечать озера в solve(). */
+    vector<Basin> basinTable; /**< Озера; номер озера в клетке - индекс в этой таблице. */
+    vector<int> lake; /**< Стек клеток заливаемого озера (для разметки). */
+    bool filling = false; /**< Строить дерево заполнения в solve(). */
+    vector<FloodedCell> floodedCells; /**< Затопленные клетки для дерева заполнения (память переиспользуется). */
+    FillTree tree; /**< Дерево заполнения. */
+#ifdef WATERCUBOIDS_STATS
+    ll depth = 0; /**< Текущая глубина рекурсии поиска в глубину. */
+#endif
 
-    const int fx[4] = {0, 0, 1, -1}; /**< Массив смещений по оси x для соседних клеток. */
-    const int fy[4] = {1, -1, 0, 0}; /**< Массив смещений по оси y для соседних клеток. */
+    /**
+     * @brief Кладет клетку в очередь с приоритетом.
+     */
+    void push(int height, int u) {
+        pq.push(height, u);
+        SOLVER_STATS(statistics.queuePushes++, statistics.queuePeak = max(statistics.queuePeak, (ll)pq.size()));
+    }
 
     /**
-     * @brief Проверяет, является ли клетка с координатами (x, y) допустимой для посещения.
-     * @param x Координата x клетки.
-     * @param y Координата y клетки.
+     * @brief Извлекает клетку с минимальной высотой.
+     */
+    pii pop() {
+        SOLVER_STATS(statistics.queuePops++);
+        return pq.pop();
+    }
+
+    /**
+     * @brief Проверяет, является ли клетка допустимой для посещения.
+     * Клетки рамки всегда помечены посещенными, поэтому проверка границ не нужна.
+     * @param v Линейный индекс клетки.
      * @param L Высота текущей клетки.
      * @return true, если клетка допустима, иначе false.
      */
-    bool valid(int x, int y, int L);
+    bool valid(int v, int L);
 
     /**
      * @brief Выполняет поиск в глубину для сбора воды.
-     * @param ux Координата x текущей клетки.
-     * @param uy Координата y текущей клетки.
+     * @param u Линейный индекс текущей клетки.
      * @param L Высота текущей клетки.
+     * @tparam Labelled Размечать озера.
      */
-    void DepthFirstSearch(int ux, int uy, int L);
+    template <bool Labelled>
+    void DepthFirstSearch(int u, int L);
+
+    /**
+     * @brief Решает задачу итеративным алгоритмом Priority-Flood+.
+     * Каждая клетка попадает в стек или очередь не более одного раза.
+     * @tparam Labelled Размечать озера.
+     * @return Объем воды, который можно собрать.
+     */
+    template <bool Labelled>
+    ll solvePriorityFloodPlus();
+
+    /**
+     * @brief Помечает соседей клетки и распределяет их между стеком и очередью.
+     * @param u Линейный индекс клетки с окончательным уровнем.
+     * @param L Уровень воды в клетке u.
+     * @tparam Labelled Размечать озера (клетка u тогда всегда сухая).
+     */
+    template <bool Labelled>
+    void spill(int u, int L);
+
+    /**
+     * @brief Заливает озеро, в которое вода перелилась из сухой клетки, и заводит его в таблице.
+     * @param u Линейный индекс сухой клетки, из которой перелилась вода.
+     * @param v Линейный индекс первой затопленной клетки.
+     * @param L Уровень воды.
+     * @tparam MarkQueued Помечать клетки при добавлении в очередь (Priority-Flood+).
+     */
+    template <bool MarkQueued>
+    void floodBasin(int u, int v, int L);
+
+    /**
+     * @brief Собирает затопленные клетки и строит дерево заполнения.
+     */
+    void buildFillTree();
+
+    /**
+     * @brief Заполняет рабочую сетку и кладет граничные клетки в очередь.
+     * @param rows Количество строк в матрице.
+     * @param cols Количество столбцов в матрице.
+     * @param height Функция, возвращающая высоту клетки (строка, столбец).
+     */
+    template <class Source>
+    void load(int rows, int cols, Source height);
 };
 
+typedef BasicWaterVolumeSolver<HeightQueue> WaterVolumeSolver;
+
 #endif // WATERVOLUMESOLVER_H